@@ -0,0 +1,816 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_BINARYLEXSOURCE_HPP
+#define HTCW_BINARYLEXSOURCE_HPP
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#endif
+#include <math.h>
+#include "LexSource.hpp"
+
+// the deepest nesting of arrays and maps the binary encodings support
+#ifndef JSON_BINARY_MAX_DEPTH
+#define JSON_BINARY_MAX_DEPTH 32
+#endif
+
+namespace lex {
+// represents a single item decoded from a binary encoding
+struct BinaryItem {
+    static const int8_t Null = 0;
+    static const int8_t Boolean = 1;
+    static const int8_t Integer = 2;
+    static const int8_t Unsigned = 3;
+    static const int8_t Real = 4;
+    static const int8_t Text = 5;
+    static const int8_t Bytes = 6;
+    static const int8_t Array = 7;
+    static const int8_t Map = 8;
+    // ends an indefinite length item (CBOR only)
+    static const int8_t Break = 9;
+    int8_t type;
+    // the item ends with a Break instead of having a length
+    bool indefinite;
+    union {
+        long long integer;
+        unsigned long long uinteger;
+        double real;
+        bool boolean;
+    };
+    // the byte count of a string or the entry count of an array or map
+    unsigned long long length;
+};
+// presents binary encoded data as JSON text so JsonReader can read it unchanged.
+// text strings are escaped as needed and byte strings become unpadded base64url.
+// map keys that aren't strings are quoted. searches that only need the end of a
+// string jump over its body using the length prefix, skipping the rest of an array or map
+// walks the item headers without producing any text, and numbers are handed to the reader
+// as decoded
+class BinaryLexSource : public virtual LexSource {
+    struct Frame {
+        bool map;
+        bool indefinite;
+        // entries left in a definite container. maps count keys and values separately
+        unsigned long long remaining;
+        unsigned long long emitted;
+    };
+    Frame m_stack[JSON_BINARY_MAX_DEPTH];
+    size_t m_depth;
+    // text waiting to be read
+    char m_out[40];
+    uint8_t m_outPos;
+    uint8_t m_outLen;
+    // where the opening quote of the current string sits in the output, or -1
+    int8_t m_openQuote;
+    // the string being written, if any
+    bool m_inString;
+    bool m_stringBytes;
+    bool m_stringIndefinite;
+    unsigned long long m_stringRemaining;
+    // bytes waiting to be base64 encoded
+    uint8_t m_b64[3];
+    uint8_t m_b64Count;
+    bool m_started;
+    int8_t m_error;
+    // the container depth the text waiting to be read was produced at
+    size_t m_pieceDepth;
+    // where the text of a number starts in the output or -1, and the number itself
+    int8_t m_numberAt;
+    BinaryItem m_number;
+    BinaryLexSource(BinaryLexSource& rhs)=delete;
+    BinaryLexSource(BinaryLexSource&& rhs)=delete;
+    BinaryLexSource& operator=(BinaryLexSource& rhs)=delete;
+
+    void emit(char ch) {
+        m_out[m_outLen++]=ch;
+    }
+    void emit(const char* sz) {
+        while(*sz)
+            m_out[m_outLen++]=*(sz++);
+    }
+    void emitBase64(size_t count) {
+        static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+        uint32_t v = ((uint32_t)m_b64[0]<<16)|((uint32_t)m_b64[1]<<8)|m_b64[2];
+        emit(alphabet[(v>>18)&0x3f]);
+        emit(alphabet[(v>>12)&0x3f]);
+        if(1<count)
+            emit(alphabet[(v>>6)&0x3f]);
+        if(2<count)
+            emit(alphabet[v&0x3f]);
+        m_b64[0]=m_b64[1]=m_b64[2]=0;
+        m_b64Count = 0;
+    }
+    void emitScalar(const BinaryItem& item) {
+        char* sz = m_out+m_outLen;
+        switch(item.type) {
+            case BinaryItem::Boolean:
+                emit(item.boolean?"true":"false");
+                return;
+            case BinaryItem::Integer:
+                sprintf(sz,"%lld",item.integer);
+                break;
+            case BinaryItem::Unsigned:
+                sprintf(sz,"%llu",item.uinteger);
+                break;
+            case BinaryItem::Real:
+                // JSON has no NaN or infinity
+                if(isnan(item.real) || isinf(item.real)) {
+                    emit("null");
+                    return;
+                }
+                sprintf(sz,"%.17g",item.real);
+                break;
+            default:
+                emit("null");
+                return;
+        }
+        m_outLen+=strlen(sz);
+    }
+    bool fail() {
+        m_error = IOError;
+        return false;
+    }
+    // decodes an item and makes sure its length fits in what's left of the input
+    bool decode(BinaryItem& item) {
+        if(!decodeItem(item))
+            return fail();
+        if(item.indefinite)
+            return true;
+        size_t left = m_pend-m_pcur;
+        switch(item.type) {
+            case BinaryItem::Text:
+            case BinaryItem::Bytes:
+            case BinaryItem::Array:
+                if(item.length>left)
+                    return fail();
+                break;
+            case BinaryItem::Map:
+                if(item.length>left/2)
+                    return fail();
+                break;
+        }
+        return true;
+    }
+    // accounts for a finished item in its container
+    void endItem() {
+        if(0==m_depth)
+            return;
+        Frame& f = m_stack[m_depth-1];
+        ++f.emitted;
+        if(!f.indefinite)
+            --f.remaining;
+        if(f.map && 0!=(f.emitted&1))
+            emit(':');
+    }
+    bool produceString() {
+        while(0==m_stringRemaining) {
+            if(!m_stringIndefinite) {
+                if(0<m_b64Count)
+                    emitBase64(m_b64Count);
+                emit('\"');
+                m_inString = false;
+                endItem();
+                return true;
+            }
+            // the next chunk of an indefinite string
+            BinaryItem item;
+            if(!decode(item))
+                return false;
+            if(BinaryItem::Break==item.type) {
+                m_stringIndefinite = false;
+                continue;
+            }
+            if(item.indefinite || item.type!=(m_stringBytes?BinaryItem::Bytes:BinaryItem::Text))
+                return fail();
+            m_stringRemaining = item.length;
+        }
+        if(m_stringBytes) {
+            while(3>m_b64Count && 0<m_stringRemaining) {
+                m_b64[m_b64Count++]=*(m_pcur++);
+                --m_stringRemaining;
+            }
+            if(3==m_b64Count)
+                emitBase64(3);
+            return true;
+        }
+        uint8_t b = *m_pcur;
+        switch(b) {
+            case '\"':
+                emit("\\\"");
+                break;
+            case '\\':
+                emit("\\\\");
+                break;
+            case '\n':
+                emit("\\n");
+                break;
+            case '\r':
+                emit("\\r");
+                break;
+            case '\t':
+                emit("\\t");
+                break;
+            default:
+                if(0x20>b) {
+                    sprintf(m_out+m_outLen,"\\u%04x",(unsigned int)b);
+                    m_outLen+=6;
+                    break;
+                }
+                // copy a run that needs no escaping
+                while(m_outLen<sizeof(m_out) && 0<m_stringRemaining && 0x20<=(b=*m_pcur) && '\"'!=b && '\\'!=b) {
+                    emit((char)b);
+                    ++m_pcur;
+                    --m_stringRemaining;
+                }
+                return true;
+        }
+        ++m_pcur;
+        --m_stringRemaining;
+        return true;
+    }
+    // fills the output with the next piece of text
+    // returns false at the end of the input or on an error
+    bool produce() {
+        m_outPos = m_outLen = 0;
+        m_openQuote = -1;
+        m_numberAt = -1;
+        m_pieceDepth = m_depth;
+        if(m_inString)
+            return produceString();
+        Frame* pf = (0<m_depth)?m_stack+m_depth-1:nullptr;
+        if(nullptr!=pf && !pf->indefinite && 0==pf->remaining) {
+            emit(pf->map?'}':']');
+            --m_depth;
+            endItem();
+            return true;
+        }
+        if(nullptr==pf) {
+            if(m_pcur>=m_pend)
+                return false;
+            // separate top level items
+            if(m_started)
+                emit('\n');
+            m_started = true;
+        }
+        BinaryItem item;
+        if(!decode(item))
+            return false;
+        if(BinaryItem::Break==item.type) {
+            // a map can't end between a key and its value
+            if(nullptr==pf || !pf->indefinite || (pf->map && 0!=(pf->emitted&1)))
+                return fail();
+            emit(pf->map?'}':']');
+            --m_depth;
+            endItem();
+            return true;
+        }
+        bool key = nullptr!=pf && pf->map && 0==(pf->emitted&1);
+        if(nullptr!=pf && 0<pf->emitted && (!pf->map || key))
+            emit(',');
+        switch(item.type) {
+            case BinaryItem::Array:
+            case BinaryItem::Map:
+                if(key || JSON_BINARY_MAX_DEPTH<=m_depth)
+                    return fail();
+                pf = m_stack+(m_depth++);
+                pf->map = BinaryItem::Map==item.type;
+                pf->indefinite = item.indefinite;
+                pf->remaining = pf->map?item.length*2:item.length;
+                pf->emitted = 0;
+                emit(pf->map?'{':'[');
+                return true;
+            case BinaryItem::Text:
+            case BinaryItem::Bytes:
+                m_inString = true;
+                m_stringBytes = BinaryItem::Bytes==item.type;
+                m_stringIndefinite = item.indefinite;
+                m_stringRemaining = item.indefinite?0:item.length;
+                m_b64Count = 0;
+                m_b64[0]=m_b64[1]=m_b64[2]=0;
+                m_openQuote = (int8_t)m_outLen;
+                emit('\"');
+                return true;
+        }
+        if(!key && (BinaryItem::Integer==item.type || BinaryItem::Unsigned==item.type || BinaryItem::Real==item.type)) {
+            m_numberAt = (int8_t)m_outLen;
+            m_number = item;
+        }
+        if(key)
+            emit('\"');
+        emitScalar(item);
+        if(key)
+            emit('\"');
+        endItem();
+        return true;
+    }
+    // jumps past the rest of the current string using its length
+    bool skipStringBody(unsigned long long& position) {
+        while(true) {
+            position+=m_stringRemaining;
+            m_pcur+=m_stringRemaining;
+            m_stringRemaining = 0;
+            if(!m_stringIndefinite)
+                break;
+            BinaryItem item;
+            if(!decode(item))
+                return false;
+            if(BinaryItem::Break==item.type)
+                break;
+            if(item.indefinite || item.type!=(m_stringBytes?BinaryItem::Bytes:BinaryItem::Text))
+                return fail();
+            m_stringRemaining = item.length;
+        }
+        m_stringIndefinite = false;
+        m_b64Count = 0;
+        m_inString = false;
+        m_outPos = m_outLen = 0;
+        // the closing quote is consumed as the match
+        endItem();
+        return true;
+    }
+    // skips an item whose header was just decoded. strings are jumped over using their
+    // length, and containers by walking the headers of what's in them
+    bool skipItem(const BinaryItem& item,size_t depth) {
+        BinaryItem child;
+        unsigned long long count;
+        switch(item.type) {
+            case BinaryItem::Text:
+            case BinaryItem::Bytes:
+                if(!item.indefinite) {
+                    m_pcur+=item.length;
+                    return true;
+                }
+                while(true) {
+                    if(!decode(child))
+                        return false;
+                    if(BinaryItem::Break==child.type)
+                        return true;
+                    if(child.indefinite || child.type!=item.type)
+                        return fail();
+                    m_pcur+=child.length;
+                }
+            case BinaryItem::Array:
+            case BinaryItem::Map:
+                if(JSON_BINARY_MAX_DEPTH<=depth)
+                    return fail();
+                count = (BinaryItem::Map==item.type)?item.length*2:item.length;
+                while(item.indefinite || 0<count) {
+                    if(!decode(child))
+                        return false;
+                    if(BinaryItem::Break==child.type)
+                        return item.indefinite?true:fail();
+                    if(!skipItem(child,depth+1))
+                        return false;
+                    if(!item.indefinite)
+                        --count;
+                }
+                return true;
+            case BinaryItem::Break:
+                return fail();
+        }
+        // everything else is all header
+        return true;
+    }
+    // skips what's left in the container on top of the stack, leaving it ready to close
+    bool skipEntries() {
+        Frame& f = m_stack[m_depth-1];
+        while(f.indefinite || 0<f.remaining) {
+            BinaryItem item;
+            if(!decode(item))
+                return false;
+            if(BinaryItem::Break==item.type) {
+                // a map can't end between a key and its value
+                if(!f.indefinite || (f.map && 0!=(f.emitted&1)))
+                    return fail();
+                f.indefinite = false;
+                f.remaining = 0;
+                break;
+            }
+            if(!skipItem(item,m_depth))
+                return false;
+            ++f.emitted;
+            if(!f.indefinite)
+                --f.remaining;
+        }
+        return true;
+    }
+protected:
+    const uint8_t* m_pcur;
+    const uint8_t* m_pend;
+    // decodes the item header at m_pcur, leaving m_pcur on the item's content
+    // returns false if the data is malformed or truncated
+    virtual bool decodeItem(BinaryItem& item)=0;
+    int16_t read() final {
+        if(nullptr==m_pcur)
+            return LexSource::Closed;
+        while(m_outPos==m_outLen) {
+            if(0!=m_error)
+                return m_error;
+            if(!produce() && m_outPos==m_outLen) {
+                if(0!=m_error)
+                    return m_error;
+                return LexSource::EndOfInput;
+            }
+        }
+        return (unsigned char)m_out[m_outPos++];
+    }
+    bool skipToAny(const char* characters7bit,unsigned long long& position,int16_t& match,int8_t& error) override {
+        // inside a string, a search for a quote can only end at the closing quote
+        if(nullptr!=m_pcur && m_inString && m_outPos>m_openQuote && nullptr==tee() && 0<current() && nullptr!=strchr(characters7bit,'\"')) {
+            const char* sz = (128>current())?strchr(characters7bit,(char)current()):nullptr;
+            if(nullptr==sz || 0==*sz) {
+                if(!skipStringBody(position)) {
+                    match = 0;
+                    error = m_error;
+                    return false;
+                }
+                ++position;
+                match = '\"';
+                error = 0;
+                return true;
+            }
+        }
+        return LexSource::skipToAny(characters7bit,position,match,error);
+    }
+    bool skipContainer(unsigned long long& position,int16_t& match,int8_t& error) override {
+        match = 0;
+        error = 0;
+        // the tee has to see the text, and a top level value isn't in a container
+        if(nullptr==m_pcur || nullptr!=tee() || 0==m_pieceDepth || 0!=m_error)
+            return false;
+        // a container that just closed is the one the cursor is in
+        if(m_depth<m_pieceDepth) {
+            match = (int16_t)current();
+            return true;
+        }
+        const uint8_t* pstart = m_pcur;
+        unsigned long long ignored = 0;
+        if(m_inString && !skipStringBody(ignored)) {
+            error = m_error;
+            return false;
+        }
+        // finish any container the cursor's text opened, then the one it's in
+        while(true) {
+            if(!skipEntries()) {
+                error = m_error;
+                return false;
+            }
+            if(m_depth==m_pieceDepth)
+                break;
+            --m_depth;
+            endItem();
+        }
+        if(!produce()) {
+            error = (0!=m_error)?m_error:(int8_t)EndOfInput;
+            return false;
+        }
+        // bytes of the encoding stand in for the text that wasn't produced
+        position+=(m_pcur-pstart);
+        match = (unsigned char)m_out[m_outPos++];
+        return true;
+    }
+public:
+    bool takeNumber(long long* pinteger,double* preal,bool* pisReal) override {
+        // the tee gets the text read the usual way
+        if(0>m_numberAt || m_outPos!=m_numberAt+1 || nullptr!=tee())
+            return false;
+        size_t length = m_outLen-m_numberAt;
+        if(captureSize()+length+4>captureCapacity())
+            return false;
+        switch(m_number.type) {
+            case BinaryItem::Integer:
+                *pinteger = m_number.integer;
+                *preal = (double)m_number.integer;
+                *pisReal = false;
+                break;
+            case BinaryItem::Unsigned:
+                // too big for an integer, like the same number lexed from text
+                *pinteger = LLONG_MAX;
+                *preal = (double)m_number.uinteger;
+                *pisReal = true;
+                break;
+            default:
+                *preal = m_number.real;
+                *pinteger = (fabs(m_number.real)<9.2e18)?(long long)m_number.real:0;
+                *pisReal = true;
+                break;
+        }
+        m_numberAt = -1;
+        while(0<length--) {
+            capture(current());
+            if(!advance() && hasError())
+                return true;
+        }
+        return true;
+    }
+
+    BinaryLexSource() : m_pcur(nullptr),m_pend(nullptr) {
+        restart();
+    }
+    ~BinaryLexSource() override {}
+    // clears the decoding state
+    void restart() {
+        m_depth = 0;
+        m_outPos = m_outLen = 0;
+        m_openQuote = -1;
+        m_inString = false;
+        m_stringBytes = false;
+        m_stringIndefinite = false;
+        m_stringRemaining = 0;
+        m_b64Count = 0;
+        m_started = false;
+        m_error = 0;
+        m_pieceDepth = 0;
+        m_numberAt = -1;
+    }
+    bool attach(const void* data,size_t size) {
+        if(nullptr==data)
+            return false;
+        if(nullptr!=m_pcur)
+            return false;
+        reset();
+        restart();
+        m_pcur = (const uint8_t*)data;
+        m_pend = m_pcur+size;
+        return true;
+    }
+    bool detach() {
+        if(nullptr==m_pcur)
+            return false;
+        m_pcur = m_pend = nullptr;
+        return true;
+    }
+};
+// reads CBOR (RFC 8949). tags are ignored, and undefined and simple values read as null
+class CborLexSource : public BinaryLexSource {
+    static double half(uint16_t h) {
+        int exp = (h>>10)&0x1f;
+        int mant = h&0x3ff;
+        double val;
+        if(0==exp)
+            val = ldexp(mant,-24);
+        else if(31!=exp)
+            val = ldexp(mant+1024,exp-25);
+        else
+            val = mant?NAN:INFINITY;
+        return (h&0x8000)?-val:val;
+    }
+protected:
+    bool decodeItem(BinaryItem& item) override {
+        while(true) {
+            if(m_pcur>=m_pend)
+                return false;
+            uint8_t b = *(m_pcur++);
+            uint8_t major = b>>5;
+            uint8_t info = b&0x1f;
+            unsigned long long value = 0;
+            item.indefinite = false;
+            if(24>info) {
+                value = info;
+            } else if(28>info) {
+                size_t c = (size_t)1<<(info-24);
+                if((size_t)(m_pend-m_pcur)<c)
+                    return false;
+                while(c--)
+                    value=(value<<8)|*(m_pcur++);
+            } else if(31==info) {
+                if(2>major || 6==major)
+                    return false;
+                item.indefinite = true;
+            } else
+                return false;
+            switch(major) {
+                case 0:
+                    if(value>(unsigned long long)LLONG_MAX) {
+                        item.type = BinaryItem::Unsigned;
+                        item.uinteger = value;
+                    } else {
+                        item.type = BinaryItem::Integer;
+                        item.integer = (long long)value;
+                    }
+                    return true;
+                case 1:
+                    if(value>(unsigned long long)LLONG_MAX) {
+                        item.type = BinaryItem::Real;
+                        item.real = -1.0-(double)value;
+                    } else {
+                        item.type = BinaryItem::Integer;
+                        item.integer = -1-(long long)value;
+                    }
+                    return true;
+                case 2:
+                case 3:
+                    item.type = (2==major)?BinaryItem::Bytes:BinaryItem::Text;
+                    item.length = value;
+                    return true;
+                case 4:
+                case 5:
+                    item.type = (4==major)?BinaryItem::Array:BinaryItem::Map;
+                    item.length = value;
+                    return true;
+                case 6:
+                    // tags are ignored. decode the tagged item
+                    continue;
+            }
+            if(item.indefinite) {
+                item.type = BinaryItem::Break;
+                return true;
+            }
+            switch(info) {
+                case 20:
+                case 21:
+                    item.type = BinaryItem::Boolean;
+                    item.boolean = 21==info;
+                    return true;
+                case 25:
+                    item.type = BinaryItem::Real;
+                    item.real = half((uint16_t)value);
+                    return true;
+                case 26: {
+                    uint32_t u = (uint32_t)value;
+                    float f;
+                    memcpy(&f,&u,sizeof(f));
+                    item.type = BinaryItem::Real;
+                    item.real = f;
+                    return true;
+                }
+                case 27:
+                    item.type = BinaryItem::Real;
+                    memcpy(&item.real,&value,sizeof(item.real));
+                    return true;
+            }
+            item.type = BinaryItem::Null;
+            return true;
+        }
+    }
+public:
+    CborLexSource() {}
+    ~CborLexSource() override {}
+};
+// reads MessagePack. extension types read as byte strings
+class MsgPackLexSource : public BinaryLexSource {
+    bool be(size_t count,unsigned long long& value) {
+        if((size_t)(m_pend-m_pcur)<count)
+            return false;
+        value = 0;
+        while(count--)
+            value=(value<<8)|*(m_pcur++);
+        return true;
+    }
+protected:
+    bool decodeItem(BinaryItem& item) override {
+        if(m_pcur>=m_pend)
+            return false;
+        uint8_t b = *(m_pcur++);
+        unsigned long long value;
+        item.indefinite = false;
+        if(0x80>b) {
+            item.type = BinaryItem::Integer;
+            item.integer = b;
+            return true;
+        }
+        if(0xe0<=b) {
+            item.type = BinaryItem::Integer;
+            item.integer = (int8_t)b;
+            return true;
+        }
+        if(0x90>b) {
+            item.type = BinaryItem::Map;
+            item.length = b&0x0f;
+            return true;
+        }
+        if(0xa0>b) {
+            item.type = BinaryItem::Array;
+            item.length = b&0x0f;
+            return true;
+        }
+        if(0xc0>b) {
+            item.type = BinaryItem::Text;
+            item.length = b&0x1f;
+            return true;
+        }
+        switch(b) {
+            case 0xc0:
+                item.type = BinaryItem::Null;
+                return true;
+            case 0xc2:
+            case 0xc3:
+                item.type = BinaryItem::Boolean;
+                item.boolean = 0xc3==b;
+                return true;
+            case 0xc4:
+            case 0xc5:
+            case 0xc6:
+                if(!be((size_t)1<<(b-0xc4),value))
+                    return false;
+                item.type = BinaryItem::Bytes;
+                item.length = value;
+                return true;
+            case 0xc7:
+            case 0xc8:
+            case 0xc9:
+                // skip the extension type
+                if(!be((size_t)1<<(b-0xc7),value) || m_pcur>=m_pend)
+                    return false;
+                ++m_pcur;
+                item.type = BinaryItem::Bytes;
+                item.length = value;
+                return true;
+            case 0xca: {
+                if(!be(4,value))
+                    return false;
+                uint32_t u = (uint32_t)value;
+                float f;
+                memcpy(&f,&u,sizeof(f));
+                item.type = BinaryItem::Real;
+                item.real = f;
+                return true;
+            }
+            case 0xcb:
+                if(!be(8,value))
+                    return false;
+                item.type = BinaryItem::Real;
+                memcpy(&item.real,&value,sizeof(item.real));
+                return true;
+            case 0xcc:
+            case 0xcd:
+            case 0xce:
+            case 0xcf:
+                if(!be((size_t)1<<(b-0xcc),value))
+                    return false;
+                if(value>(unsigned long long)LLONG_MAX) {
+                    item.type = BinaryItem::Unsigned;
+                    item.uinteger = value;
+                } else {
+                    item.type = BinaryItem::Integer;
+                    item.integer = (long long)value;
+                }
+                return true;
+            case 0xd0:
+            case 0xd1:
+            case 0xd2:
+            case 0xd3: {
+                size_t c = (size_t)1<<(b-0xd0);
+                if(!be(c,value))
+                    return false;
+                // sign extend
+                if(8>c && 0!=(value&(1ULL<<(c*8-1))))
+                    value|=~((1ULL<<(c*8))-1);
+                item.type = BinaryItem::Integer;
+                item.integer = (long long)value;
+                return true;
+            }
+            case 0xd4:
+            case 0xd5:
+            case 0xd6:
+            case 0xd7:
+            case 0xd8:
+                // fixext: skip the type
+                if(m_pcur>=m_pend)
+                    return false;
+                ++m_pcur;
+                item.type = BinaryItem::Bytes;
+                item.length = (size_t)1<<(b-0xd4);
+                return true;
+            case 0xd9:
+            case 0xda:
+            case 0xdb:
+                if(!be((size_t)1<<(b-0xd9),value))
+                    return false;
+                item.type = BinaryItem::Text;
+                item.length = value;
+                return true;
+            case 0xdc:
+            case 0xdd:
+                if(!be((0xdc==b)?2:4,value))
+                    return false;
+                item.type = BinaryItem::Array;
+                item.length = value;
+                return true;
+            case 0xde:
+            case 0xdf:
+                if(!be((0xde==b)?2:4,value))
+                    return false;
+                item.type = BinaryItem::Map;
+                item.length = value;
+                return true;
+        }
+        // 0xc1 is never used
+        return false;
+    }
+public:
+    MsgPackLexSource() {}
+    ~MsgPackLexSource() override {}
+};
+template<size_t TCapacity> class StaticCborLexSource : public StaticLexSource<TCapacity>, public virtual CborLexSource {
+
+};
+template<size_t TCapacity> class StaticMsgPackLexSource : public StaticLexSource<TCapacity>, public virtual MsgPackLexSource {
+
+};
+} // namespace lex
+#endif
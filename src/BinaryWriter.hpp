@@ -0,0 +1,322 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_BINARYWRITER_HPP
+#define HTCW_BINARYWRITER_HPP
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#include <string.h>
+#endif
+#include "MemoryPool.hpp"
+#include "LexSink.hpp"
+#include "BinaryLexSource.hpp"
+#include "JsonWriter.hpp"
+
+namespace json {
+    // writes CBOR to a LexSink. arrays, maps and streamed strings use indefinite
+    // lengths, so nothing has to be buffered
+    class CborWriter : public JsonWriter {
+        lex::LexSink& m_sink;
+        bool byte(uint8_t value) {
+            return m_sink.write((const char*)&value,1);
+        }
+        bool head(uint8_t major,unsigned long long value) {
+            uint8_t buf[9];
+            size_t c;
+            major<<=5;
+            if(24>value) {
+                buf[0]=major|(uint8_t)value;
+                c=1;
+            } else if(0xff>=value) {
+                buf[0]=major|24;
+                c=2;
+            } else if(0xffff>=value) {
+                buf[0]=major|25;
+                c=3;
+            } else if(0xffffffffULL>=value) {
+                buf[0]=major|26;
+                c=5;
+            } else {
+                buf[0]=major|27;
+                c=9;
+            }
+            for(size_t i = c-1;0<i;--i) {
+                buf[i]=(uint8_t)value;
+                value>>=8;
+            }
+            return m_sink.write((const char*)buf,c);
+        }
+        bool text(const char* value,size_t length) {
+            return head(3,length) && (0==length || m_sink.write(value,length));
+        }
+    public:
+        CborWriter(lex::LexSink& sink) : m_sink(sink) {
+        }
+        bool beginObject() override {
+            return byte(0xbf);
+        }
+        bool endObject() override {
+            return byte(0xff);
+        }
+        bool beginArray() override {
+            return byte(0x9f);
+        }
+        bool endArray() override {
+            return byte(0xff);
+        }
+        bool field(const char* name) override {
+            return nullptr!=name && text(name,strlen(name));
+        }
+        bool null() override {
+            return byte(0xf6);
+        }
+        bool boolean(bool value) override {
+            return byte(value?0xf5:0xf4);
+        }
+        bool integer(long long value) override {
+            if(0>value)
+                return head(1,(unsigned long long)(-1-value));
+            return head(0,(unsigned long long)value);
+        }
+        bool real(double value) override {
+            uint8_t buf[9];
+            float f = (float)value;
+            // use single precision when nothing is lost
+            if((double)f==value || isnan(value)) {
+                uint32_t u;
+                memcpy(&u,&f,sizeof(u));
+                buf[0]=0xfa;
+                for(int i = 4;0<i;--i) {
+                    buf[i]=(uint8_t)u;
+                    u>>=8;
+                }
+                return m_sink.write((const char*)buf,5);
+            }
+            uint64_t u;
+            memcpy(&u,&value,sizeof(u));
+            buf[0]=0xfb;
+            for(int i = 8;0<i;--i) {
+                buf[i]=(uint8_t)u;
+                u>>=8;
+            }
+            return m_sink.write((const char*)buf,9);
+        }
+        bool string(const char* value) override {
+            return nullptr!=value && text(value,strlen(value));
+        }
+        bool beginString() override {
+            return byte(0x7f);
+        }
+        bool stringPart(const char* value) override {
+            return nullptr!=value && text(value,strlen(value));
+        }
+        bool endString() override {
+            return byte(0xff);
+        }
+    };
+    // writes MessagePack to a LexSink. MessagePack needs counts up front, so each
+    // top level value is assembled in the pool, its array, map and streamed string
+    // headers are patched once they end, and then it's written to the sink in one go.
+    // the pool must not be used for anything else while a value is being written
+    class MsgPackWriter : public JsonWriter {
+        struct Level {
+            size_t offset;
+            uint32_t count;
+            bool map;
+        };
+        lex::LexSink& m_sink;
+        MemoryPool& m_pool;
+        uint8_t* m_pstart;
+        size_t m_size;
+        Level m_levels[JSON_BINARY_MAX_DEPTH];
+        size_t m_depth;
+        size_t m_stringOffset;
+        uint8_t* append(size_t size) {
+            uint8_t* p = (uint8_t*)m_pool.alloc(size);
+            if(nullptr==p)
+                return nullptr;
+            if(nullptr==m_pstart) {
+                m_pstart = p;
+                m_size = 0;
+            } else if(p!=m_pstart+m_size) {
+                // someone else allocated from the pool
+                m_pool.unalloc(size);
+                return nullptr;
+            }
+            m_size+=size;
+            return p;
+        }
+        static void put(uint8_t* p,unsigned long long value,size_t count) {
+            while(count--) {
+                p[count]=(uint8_t)value;
+                value>>=8;
+            }
+        }
+        bool header(uint8_t code,unsigned long long value,size_t count) {
+            uint8_t* p = append(count+1);
+            if(nullptr==p)
+                return false;
+            *p = code;
+            put(p+1,value,count);
+            return true;
+        }
+        bool beginValue() {
+            if(0<m_depth && !m_levels[m_depth-1].map)
+                ++m_levels[m_depth-1].count;
+            return true;
+        }
+        bool endValue() {
+            if(0<m_depth)
+                return true;
+            bool result = m_sink.write((const char*)m_pstart,m_size);
+            m_pool.unalloc(m_size);
+            m_pstart = nullptr;
+            m_size = 0;
+            return result;
+        }
+        bool text(const char* value,size_t length) {
+            bool result;
+            if(32>length)
+                result = header(0xa0|(uint8_t)length,0,0);
+            else if(0xff>=length)
+                result = header(0xd9,length,1);
+            else if(0xffff>=length)
+                result = header(0xda,length,2);
+            else
+                result = header(0xdb,length,4);
+            if(!result)
+                return false;
+            if(0==length)
+                return true;
+            uint8_t* p = append(length);
+            if(nullptr==p)
+                return false;
+            memcpy(p,value,length);
+            return true;
+        }
+        bool beginContainer(bool map) {
+            if(JSON_BINARY_MAX_DEPTH<=m_depth)
+                return false;
+            beginValue();
+            // patched when the container ends
+            if(!header(map?0xdf:0xdd,0,4))
+                return false;
+            Level& l = m_levels[m_depth++];
+            l.offset = m_size-5;
+            l.count = 0;
+            l.map = map;
+            return true;
+        }
+        bool endContainer(bool map) {
+            if(0==m_depth || map!=m_levels[m_depth-1].map)
+                return false;
+            Level& l = m_levels[--m_depth];
+            put(m_pstart+l.offset+1,l.count,4);
+            return endValue();
+        }
+    public:
+        MsgPackWriter(lex::LexSink& sink,MemoryPool& pool) : m_sink(sink),m_pool(pool),m_pstart(nullptr),m_size(0),m_depth(0),m_stringOffset(0) {
+        }
+        bool beginObject() override {
+            return beginContainer(true);
+        }
+        bool endObject() override {
+            return endContainer(true);
+        }
+        bool beginArray() override {
+            return beginContainer(false);
+        }
+        bool endArray() override {
+            return endContainer(false);
+        }
+        bool field(const char* name) override {
+            if(nullptr==name || 0==m_depth || !m_levels[m_depth-1].map)
+                return false;
+            ++m_levels[m_depth-1].count;
+            return text(name,strlen(name));
+        }
+        bool null() override {
+            beginValue();
+            return header(0xc0,0,0) && endValue();
+        }
+        bool boolean(bool value) override {
+            beginValue();
+            return header(value?0xc3:0xc2,0,0) && endValue();
+        }
+        bool integer(long long value) override {
+            bool result;
+            beginValue();
+            if(0<=value) {
+                if(0x7f>=value)
+                    result = header((uint8_t)value,0,0);
+                else if(0xff>=value)
+                    result = header(0xcc,value,1);
+                else if(0xffff>=value)
+                    result = header(0xcd,value,2);
+                else if(0xffffffffLL>=value)
+                    result = header(0xce,value,4);
+                else
+                    result = header(0xcf,value,8);
+            } else {
+                if(-32<=value)
+                    result = header((uint8_t)value,0,0);
+                else if(-128<=value)
+                    result = header(0xd0,value,1);
+                else if(-32768<=value)
+                    result = header(0xd1,value,2);
+                else if(-2147483648LL<=value)
+                    result = header(0xd2,value,4);
+                else
+                    result = header(0xd3,value,8);
+            }
+            return result && endValue();
+        }
+        bool real(double value) override {
+            beginValue();
+            float f = (float)value;
+            // use single precision when nothing is lost
+            if((double)f==value || isnan(value)) {
+                uint32_t u;
+                memcpy(&u,&f,sizeof(u));
+                return header(0xca,u,4) && endValue();
+            }
+            uint64_t u;
+            memcpy(&u,&value,sizeof(u));
+            return header(0xcb,u,8) && endValue();
+        }
+        bool string(const char* value) override {
+            if(nullptr==value)
+                return false;
+            beginValue();
+            return text(value,strlen(value)) && endValue();
+        }
+        bool beginString() override {
+            beginValue();
+            // patched when the string ends
+            if(!header(0xdb,0,4))
+                return false;
+            m_stringOffset = m_size-5;
+            return true;
+        }
+        bool stringPart(const char* value) override {
+            if(nullptr==value || nullptr==m_pstart)
+                return false;
+            size_t c = strlen(value);
+            if(0==c)
+                return true;
+            uint8_t* p = append(c);
+            if(nullptr==p)
+                return false;
+            memcpy(p,value,c);
+            return true;
+        }
+        bool endString() override {
+            if(nullptr==m_pstart)
+                return false;
+            put(m_pstart+m_stringOffset+1,m_size-m_stringOffset-5,4);
+            return endValue();
+        }
+    };
+}
+#endif
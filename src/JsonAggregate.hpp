@@ -0,0 +1,924 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONAGGREGATE_HPP
+#define HTCW_JSONAGGREGATE_HPP
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+#include "MemoryPool.hpp"
+#include "JsonReader.hpp"
+#include "JsonPath.hpp"
+// the number of value fields a group-by can aggregate
+#define JSON_GROUP_MAX_VALUES 8
+// the number of files a group-by spills into. each is reloaded on its own when it finishes,
+// and one that doesn't fit is split into as many again
+#define JSON_GROUP_SPILL_PARTITIONS 16
+// the number of fields a top-K row can hold besides its key
+#define JSON_TOPK_MAX_FIELDS 15
+
+namespace json {
+    // the sum, minimum, maximum and average of a run of numbers
+    class JsonAccumulator {
+        unsigned long long m_numbers;
+        double m_sum;
+        // the exact sum while every number is an integer and it fits
+        long long m_integerSum;
+        bool m_integral;
+        double m_min;
+        double m_max;
+        bool addInteger(long long integer) {
+            if((0<integer && m_integerSum>LLONG_MAX-integer) || (0>integer && m_integerSum<LLONG_MIN-integer))
+                return false;
+            m_integerSum+=integer;
+            return true;
+        }
+    public:
+        JsonAccumulator() {
+            reset();
+        }
+        void reset() {
+            m_numbers = 0;
+            m_sum = 0;
+            m_integerSum = 0;
+            m_integral = true;
+            m_min = NAN;
+            m_max = NAN;
+        }
+        // adds a number of the specified JsonReader value type
+        void add(int8_t type,long long integer,double real) {
+            ++m_numbers;
+            if(JsonReader::Integer==type) {
+                real = (double)integer;
+                m_integral = m_integral && addInteger(integer);
+            } else
+                m_integral = false;
+            m_sum+=real;
+            if(1==m_numbers || real<m_min)
+                m_min = real;
+            if(1==m_numbers || real>m_max)
+                m_max = real;
+        }
+        // adds the value under the cursor if it's a number, and moves past the value
+        bool add(JsonReader& reader) {
+            switch(reader.nodeType()) {
+                case JsonReader::Value:
+                    break;
+                case JsonReader::ValuePart:
+                    // a long value is only complete at the end of its parts
+                    while(JsonReader::ValuePart==reader.nodeType()) {
+                        if(!reader.read())
+                            return false;
+                    }
+                    if(JsonReader::EndValuePart!=reader.nodeType())
+                        return false;
+                    break;
+                default:
+                    return reader.skipSubtree() || !reader.hasError();
+            }
+            int8_t type = reader.valueType();
+            if(JsonReader::Integer==type || JsonReader::Real==type)
+                add(type,reader.integerValue(),reader.realValue());
+            return reader.read() || !reader.hasError();
+        }
+        // adds the value if it's a number
+        void add(const JsonElement& value) {
+            switch(value.type()) {
+                case JsonElement::Integer:
+                    add(JsonReader::Integer,value.integer(),0);
+                    break;
+                case JsonElement::Real:
+                    add(JsonReader::Real,0,value.real());
+                    break;
+            }
+        }
+        // combines the numbers of another accumulator with these
+        void merge(const JsonAccumulator& rhs) {
+            if(0==rhs.m_numbers)
+                return;
+            if(0==m_numbers || rhs.m_min<m_min)
+                m_min = rhs.m_min;
+            if(0==m_numbers || rhs.m_max>m_max)
+                m_max = rhs.m_max;
+            m_numbers+=rhs.m_numbers;
+            m_sum+=rhs.m_sum;
+            m_integral = m_integral && rhs.m_integral && addInteger(rhs.m_integerSum);
+        }
+        // the number of numbers added
+        unsigned long long numbers() const { return m_numbers; }
+        double sum() const { return m_sum; }
+        // indicates whether every number was an integer and their sum fit in integerSum()
+        bool integral() const { return m_integral; }
+        long long integerSum() const { return m_integerSum; }
+        // the minimum, maximum and average are NaN if no numbers were added
+        double min() const { return m_min; }
+        double max() const { return m_max; }
+        double average() const { return (0==m_numbers)?NAN:m_sum/m_numbers; }
+    };
+    // accumulates the count, sum, minimum, maximum and average of the values a query matches.
+    // numbers are taken from the reader's lexed value as it passes, and everything else is
+    // counted and skipped, so no strings are kept and no elements are built. attach it to a
+    // path with JsonPath::evaluate() or to a JsonQuerySet
+    class JsonAggregate : public JsonQuerySink {
+        unsigned long long m_count;
+        JsonAccumulator m_values;
+    public:
+        JsonAggregate() : m_count(0) {
+        }
+        // clears the results so the aggregate can be used again
+        void reset() {
+            m_count = 0;
+            m_values.reset();
+        }
+        bool match(JsonReader& reader) override {
+            ++m_count;
+            return m_values.add(reader);
+        }
+        bool match(const JsonElement& value) override {
+            ++m_count;
+            m_values.add(value);
+            return true;
+        }
+        // the number of values matched, of any type
+        unsigned long long count() const { return m_count; }
+        // the number of values matched that were numbers
+        unsigned long long numbers() const { return m_values.numbers(); }
+        double sum() const { return m_values.sum(); }
+        // indicates whether every number was an integer and their sum fit in integerSum()
+        bool integral() const { return m_values.integral(); }
+        long long integerSum() const { return m_values.integerSum(); }
+        // the minimum, maximum and average are NaN if no numbers were matched
+        double min() const { return m_values.min(); }
+        double max() const { return m_values.max(); }
+        double average() const { return m_values.average(); }
+    };
+    // the results for one key of a JsonGroupBy. it's preceded in memory by its key and
+    // followed by an accumulator for each value field
+    class JsonGroup {
+        friend class JsonGroupBy;
+        uint32_t m_hash;
+        int8_t m_keyType;
+        size_t m_keySize;
+        const char* m_pkey;
+        unsigned long long m_count;
+        static size_t align(size_t size) {
+            return (size+7)&~((size_t)7);
+        }
+        JsonAccumulator* paccumulators() {
+            return (JsonAccumulator*)(((uint8_t*)this)+align(sizeof(JsonGroup)));
+        }
+        const JsonAccumulator* paccumulators() const {
+            return (const JsonAccumulator*)(((const uint8_t*)this)+align(sizeof(JsonGroup)));
+        }
+    public:
+        // the key's JsonReader value type, or Undefined for rows without the key field
+        int8_t keyType() const { return m_keyType; }
+        const char* string() const { return (JsonReader::String==m_keyType)?m_pkey:nullptr; }
+        long long integer() const {
+            long long result = 0;
+            if(JsonReader::Integer==m_keyType)
+                memcpy(&result,m_pkey,sizeof(result));
+            return result;
+        }
+        double real() const {
+            double result = 0;
+            if(JsonReader::Real==m_keyType)
+                memcpy(&result,m_pkey,sizeof(result));
+            return result;
+        }
+        bool boolean() const { return JsonReader::Boolean==m_keyType && 0!=*m_pkey; }
+        // the number of rows with this key
+        unsigned long long count() const { return m_count; }
+        // the numbers of the value field at the specified index
+        const JsonAccumulator& value(size_t index) const { return paccumulators()[index]; }
+    };
+    // receives the groups once a JsonGroupBy finishes
+    class JsonGroupSink {
+    public:
+        virtual bool group(const JsonGroup& group)=0;
+        virtual ~JsonGroupSink() {}
+    };
+    // groups the objects a query matches by the value of a key field, keeping a row count and
+    // the numbers of some value fields for each key. only the key and value fields are read from
+    // each row. the groups live in an open addressing hash table in the pool, and once it uses
+    // the memory cap the groups are written out to spill files partitioned by hash, each of
+    // which is merged back on its own when the group-by finishes. a file too big to merge is
+    // split again by more of the hash. the pool must not be used for anything else until then
+    class JsonGroupBy : public JsonQuerySink {
+        MemoryPool& m_pool;
+        const char* m_fields[JSON_GROUP_MAX_VALUES+1];
+        size_t m_valueCount;
+        size_t m_cap;
+        // where the group-by's memory starts in the pool
+        size_t m_base;
+        JsonGroup** m_pslots;
+        size_t m_slotCount;
+        size_t m_groupCount;
+        // the size of the key at the top of the pool that hasn't been given a group yet
+        size_t m_keyAlloc;
+#ifndef ARDUINO
+        const char* m_spillPath;
+        FILE* m_pspills[JSON_GROUP_SPILL_PARTITIONS];
+#endif
+        bool m_spilled;
+        JsonGroupBy(const JsonGroupBy& rhs)=delete;
+        JsonGroupBy& operator=(const JsonGroupBy& rhs)=delete;
+        // a row's values as they're read
+        struct Row {
+            int8_t keyType;
+            size_t keySize;
+            bool found[JSON_GROUP_MAX_VALUES+1];
+            JsonAccumulator values[JSON_GROUP_MAX_VALUES];
+        };
+        size_t groupSize() const {
+            return JsonGroup::align(sizeof(JsonGroup))+m_valueCount*sizeof(JsonAccumulator);
+        }
+        static uint32_t hash(int8_t keyType,const char* key,size_t keySize) {
+            // FNV-1a
+            uint32_t result = 2166136261UL;
+            result = (result^(uint8_t)keyType)*16777619UL;
+            for(size_t i = 0;i<keySize;++i)
+                result = (result^(uint8_t)key[i])*16777619UL;
+            return result;
+        }
+        bool begin() {
+            if(nullptr!=m_pslots)
+                return true;
+            m_base = m_pool.used();
+            size_t cap = m_cap;
+            if(0==cap || cap>m_pool.capacity()-m_base)
+                cap = m_pool.capacity()-m_base;
+            // an eighth of the memory goes to the slots
+            m_slotCount = 8;
+            while(m_slotCount*2*sizeof(JsonGroup*)*8<=cap)
+                m_slotCount*=2;
+            m_cap = cap;
+            m_pslots = (JsonGroup**)m_pool.alloc(m_slotCount*sizeof(JsonGroup*));
+            if(nullptr==m_pslots)
+                return false;
+            memset(m_pslots,0,m_slotCount*sizeof(JsonGroup*));
+            m_groupCount = 0;
+            m_keyAlloc = 0;
+            return true;
+        }
+        // starts a tentative key at the top of the pool
+        bool appendKey(const void* data,size_t size) {
+            uint8_t* p = (uint8_t*)m_pool.alloc(size);
+            if(nullptr==p)
+                return false;
+            memcpy(p,data,size);
+            m_keyAlloc+=size;
+            return true;
+        }
+        const char* key() const {
+            return ((const char*)m_pool.next())-m_keyAlloc;
+        }
+        // null terminates and pads the tentative key
+        bool finishKey(size_t keySize) {
+            size_t size = JsonGroup::align(keySize+1)-keySize;
+            uint8_t* p = (uint8_t*)m_pool.alloc(size);
+            if(nullptr==p)
+                return false;
+            memset(p,0,size);
+            m_keyAlloc+=size;
+            return true;
+        }
+        void dropKey() {
+            m_pool.unalloc(m_keyAlloc);
+            m_keyAlloc = 0;
+        }
+        JsonGroup** find(uint32_t hash,int8_t keyType,const char* key,size_t keySize) {
+            size_t mask = m_slotCount-1;
+            for(size_t i = hash&mask;;i=(i+1)&mask) {
+                JsonGroup* pg = m_pslots[i];
+                if(nullptr==pg || (pg->m_hash==hash && pg->m_keyType==keyType && pg->m_keySize==keySize && 0==memcmp(pg->m_pkey,key,keySize)))
+                    return m_pslots+i;
+            }
+        }
+        // gives the tentative key its group, adding the group if it's new
+        JsonGroup* group(int8_t keyType,size_t keySize,bool allowSpill) {
+            uint32_t h = hash(keyType,key(),keySize);
+            JsonGroup** ppg = find(h,keyType,key(),keySize);
+            if(nullptr!=*ppg) {
+                dropKey();
+                return *ppg;
+            }
+            size_t size = groupSize();
+            if(m_pool.used()-m_base+size>m_cap || (m_groupCount+1)*4>m_slotCount*3) {
+                if(!allowSpill || !spill())
+                    return nullptr;
+                h = hash(keyType,key(),keySize);
+                ppg = find(h,keyType,key(),keySize);
+            }
+            JsonGroup* pg = (JsonGroup*)m_pool.alloc(size);
+            if(nullptr==pg)
+                return nullptr;
+            pg->m_hash = h;
+            pg->m_keyType = keyType;
+            pg->m_keySize = keySize;
+            pg->m_pkey = ((const char*)pg)-m_keyAlloc;
+            pg->m_count = 0;
+            JsonAccumulator* pa = pg->paccumulators();
+            for(size_t i = 0;i<m_valueCount;++i)
+                pa[i].reset();
+            m_keyAlloc = 0;
+            *ppg = pg;
+            ++m_groupCount;
+            return pg;
+        }
+        // clears the table, keeping the tentative key
+        void clear() {
+            memset(m_pslots,0,m_slotCount*sizeof(JsonGroup*));
+            m_groupCount = 0;
+            uint8_t* ptable = ((uint8_t*)m_pslots)+m_slotCount*sizeof(JsonGroup*);
+            memmove(ptable,key(),m_keyAlloc);
+            m_pool.unalloc(((uint8_t*)m_pool.next())-ptable-m_keyAlloc);
+        }
+#ifndef ARDUINO
+        bool spill() {
+            if(nullptr==m_spillPath)
+                return false;
+            size_t size = groupSize();
+            for(size_t i = 0;i<m_slotCount;++i) {
+                JsonGroup* pg = m_pslots[i];
+                if(nullptr==pg)
+                    continue;
+                size_t partition = (pg->m_hash>>24)%JSON_GROUP_SPILL_PARTITIONS;
+                FILE* pfile = m_pspills[partition];
+                if(nullptr==pfile) {
+                    char path[1024];
+                    snprintf(path,sizeof(path),"%s.%u",m_spillPath,(unsigned int)partition);
+                    pfile = fopen(path,"w+b");
+                    if(nullptr==pfile)
+                        return false;
+                    m_pspills[partition] = pfile;
+                }
+                if(1!=fwrite(pg,size,1,pfile) || pg->m_keySize!=fwrite(pg->m_pkey,1,pg->m_keySize,pfile))
+                    return false;
+            }
+            m_spilled = true;
+            clear();
+            return true;
+        }
+        // merges a spill file back into the empty table. full is set if its groups don't fit
+        bool load(FILE* pfile,bool& full) {
+            size_t size = groupSize();
+            double buffer[(sizeof(JsonGroup)+JSON_GROUP_MAX_VALUES*sizeof(JsonAccumulator))/sizeof(double)+2];
+            JsonGroup& g = *(JsonGroup*)buffer;
+            full = false;
+            if(0!=fseek(pfile,0,SEEK_SET))
+                return false;
+            while(1==fread(buffer,size,1,pfile)) {
+                char* p = (char*)m_pool.alloc(g.m_keySize);
+                full = nullptr==p && 0<g.m_keySize;
+                if(full)
+                    return false;
+                m_keyAlloc = g.m_keySize;
+                if(g.m_keySize!=fread(p,1,g.m_keySize,pfile))
+                    return false;
+                full = !finishKey(g.m_keySize);
+                if(full)
+                    return false;
+                JsonGroup* pg = group(g.m_keyType,g.m_keySize,false);
+                full = nullptr==pg;
+                if(full)
+                    return false;
+                pg->m_count+=g.m_count;
+                for(size_t i = 0;i<m_valueCount;++i)
+                    pg->paccumulators()[i].merge(g.paccumulators()[i]);
+            }
+            return 0!=feof(pfile);
+        }
+        // copies a spill file into new ones, partitioned by the bits of the hash at the shift
+        bool split(FILE* pfile,const char* path,unsigned int shift,FILE** pparts) {
+            size_t size = groupSize();
+            double buffer[(sizeof(JsonGroup)+JSON_GROUP_MAX_VALUES*sizeof(JsonAccumulator))/sizeof(double)+2];
+            JsonGroup& g = *(JsonGroup*)buffer;
+            char key[256];
+            if(0!=fseek(pfile,0,SEEK_SET))
+                return false;
+            while(1==fread(buffer,size,1,pfile)) {
+                size_t partition = (g.m_hash>>shift)%JSON_GROUP_SPILL_PARTITIONS;
+                FILE* ppart = pparts[partition];
+                if(nullptr==ppart) {
+                    char name[1024];
+                    snprintf(name,sizeof(name),"%s.%u",path,(unsigned int)partition);
+                    ppart = fopen(name,"w+b");
+                    if(nullptr==ppart)
+                        return false;
+                    pparts[partition] = ppart;
+                }
+                if(1!=fwrite(buffer,size,1,ppart))
+                    return false;
+                for(size_t left = g.m_keySize;0<left;) {
+                    size_t c = (left<sizeof(key))?left:sizeof(key);
+                    if(c!=fread(key,1,c,pfile) || c!=fwrite(key,1,c,ppart))
+                        return false;
+                    left-=c;
+                }
+            }
+            return 0!=feof(pfile);
+        }
+        // hands the groups in a spill file to the sink. a file whose groups don't fit is split
+        // by the next bits of the hash, and each part is finished the same way, so nothing from
+        // it reaches the sink until all of it fits. it only fails for lack of memory once
+        // groups that don't fit share their whole hash
+        bool finishSpill(FILE* pfile,const char* path,unsigned int shift,JsonGroupSink& sink) {
+            bool full;
+            bool result = load(pfile,full);
+            if(result)
+                result = visit(sink);
+            dropKey();
+            clear();
+            if(result || !full || 0==shift)
+                return result;
+            shift = (4<shift)?shift-4:0;
+            FILE* parts[JSON_GROUP_SPILL_PARTITIONS];
+            memset(parts,0,sizeof(parts));
+            result = split(pfile,path,shift,parts);
+            for(size_t i = 0;i<JSON_GROUP_SPILL_PARTITIONS;++i) {
+                if(nullptr==parts[i])
+                    continue;
+                char name[1024];
+                snprintf(name,sizeof(name),"%s.%u",path,(unsigned int)i);
+                if(result)
+                    result = finishSpill(parts[i],name,shift,sink);
+                fclose(parts[i]);
+                remove(name);
+            }
+            return result;
+        }
+        void closeSpills() {
+            for(size_t i = 0;i<JSON_GROUP_SPILL_PARTITIONS;++i) {
+                if(nullptr!=m_pspills[i]) {
+                    fclose(m_pspills[i]);
+                    char path[1024];
+                    snprintf(path,sizeof(path),"%s.%u",m_spillPath,(unsigned int)i);
+                    remove(path);
+                    m_pspills[i] = nullptr;
+                }
+            }
+            m_spilled = false;
+        }
+#else
+        bool spill() {
+            return false;
+        }
+#endif
+        bool visit(JsonGroupSink& sink) {
+            for(size_t i = 0;i<m_slotCount;++i) {
+                if(nullptr!=m_pslots[i] && !sink.group(*m_pslots[i]))
+                    return false;
+            }
+            return true;
+        }
+        // adds a row whose key is at the top of the pool
+        bool add(Row& row) {
+            if(!finishKey(row.keySize)) {
+                dropKey();
+                return false;
+            }
+            JsonGroup* pg = group(row.keyType,row.keySize,true);
+            if(nullptr==pg) {
+                dropKey();
+                return false;
+            }
+            ++pg->m_count;
+            for(size_t i = 0;i<m_valueCount;++i)
+                pg->paccumulators()[i].merge(row.values[i]);
+            return true;
+        }
+        // copies the key under the cursor to the top of the pool, and moves past it
+        bool readKey(JsonReader& reader,Row& row) {
+            switch(reader.nodeType()) {
+                case JsonReader::Object:
+                case JsonReader::Array:
+                    // containers aren't keys
+                    return reader.skipSubtree() || !reader.hasError();
+            }
+            row.keyType = reader.valueType();
+            while(true) {
+                if(JsonReader::String==row.keyType && JsonReader::EndValuePart!=reader.nodeType()) {
+                    size_t size = strlen(reader.value());
+                    if(!appendKey(reader.value(),size))
+                        return false;
+                    row.keySize+=size;
+                }
+                if(JsonReader::ValuePart!=reader.nodeType())
+                    break;
+                if(!reader.read())
+                    return false;
+            }
+            long long integer;
+            double real;
+            bool boolean;
+            switch(row.keyType) {
+                case JsonReader::Integer:
+                    integer = reader.integerValue();
+                    if(!appendKey(&integer,sizeof(integer)))
+                        return false;
+                    row.keySize = sizeof(integer);
+                    break;
+                case JsonReader::Real:
+                    real = reader.realValue();
+                    if(!appendKey(&real,sizeof(real)))
+                        return false;
+                    row.keySize = sizeof(real);
+                    break;
+                case JsonReader::Boolean:
+                    boolean = reader.booleanValue();
+                    if(!appendKey(&boolean,1))
+                        return false;
+                    row.keySize = 1;
+                    break;
+            }
+            return reader.read() || !reader.hasError();
+        }
+    public:
+        // groups by the key field, aggregating the value fields. the memory cap is the most the
+        // group-by uses of the pool, or 0 for all of it. without a spill path, rows that need a
+        // new group once the cap is reached fail the evaluation. spill files are the spill path
+        // followed by a dot and the partition number
+        JsonGroupBy(MemoryPool& pool,const char* keyField,const char* const* valueFields,size_t valueCount,size_t memoryCap=0,const char* spillPath=nullptr) :
+                m_pool(pool),
+                m_valueCount(valueCount<JSON_GROUP_MAX_VALUES?valueCount:JSON_GROUP_MAX_VALUES),
+                m_cap(memoryCap),
+                m_base(0),
+                m_pslots(nullptr),
+                m_slotCount(0),
+                m_groupCount(0),
+                m_keyAlloc(0),
+                m_spilled(false) {
+            m_fields[0] = keyField;
+            for(size_t i = 0;i<m_valueCount;++i)
+                m_fields[i+1] = valueFields[i];
+#ifndef ARDUINO
+            m_spillPath = spillPath;
+            memset(m_pspills,0,sizeof(m_pspills));
+#else
+            (void)spillPath;
+#endif
+        }
+        ~JsonGroupBy() {
+#ifndef ARDUINO
+            closeSpills();
+#endif
+        }
+        // the number of groups in memory
+        size_t size() const { return m_groupCount; }
+        // indicates whether groups have been spilled to disk
+        bool spilled() const { return m_spilled; }
+        bool match(JsonReader& reader) override {
+            if(JsonReader::Object!=reader.nodeType())
+                return reader.skipSubtree() || !reader.hasError();
+            if(!begin())
+                return false;
+            Row row;
+            row.keyType = JsonReader::Undefined;
+            row.keySize = 0;
+            memset(row.found,0,sizeof(row.found));
+            while(true) {
+                int i = reader.skipToFieldOf(m_fields,m_valueCount+1);
+                if(0>i)
+                    break;
+                if(!reader.read())
+                    break;
+                bool result;
+                if(row.found[i])
+                    result = reader.skipSubtree() || !reader.hasError();
+                else if(0==i)
+                    result = readKey(reader,row);
+                else
+                    result = row.values[i-1].add(reader);
+                row.found[i] = true;
+                if(!result)
+                    break;
+            }
+            if(reader.hasError() || JsonReader::EndObject!=reader.nodeType()) {
+                dropKey();
+                return false;
+            }
+            if(!add(row))
+                return false;
+            return reader.read() || !reader.hasError();
+        }
+        bool match(const JsonElement& value) override {
+            if(JsonElement::Object!=value.type())
+                return true;
+            if(!begin())
+                return false;
+            Row row;
+            row.keyType = JsonReader::Undefined;
+            row.keySize = 0;
+            memset(row.found,0,sizeof(row.found));
+            for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe;pfe=pfe->pnext) {
+                for(size_t i = 0;i<=m_valueCount;++i) {
+                    if(row.found[i] || 0!=strcmp(pfe->name,m_fields[i]))
+                        continue;
+                    row.found[i] = true;
+                    if(0<i) {
+                        row.values[i-1].add(*pfe->pvalue);
+                        continue;
+                    }
+                    const JsonElement& k = *pfe->pvalue;
+                    long long integer = k.integer();
+                    double real = k.real();
+                    bool boolean = k.boolean();
+                    bool result = true;
+                    row.keyType = k.type();
+                    switch(k.type()) {
+                        case JsonElement::String:
+                            row.keySize = strlen(k.string());
+                            result = appendKey(k.string(),row.keySize);
+                            break;
+                        case JsonElement::Integer:
+                            row.keySize = sizeof(integer);
+                            result = appendKey(&integer,row.keySize);
+                            break;
+                        case JsonElement::Real:
+                            row.keySize = sizeof(real);
+                            result = appendKey(&real,row.keySize);
+                            break;
+                        case JsonElement::Boolean:
+                            row.keySize = 1;
+                            result = appendKey(&boolean,1);
+                            break;
+                        case JsonElement::Null:
+                            break;
+                        default:
+                            // containers aren't keys
+                            row.keyType = JsonReader::Undefined;
+                            break;
+                    }
+                    if(!result) {
+                        dropKey();
+                        return false;
+                    }
+                }
+            }
+            return add(row);
+        }
+        // hands every group to the sink and empties the group-by, giving back its memory
+        bool finish(JsonGroupSink& sink) {
+            if(nullptr==m_pslots)
+                return true;
+            bool result = true;
+#ifndef ARDUINO
+            if(m_spilled) {
+                result = spill();
+                for(size_t i = 0;result && i<JSON_GROUP_SPILL_PARTITIONS;++i) {
+                    if(nullptr==m_pspills[i])
+                        continue;
+                    char path[1024];
+                    snprintf(path,sizeof(path),"%s.%u",m_spillPath,(unsigned int)i);
+                    result = finishSpill(m_pspills[i],path,24,sink);
+                }
+                closeSpills();
+            } else
+#endif
+                result = visit(sink);
+            m_pool.unalloc(m_pool.used()-m_base);
+            m_pslots = nullptr;
+            m_groupCount = 0;
+            m_keyAlloc = 0;
+            return result;
+        }
+    };
+    // keeps the K objects a query matches with the highest, or lowest, numeric key field,
+    // holding some of their fields. the rows live in K+1 fixed size slots in the pool, kept as
+    // a heap with the worst row on top. a row is read into the spare slot, and once its key
+    // shows it can't make the cut the rest of the object is skipped without being read.
+    // the slots are allocated on the first match, so the pool must not be used for anything
+    // else in between
+    class JsonTopK : public JsonQuerySink {
+        struct Slot {
+            double key;
+            JsonElement row;
+            uint8_t* pdata;
+        };
+        MemoryPool& m_pool;
+        size_t m_k;
+        const char* m_fields[JSON_TOPK_MAX_FIELDS+1];
+        size_t m_fieldCount;
+        size_t m_rowCapacity;
+        bool m_ascending;
+        Slot** m_pheap;
+        size_t m_size;
+        Slot* m_pspare;
+        // the row being read into the spare slot
+        BufferMemoryPool m_rowPool;
+        JsonTopK(const JsonTopK& rhs)=delete;
+        JsonTopK& operator=(const JsonTopK& rhs)=delete;
+        bool better(double lhs,double rhs) const {
+            return m_ascending?lhs<rhs:lhs>rhs;
+        }
+        void siftDown(size_t index,size_t size) {
+            while(true) {
+                size_t child = index*2+1;
+                if(child>=size)
+                    return;
+                if(child+1<size && better(m_pheap[child]->key,m_pheap[child+1]->key))
+                    ++child;
+                if(!better(m_pheap[index]->key,m_pheap[child]->key))
+                    return;
+                Slot* ps = m_pheap[index];
+                m_pheap[index] = m_pheap[child];
+                m_pheap[child] = ps;
+                index = child;
+            }
+        }
+        void siftUp(size_t index) {
+            while(0<index) {
+                size_t parent = (index-1)/2;
+                if(!better(m_pheap[parent]->key,m_pheap[index]->key))
+                    return;
+                Slot* ps = m_pheap[index];
+                m_pheap[index] = m_pheap[parent];
+                m_pheap[parent] = ps;
+                index = parent;
+            }
+        }
+        bool begin() {
+            if(nullptr!=m_pheap)
+                return true;
+            if(0==m_k)
+                return false;
+            // the heap, then the slots, then their data
+            size_t count = m_k+1;
+            uint8_t* p = (uint8_t*)m_pool.alloc(m_k*sizeof(Slot*)+count*(sizeof(Slot)+m_rowCapacity));
+            if(nullptr==p)
+                return false;
+            m_pheap = (Slot**)p;
+            Slot* pslots = (Slot*)(p+m_k*sizeof(Slot*));
+            uint8_t* pdata = (uint8_t*)(pslots+count);
+            for(size_t i = 0;i<count;++i) {
+                pslots[i].pdata = pdata+i*m_rowCapacity;
+                pslots[i].key = 0;
+                pslots[i].row = JsonElement();
+            }
+            m_pspare = pslots;
+            m_size = 0;
+            return true;
+        }
+        // indicates whether a row with the key would be kept
+        bool admits(double key) const {
+            return m_size<m_k || better(key,m_pheap[0]->key);
+        }
+        // moves the spare slot into the heap, and makes the slot it replaces the spare
+        void admit() {
+            Slot* ps = m_pspare;
+            if(m_size<m_k) {
+                // until the heap fills, it holds the slots before the spare
+                m_pheap[m_size] = ps;
+                siftUp(m_size++);
+                m_pspare = ps+1;
+                return;
+            }
+            m_pspare = m_pheap[0];
+            m_pheap[0] = ps;
+            siftDown(0,m_size);
+        }
+        // deep copies an element into the row being built
+        bool copy(const JsonElement& value,JsonElement& result) {
+            switch(value.type()) {
+                case JsonElement::String:
+                    return result.allocString(m_rowPool,value.string());
+                case JsonElement::Object:
+                    result.pobject(nullptr);
+                    for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe;pfe=pfe->pnext) {
+                        JsonElement* pe = (JsonElement*)m_rowPool.alloc(sizeof(JsonElement));
+                        if(nullptr==pe || !copy(*pfe->pvalue,*pe) || !result.addField(m_rowPool,pfe->name,pe))
+                            return false;
+                    }
+                    return true;
+                case JsonElement::Array:
+                    result.parray(nullptr);
+                    for(JsonArrayEntry* pae = value.parray();nullptr!=pae;pae=pae->pnext) {
+                        JsonElement* pe = (JsonElement*)m_rowPool.alloc(sizeof(JsonElement));
+                        if(nullptr==pe || !copy(*pae->pvalue,*pe) || !result.addItem(m_rowPool,pe))
+                            return false;
+                    }
+                    return true;
+            }
+            result = value;
+            return true;
+        }
+    public:
+        // keeps the k rows with the highest key, or the lowest if ascending, holding the listed
+        // fields. each row's fields are parsed into rowCapacity bytes, and rows that don't fit
+        // fail the evaluation
+        JsonTopK(MemoryPool& pool,size_t k,const char* keyField,const char* const* fields,size_t fieldCount,size_t rowCapacity,bool ascending=false) :
+                m_pool(pool),
+                m_k(k),
+                m_fieldCount(fieldCount<JSON_TOPK_MAX_FIELDS?fieldCount:JSON_TOPK_MAX_FIELDS),
+                m_rowCapacity(rowCapacity),
+                m_ascending(ascending),
+                m_pheap(nullptr),
+                m_size(0),
+                m_pspare(nullptr) {
+            m_fields[0] = keyField;
+            for(size_t i = 0;i<m_fieldCount;++i)
+                m_fields[i+1] = fields[i];
+        }
+        bool match(JsonReader& reader) override {
+            if(JsonReader::Object!=reader.nodeType())
+                return reader.skipSubtree() || !reader.hasError();
+            if(!begin())
+                return false;
+            m_rowPool.attach(m_pspare->pdata,m_rowCapacity);
+            m_pspare->row.pobject(nullptr);
+            bool found[JSON_TOPK_MAX_FIELDS+1];
+            memset(found,0,sizeof(found));
+            // once the row is rejected only the key is looked for, so the rest is scanned past
+            size_t count = m_fieldCount+1;
+            bool result = true;
+            while(result) {
+                int i = reader.skipToFieldOf(m_fields,count);
+                if(0>i || !reader.read())
+                    break;
+                if(found[i]) {
+                    result = reader.skipSubtree() || !reader.hasError();
+                    continue;
+                }
+                found[i] = true;
+                if(0==i) {
+                    // a long number is only complete at the end of its parts
+                    while(JsonReader::ValuePart==reader.nodeType() && reader.read());
+                    int8_t type = reader.valueType();
+                    if(JsonReader::Integer==type)
+                        m_pspare->key = (double)reader.integerValue();
+                    else if(JsonReader::Real==type)
+                        m_pspare->key = reader.realValue();
+                    if((JsonReader::Integer!=type && JsonReader::Real!=type) || !admits(m_pspare->key))
+                        count = 1;
+                    result = reader.skipSubtree() || !reader.hasError();
+                } else if(1==count)
+                    result = reader.skipSubtree() || !reader.hasError();
+                else {
+                    JsonElement* pe = (JsonElement*)m_rowPool.alloc(sizeof(JsonElement));
+                    result = nullptr!=pe &&
+                        reader.parseSubtree(m_rowPool,pe) &&
+                        m_pspare->row.addFieldPooled(m_rowPool,(char*)m_fields[i],pe);
+                }
+            }
+            if(!result || reader.hasError() || JsonReader::EndObject!=reader.nodeType())
+                return false;
+            // rows without the key don't rank
+            if(found[0] && 1<count)
+                admit();
+            return reader.read() || !reader.hasError();
+        }
+        bool match(const JsonElement& value) override {
+            if(JsonElement::Object!=value.type())
+                return true;
+            if(!begin())
+                return false;
+            const JsonElement* pkey = nullptr;
+            for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe && nullptr==pkey;pfe=pfe->pnext) {
+                if(0==strcmp(pfe->name,m_fields[0]))
+                    pkey = pfe->pvalue;
+            }
+            if(nullptr==pkey || (JsonElement::Integer!=pkey->type() && JsonElement::Real!=pkey->type()))
+                return true;
+            m_pspare->key = (JsonElement::Integer==pkey->type())?(double)pkey->integer():pkey->real();
+            if(!admits(m_pspare->key))
+                return true;
+            // the row shares the fields' values, so they have to be copied into the slot
+            m_rowPool.attach(m_pspare->pdata,m_rowCapacity);
+            m_pspare->row.pobject(nullptr);
+            for(size_t i = 1;i<=m_fieldCount;++i) {
+                for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe;pfe=pfe->pnext) {
+                    if(0!=strcmp(pfe->name,m_fields[i]))
+                        continue;
+                    JsonElement* pe = (JsonElement*)m_rowPool.alloc(sizeof(JsonElement));
+                    if(nullptr==pe || !copy(*pfe->pvalue,*pe) || !m_pspare->row.addFieldPooled(m_rowPool,(char*)m_fields[i],pe))
+                        return false;
+                    break;
+                }
+            }
+            admit();
+            return true;
+        }
+        // the number of rows kept
+        size_t size() const { return m_size; }
+        // orders the rows best first. call it once the evaluation is done, after which
+        // no more rows can be added
+        void sort() {
+            for(size_t end = m_size;1<end;--end) {
+                Slot* ps = m_pheap[0];
+                m_pheap[0] = m_pheap[end-1];
+                m_pheap[end-1] = ps;
+                siftDown(0,end-1);
+            }
+        }
+        // the key and fields of the row at the specified index
+        double key(size_t index) const { return m_pheap[index]->key; }
+        const JsonElement& row(size_t index) const { return m_pheap[index]->row; }
+    };
+}
+#endif
@@ -0,0 +1,407 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONBIND_HPP
+#define HTCW_JSONBIND_HPP
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#include <string.h>
+#endif
+#include "JsonReader.hpp"
+#include "JsonPath.hpp"
+// the number of fields a bound struct can have. binding more fails the build
+#ifndef JSON_BIND_MAX_FIELDS
+#define JSON_BIND_MAX_FIELDS 64
+#endif
+// the table holds field indices in bytes
+#if JSON_BIND_MAX_FIELDS>255
+#error "JSON_BIND_MAX_FIELDS can't be more than 255"
+#endif
+
+namespace json {
+    // hashes a field name with FNV-1a. it's constexpr so bound fields are hashed at compile time
+    constexpr uint32_t jsonBindHash(const char* sz,uint32_t hash=2166136261UL) {
+        return (0==*sz)?hash:jsonBindHash(sz+1,(hash^(uint8_t)*sz)*16777619UL);
+    }
+    // reads the value under the cursor into a member, and moves past the value. the count
+    // is the member that receives the number of elements of an array, or null
+    typedef bool(*JsonBindReader)(JsonReader& reader,void* pmember,size_t* pcount);
+    // copies a parsed value into a member, as a JsonBindReader reads one
+    typedef bool(*JsonBindAssigner)(const JsonElement& value,void* pmember,size_t* pcount);
+    // one bound member of a struct
+    struct JsonBindField {
+        const char* name;
+        uint32_t hash;
+        size_t offset;
+        // the offset of the array's count member, or (size_t)-1
+        size_t countOffset;
+        JsonBindReader read;
+        JsonBindAssigner assign;
+    };
+    // the fields of a bound struct, with a perfect hash over their names
+    class JsonBindTable {
+        const JsonBindField* m_pfields;
+        size_t m_count;
+        uint32_t m_seed;
+        uint8_t m_shift;
+        // false in the unlikely case no seed was found, which falls back to a linear search
+        bool m_perfect;
+        // field indices plus one, 0 for empty
+        uint8_t m_slots[JSON_BIND_MAX_FIELDS*4];
+        size_t slot(uint32_t hash) const {
+            return (size_t)(((hash^m_seed)*2654435761UL)&0xFFFFFFFFUL)>>m_shift;
+        }
+        // finds a seed that gives every field its own slot
+        bool build(size_t slotCount) {
+            m_shift = 32;
+            for(size_t s = slotCount;1<s;s>>=1)
+                --m_shift;
+            for(m_seed = 0;m_seed<1024;++m_seed) {
+                memset(m_slots,0,sizeof(m_slots));
+                size_t i = 0;
+                while(i<m_count) {
+                    uint8_t& s = m_slots[slot(m_pfields[i].hash)];
+                    if(0!=s)
+                        break;
+                    s = (uint8_t)(i+1);
+                    ++i;
+                }
+                if(i==m_count)
+                    return true;
+            }
+            return false;
+        }
+    public:
+        // JSON_BIND_END() checks the count at compile time. fields past the maximum are
+        // never found
+        JsonBindTable(const JsonBindField* pfields,size_t count) : m_pfields(pfields),m_count(count<JSON_BIND_MAX_FIELDS?count:JSON_BIND_MAX_FIELDS) {
+            size_t slots = 2;
+            while(slots<m_count*2)
+                slots*=2;
+            // more room makes a seed easier to find
+            while(!(m_perfect = build(slots)) && slots<sizeof(m_slots))
+                slots*=2;
+        }
+        // finds the field with the specified name, or null
+        const JsonBindField* find(const char* name) const {
+            if(!m_perfect) {
+                for(size_t i = 0;i<m_count;++i) {
+                    if(0==strcmp(m_pfields[i].name,name))
+                        return m_pfields+i;
+                }
+                return nullptr;
+            }
+            uint8_t s = m_slots[slot(jsonBindHash(name))];
+            if(0==s)
+                return nullptr;
+            const JsonBindField* pf = m_pfields+(s-1);
+            return (0==strcmp(pf->name,name))?pf:nullptr;
+        }
+        size_t size() const { return m_count; }
+        const JsonBindField* fields() const { return m_pfields; }
+    };
+    // reads JSON values into C++ types. structs are bound with the JSON_BIND_ macros
+    template<typename T> struct JsonBindTraits;
+    struct JsonBindValue {
+        static bool skip(JsonReader& reader) {
+            return reader.skipSubtree() || !reader.hasError();
+        }
+        // reads past the parts of a long value, leaving the reader on its last node
+        static bool complete(JsonReader& reader) {
+            while(JsonReader::ValuePart==reader.nodeType()) {
+                if(!reader.read())
+                    return false;
+            }
+            return true;
+        }
+        // nulls leave the member as it was
+        static bool isNull(JsonReader& reader) {
+            return JsonReader::Value==reader.nodeType() && JsonReader::Null==reader.valueType();
+        }
+        static bool next(JsonReader& reader) {
+            return reader.read() || !reader.hasError();
+        }
+        static bool readInteger(JsonReader& reader,long long& result) {
+            if(!complete(reader) || JsonReader::Integer!=reader.valueType())
+                return false;
+            result = reader.integerValue();
+            return true;
+        }
+        static bool readObject(JsonReader& reader,const JsonBindTable& table,void* pvalue) {
+            if(isNull(reader))
+                return next(reader);
+            if(JsonReader::Object!=reader.nodeType() || !reader.read())
+                return false;
+            while(JsonReader::Field==reader.nodeType()) {
+                const JsonBindField* pf = table.find(reader.value());
+                if(nullptr==pf) {
+                    // skipping from the field avoids loading its value
+                    if(!skip(reader))
+                        return false;
+                    continue;
+                }
+                size_t* pcount = ((size_t)-1==pf->countOffset)?nullptr:(size_t*)(((uint8_t*)pvalue)+pf->countOffset);
+                if(!reader.read() || !pf->read(reader,((uint8_t*)pvalue)+pf->offset,pcount))
+                    return false;
+            }
+            if(JsonReader::EndObject!=reader.nodeType())
+                return false;
+            return next(reader);
+        }
+        static bool assignObject(const JsonElement& value,const JsonBindTable& table,void* pvalue) {
+            if(JsonElement::Null==value.type())
+                return true;
+            if(JsonElement::Object!=value.type())
+                return false;
+            for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe;pfe=pfe->pnext) {
+                const JsonBindField* pf = table.find(pfe->name);
+                if(nullptr==pf)
+                    continue;
+                size_t* pcount = ((size_t)-1==pf->countOffset)?nullptr:(size_t*)(((uint8_t*)pvalue)+pf->countOffset);
+                if(!pf->assign(*pfe->pvalue,((uint8_t*)pvalue)+pf->offset,pcount))
+                    return false;
+            }
+            return true;
+        }
+    };
+    // tells whether a value fits in an integer type. it's specialized on whether the type is
+    // signed so unsigned types are never compared with zero
+    template<typename T,bool TSigned = ((T)-1<(T)0)> struct JsonBindRange {
+        static bool fits(long long value) {
+            return (long long)(T)value==value;
+        }
+    };
+    template<typename T> struct JsonBindRange<T,false> {
+        static bool fits(long long value) {
+            return 0<=value && (unsigned long long)(T)value==(unsigned long long)value;
+        }
+    };
+#define JSON_BIND_INTEGER(T) \
+    template<> struct JsonBindTraits<T> { \
+        static bool store(long long value,void* pmember) { \
+            if(!JsonBindRange<T>::fits(value)) \
+                return false; \
+            *(T*)pmember = (T)value; \
+            return true; \
+        } \
+        static bool read(JsonReader& reader,void* pmember,size_t* pcount) { \
+            (void)pcount; \
+            if(JsonBindValue::isNull(reader)) \
+                return JsonBindValue::next(reader); \
+            long long value; \
+            if(!JsonBindValue::readInteger(reader,value) || !store(value,pmember)) \
+                return false; \
+            return JsonBindValue::next(reader); \
+        } \
+        static bool assign(const JsonElement& value,void* pmember,size_t* pcount) { \
+            (void)pcount; \
+            if(JsonElement::Null==value.type()) \
+                return true; \
+            return JsonElement::Integer==value.type() && store(value.integer(),pmember); \
+        } \
+    }
+    JSON_BIND_INTEGER(signed char);
+    JSON_BIND_INTEGER(unsigned char);
+    JSON_BIND_INTEGER(short);
+    JSON_BIND_INTEGER(unsigned short);
+    JSON_BIND_INTEGER(int);
+    JSON_BIND_INTEGER(unsigned int);
+    JSON_BIND_INTEGER(long);
+    JSON_BIND_INTEGER(unsigned long);
+    JSON_BIND_INTEGER(long long);
+    JSON_BIND_INTEGER(unsigned long long);
+#undef JSON_BIND_INTEGER
+#define JSON_BIND_REAL(T) \
+    template<> struct JsonBindTraits<T> { \
+        static bool read(JsonReader& reader,void* pmember,size_t* pcount) { \
+            (void)pcount; \
+            if(JsonBindValue::isNull(reader)) \
+                return JsonBindValue::next(reader); \
+            if(!JsonBindValue::complete(reader)) \
+                return false; \
+            if(JsonReader::Integer==reader.valueType()) \
+                *(T*)pmember = (T)reader.integerValue(); \
+            else if(JsonReader::Real==reader.valueType()) \
+                *(T*)pmember = (T)reader.realValue(); \
+            else \
+                return false; \
+            return JsonBindValue::next(reader); \
+        } \
+        static bool assign(const JsonElement& value,void* pmember,size_t* pcount) { \
+            (void)pcount; \
+            if(JsonElement::Integer==value.type()) \
+                *(T*)pmember = (T)value.integer(); \
+            else if(JsonElement::Real==value.type()) \
+                *(T*)pmember = (T)value.real(); \
+            else \
+                return JsonElement::Null==value.type(); \
+            return true; \
+        } \
+    }
+    JSON_BIND_REAL(float);
+    JSON_BIND_REAL(double);
+#undef JSON_BIND_REAL
+    template<> struct JsonBindTraits<bool> {
+        static bool read(JsonReader& reader,void* pmember,size_t* pcount) {
+            (void)pcount;
+            if(JsonBindValue::isNull(reader))
+                return JsonBindValue::next(reader);
+            if(!JsonBindValue::complete(reader) || JsonReader::Boolean!=reader.valueType())
+                return false;
+            *(bool*)pmember = reader.booleanValue();
+            return JsonBindValue::next(reader);
+        }
+        static bool assign(const JsonElement& value,void* pmember,size_t* pcount) {
+            (void)pcount;
+            if(JsonElement::Boolean==value.type())
+                *(bool*)pmember = value.boolean();
+            else
+                return JsonElement::Null==value.type();
+            return true;
+        }
+    };
+    // fixed size strings. strings that don't fit with their terminator fail
+    template<size_t N> struct JsonBindTraits<char[N]> {
+        static bool read(JsonReader& reader,void* pmember,size_t* pcount) {
+            (void)pcount;
+            if(JsonBindValue::isNull(reader))
+                return JsonBindValue::next(reader);
+            if(JsonReader::String!=reader.valueType())
+                return false;
+            char* sz = (char*)pmember;
+            size_t size = 0;
+            while(true) {
+                // the node after a string's parts has nothing left in it
+                if(JsonReader::EndValuePart!=reader.nodeType()) {
+                    size_t len = strlen(reader.value());
+                    if(size+len>=N)
+                        return false;
+                    memcpy(sz+size,reader.value(),len);
+                    size+=len;
+                }
+                if(JsonReader::ValuePart!=reader.nodeType())
+                    break;
+                if(!reader.read())
+                    return false;
+            }
+            sz[size] = 0;
+            return JsonBindValue::next(reader);
+        }
+        static bool assign(const JsonElement& value,void* pmember,size_t* pcount) {
+            (void)pcount;
+            if(JsonElement::Null==value.type())
+                return true;
+            if(JsonElement::String!=value.type())
+                return false;
+            size_t size = strlen(value.string());
+            if(size>=N)
+                return false;
+            memcpy(pmember,value.string(),size+1);
+            return true;
+        }
+    };
+    // bounded arrays. the count member receives the number of elements, and arrays with more
+    // elements than fit fail
+    template<typename T,size_t N> struct JsonBindTraits<T[N]> {
+        static bool read(JsonReader& reader,void* pmember,size_t* pcount) {
+            if(JsonBindValue::isNull(reader))
+                return JsonBindValue::next(reader);
+            if(JsonReader::Array!=reader.nodeType() || !reader.read())
+                return false;
+            T* pitems = (T*)pmember;
+            size_t count = 0;
+            while(JsonReader::EndArray!=reader.nodeType()) {
+                if(count==N || JsonReader::EndDocument==reader.nodeType() || reader.hasError())
+                    return false;
+                if(!JsonBindTraits<T>::read(reader,pitems+count,nullptr))
+                    return false;
+                ++count;
+            }
+            if(nullptr!=pcount)
+                *pcount = count;
+            return JsonBindValue::next(reader);
+        }
+        static bool assign(const JsonElement& value,void* pmember,size_t* pcount) {
+            if(JsonElement::Null==value.type())
+                return true;
+            if(JsonElement::Array!=value.type())
+                return false;
+            T* pitems = (T*)pmember;
+            size_t count = 0;
+            for(JsonArrayEntry* pae = value.parray();nullptr!=pae;pae=pae->pnext) {
+                if(count==N || !JsonBindTraits<T>::assign(*pae->pvalue,pitems+count,nullptr))
+                    return false;
+                ++count;
+            }
+            if(nullptr!=pcount)
+                *pcount = count;
+            return true;
+        }
+    };
+    // structs bound with the JSON_BIND_ macros, found through the table function they define
+    template<typename T> struct JsonBindTraits {
+        static bool read(JsonReader& reader,void* pmember,size_t* pcount) {
+            (void)pcount;
+            return JsonBindValue::readObject(reader,jsonBindTable((T*)nullptr),pmember);
+        }
+        static bool assign(const JsonElement& value,void* pmember,size_t* pcount) {
+            (void)pcount;
+            return JsonBindValue::assignObject(value,jsonBindTable((T*)nullptr),pmember);
+        }
+    };
+    // reads JSON straight into bound structs, without elements or a pool
+    class JsonBind {
+    public:
+        // reads the value under the reader's cursor into the value, leaving the reader on the
+        // node after it. fields that aren't bound are skipped, and fields that are null leave
+        // their members alone. values of the wrong type or that don't fit fail
+        template<typename T> static bool read(JsonReader& reader,T& value) {
+            if(JsonReader::Initial==reader.nodeType() && !reader.read())
+                return false;
+            return JsonBindTraits<T>::read(reader,&value,nullptr);
+        }
+        // copies a parsed value into the value, the same way
+        template<typename T> static bool assign(const JsonElement& element,T& value) {
+            return JsonBindTraits<T>::assign(element,&value,nullptr);
+        }
+    };
+    // reads each match of a query into a bound struct and hands it to bound()
+    template<typename T> class JsonBindSink : public JsonQuerySink {
+    public:
+        virtual bool bound(const T& value)=0;
+        bool match(JsonReader& reader) override {
+            T value = T();
+            return JsonBind::read(reader,value) && bound(value);
+        }
+        bool match(const JsonElement& value) override {
+            T item = T();
+            return JsonBind::assign(value,item) && bound(item);
+        }
+    };
+}
+// binds a struct's members to JSON fields. use it at the struct's namespace scope:
+// JSON_BIND_BEGIN(episode)
+//     JSON_BIND_FIELD(id)
+//     JSON_BIND_FIELD_NAMED(title,"name")
+//     JSON_BIND_ARRAY(crew,crew_count)
+// JSON_BIND_END()
+// members can be integers, floating point numbers, bool, char[N], other bound structs, and
+// arrays of those. array members need a size_t member for their count
+#define JSON_BIND_BEGIN(type) \
+    inline const json::JsonBindTable& jsonBindTable(type*) { \
+        typedef type json_bind_type; \
+        static const json::JsonBindField fields[] = {
+#define JSON_BIND_FIELD_NAMED(member,name) \
+            {name,json::jsonBindHash(name),offsetof(json_bind_type,member),(size_t)-1,&json::JsonBindTraits<decltype(json_bind_type::member)>::read,&json::JsonBindTraits<decltype(json_bind_type::member)>::assign},
+#define JSON_BIND_FIELD(member) JSON_BIND_FIELD_NAMED(member,#member)
+#define JSON_BIND_ARRAY_NAMED(member,count,name) \
+            {name,json::jsonBindHash(name),offsetof(json_bind_type,member),offsetof(json_bind_type,count),&json::JsonBindTraits<decltype(json_bind_type::member)>::read,&json::JsonBindTraits<decltype(json_bind_type::member)>::assign},
+#define JSON_BIND_ARRAY(member,count) JSON_BIND_ARRAY_NAMED(member,count,#member)
+#define JSON_BIND_END() \
+        }; \
+        static_assert(sizeof(fields)/sizeof(fields[0])<=JSON_BIND_MAX_FIELDS,"too many bound fields, raise JSON_BIND_MAX_FIELDS"); \
+        static const json::JsonBindTable table(fields,sizeof(fields)/sizeof(fields[0])); \
+        return table; \
+    }
+#endif
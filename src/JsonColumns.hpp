@@ -0,0 +1,453 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONCOLUMNS_HPP
+#define HTCW_JSONCOLUMNS_HPP
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#include <string.h>
+#endif
+#include "MemoryPool.hpp"
+#include "LexSink.hpp"
+#include "JsonReader.hpp"
+#include "JsonPath.hpp"
+// the number of columns a projection can have
+#define JSON_COLUMNS_MAX 32
+// the alignment of each array a column allocates, so vectorized code can load them whole
+#ifndef JSON_COLUMNS_ALIGNMENT
+#ifdef ARDUINO
+#define JSON_COLUMNS_ALIGNMENT 8
+#else
+#define JSON_COLUMNS_ALIGNMENT 64
+#endif
+#endif
+
+namespace json {
+    // declares a column of a JsonColumns projection
+    struct JsonColumn {
+        // 64-bit integers. other values are null
+        static const int8_t Integer = JsonElement::Integer;
+        // doubles. integers are converted and other values are null
+        static const int8_t Real = JsonElement::Real;
+        // one byte per value, 0 or 1. other values are null
+        static const int8_t Boolean = JsonElement::Boolean;
+        // 32-bit codes into a dictionary of the column's distinct strings. other values are null
+        static const int8_t String = JsonElement::String;
+        // the field of each row the column holds
+        const char* field;
+        int8_t type;
+    };
+    class JsonColumns;
+    // receives the batches of a JsonColumns projection as they fill up
+    class JsonColumnSink {
+    public:
+        virtual bool batch(const JsonColumns& columns)=0;
+        virtual ~JsonColumnSink() {}
+    };
+    // the header of a batch in a columnar file. it's followed for each column by its type,
+    // the length of its field name and the name, and then its validity bitmap and values.
+    // string columns then have their dictionary's entry count, its offsets, and its bytes.
+    // values are in the byte order of the machine that wrote them
+    struct JsonColumnsHeader {
+        // "JCOL"
+        char magic[4];
+        uint16_t version;
+        // 0x0102 in the writer's byte order
+        uint16_t byteOrder;
+        uint32_t columns;
+        uint32_t rows;
+    };
+    // projects the objects a query matches into columns, one row per object. each column
+    // is a contiguous array of values with a validity bitmap, so a batch can be handed to
+    // vectorized code or written out as is, and no element is built per row. only the fields
+    // the columns hold are read. rows accumulate into a batch of fixed capacity allocated
+    // from the pool, which is handed to the sink and cleared when it fills.
+    // the pool must not be used for anything else while the projection is in use
+    class JsonColumns : public JsonQuerySink {
+        struct Column {
+            // one bit per row, set if the value is valid
+            uint8_t* pvalid;
+            uint8_t* pvalues;
+            // the dictionary's hash slots, holding codes plus one
+            uint32_t* pslots;
+            // the offset of each entry's bytes, plus where the next one goes
+            uint32_t* poffsets;
+            char* pbytes;
+            size_t entries;
+        };
+        MemoryPool& m_pool;
+        JsonColumnSink* m_psink;
+        const char* m_fields[JSON_COLUMNS_MAX];
+        int8_t m_types[JSON_COLUMNS_MAX];
+        Column m_columns[JSON_COLUMNS_MAX];
+        size_t m_count;
+        // so wide rows find their columns with a hash rather than a compare per column
+        JsonFieldTable m_table;
+        size_t m_capacity;
+        size_t m_dictionaryCapacity;
+        size_t m_dictionaryBytes;
+        size_t m_slotCount;
+        size_t m_rows;
+        bool m_begun;
+        JsonColumns(const JsonColumns& rhs)=delete;
+        JsonColumns& operator=(const JsonColumns& rhs)=delete;
+        static size_t valueSize(int8_t type) {
+            switch(type) {
+                case JsonColumn::Integer:
+                    return sizeof(int64_t);
+                case JsonColumn::Real:
+                    return sizeof(double);
+                case JsonColumn::Boolean:
+                    return 1;
+            }
+            return sizeof(uint32_t);
+        }
+        static size_t bitmapSize(size_t rows) {
+            return (rows+7)/8;
+        }
+        // allocates from the pool, padding to the column alignment first
+        void* alloc(size_t size) {
+            size_t pad = (JSON_COLUMNS_ALIGNMENT-((uintptr_t)m_pool.next())%JSON_COLUMNS_ALIGNMENT)%JSON_COLUMNS_ALIGNMENT;
+            if(0<pad && nullptr==m_pool.alloc(pad))
+                return nullptr;
+            return m_pool.alloc(size);
+        }
+        bool begin() {
+            if(m_begun)
+                return true;
+            // the slots are kept at most half full
+            m_slotCount = 2;
+            while(m_slotCount<m_dictionaryCapacity*2)
+                m_slotCount*=2;
+            for(size_t i = 0;i<m_count;++i) {
+                Column& c = m_columns[i];
+                c.pvalid = (uint8_t*)alloc(bitmapSize(m_capacity));
+                c.pvalues = (uint8_t*)alloc(m_capacity*valueSize(m_types[i]));
+                if(nullptr==c.pvalid || nullptr==c.pvalues)
+                    return false;
+                if(JsonColumn::String==m_types[i]) {
+                    c.pslots = (uint32_t*)alloc(m_slotCount*sizeof(uint32_t));
+                    c.poffsets = (uint32_t*)alloc((m_dictionaryCapacity+1)*sizeof(uint32_t));
+                    c.pbytes = (char*)alloc(m_dictionaryBytes);
+                    if(nullptr==c.pslots || nullptr==c.poffsets || nullptr==c.pbytes)
+                        return false;
+                }
+            }
+            m_begun = true;
+            clear();
+            return true;
+        }
+        static uint32_t hash(const char* sz,size_t size) {
+            // FNV-1a
+            uint32_t result = 2166136261UL;
+            for(size_t i = 0;i<size;++i)
+                result = (result^(uint8_t)sz[i])*16777619UL;
+            return result;
+        }
+        // appends to the string following the column's dictionary
+        bool appendString(Column& c,size_t& size,const char* sz) {
+            size_t len = strlen(sz);
+            if(c.poffsets[c.entries]+size+len>m_dictionaryBytes)
+                return false;
+            memcpy(c.pbytes+c.poffsets[c.entries]+size,sz,len);
+            size+=len;
+            return true;
+        }
+        // finds or adds the string following the column's dictionary, returning its code
+        bool encode(Column& c,size_t size,uint32_t& code) {
+            const char* sz = c.pbytes+c.poffsets[c.entries];
+            size_t mask = m_slotCount-1;
+            size_t i = hash(sz,size)&mask;
+            for(;0!=c.pslots[i];i=(i+1)&mask) {
+                uint32_t e = c.pslots[i]-1;
+                if(c.poffsets[e+1]-c.poffsets[e]==size && 0==memcmp(c.pbytes+c.poffsets[e],sz,size)) {
+                    code = e;
+                    return true;
+                }
+            }
+            if(c.entries==m_dictionaryCapacity)
+                return false;
+            code = (uint32_t)c.entries++;
+            c.poffsets[c.entries] = (uint32_t)(c.poffsets[code]+size);
+            c.pslots[i] = code+1;
+            return true;
+        }
+        // stores the value under the cursor in the row, and moves past it. a string that
+        // doesn't fit its dictionary sets full instead
+        bool store(JsonReader& reader,size_t column,bool& full) {
+            Column& c = m_columns[column];
+            int8_t type = m_types[column];
+            switch(reader.nodeType()) {
+                case JsonReader::Object:
+                case JsonReader::Array:
+                    return reader.skipSubtree() || !reader.hasError();
+            }
+            int8_t valueType = reader.valueType();
+            size_t size = 0;
+            bool fits = true;
+            while(true) {
+                if(JsonColumn::String==type && JsonReader::String==valueType && JsonReader::EndValuePart!=reader.nodeType())
+                    fits = fits && appendString(c,size,reader.value());
+                if(JsonReader::ValuePart!=reader.nodeType())
+                    break;
+                if(!reader.read())
+                    return false;
+            }
+            // numbers and literals only have a value at the end of their parts
+            if(JsonReader::String!=valueType)
+                valueType = reader.valueType();
+            bool valid = true;
+            switch(type) {
+                case JsonColumn::Integer:
+                    if((valid = JsonReader::Integer==valueType))
+                        ((int64_t*)c.pvalues)[m_rows] = reader.integerValue();
+                    break;
+                case JsonColumn::Real:
+                    if((valid = JsonReader::Integer==valueType))
+                        ((double*)c.pvalues)[m_rows] = (double)reader.integerValue();
+                    else if((valid = JsonReader::Real==valueType))
+                        ((double*)c.pvalues)[m_rows] = reader.realValue();
+                    break;
+                case JsonColumn::Boolean:
+                    if((valid = JsonReader::Boolean==valueType))
+                        c.pvalues[m_rows] = reader.booleanValue()?1:0;
+                    break;
+                case JsonColumn::String:
+                    valid = JsonReader::String==valueType;
+                    if(valid && (!fits || !encode(c,size,((uint32_t*)c.pvalues)[m_rows])))
+                        full = true;
+                    break;
+            }
+            if(valid)
+                c.pvalid[m_rows/8]|=(uint8_t)(1<<(m_rows%8));
+            return reader.read() || !reader.hasError();
+        }
+        // stores a parsed value in the row. a string that doesn't fit its dictionary sets full
+        void store(const JsonElement& value,size_t column,bool& full) {
+            Column& c = m_columns[column];
+            bool valid = true;
+            switch(m_types[column]) {
+                case JsonColumn::Integer:
+                    if((valid = JsonElement::Integer==value.type()))
+                        ((int64_t*)c.pvalues)[m_rows] = value.integer();
+                    break;
+                case JsonColumn::Real:
+                    if((valid = JsonElement::Integer==value.type()))
+                        ((double*)c.pvalues)[m_rows] = (double)value.integer();
+                    else if((valid = JsonElement::Real==value.type()))
+                        ((double*)c.pvalues)[m_rows] = value.real();
+                    break;
+                case JsonColumn::Boolean:
+                    if((valid = JsonElement::Boolean==value.type()))
+                        c.pvalues[m_rows] = value.boolean()?1:0;
+                    break;
+                case JsonColumn::String: {
+                    valid = JsonElement::String==value.type();
+                    size_t size = 0;
+                    if(valid && (!appendString(c,size,value.string()) || !encode(c,size,((uint32_t*)c.pvalues)[m_rows])))
+                        full = true;
+                    break;
+                }
+            }
+            if(valid)
+                c.pvalid[m_rows/8]|=(uint8_t)(1<<(m_rows%8));
+        }
+        // blanks the next row
+        void clearRow() {
+            for(size_t i = 0;i<m_count;++i) {
+                Column& c = m_columns[i];
+                c.pvalid[m_rows/8]&=(uint8_t)~(1<<(m_rows%8));
+                memset(c.pvalues+m_rows*valueSize(m_types[i]),0,valueSize(m_types[i]));
+            }
+        }
+        // indicates whether every dictionary has an entry free and the bytes for a string
+        // of the specified size
+        bool room(size_t size) const {
+            for(size_t i = 0;i<m_count;++i) {
+                const Column& c = m_columns[i];
+                if(JsonColumn::String==m_types[i] && (c.entries==m_dictionaryCapacity || c.poffsets[c.entries]+size>m_dictionaryBytes))
+                    return false;
+            }
+            return true;
+        }
+        bool flush() {
+            if(0==m_rows)
+                return true;
+            if(nullptr==m_psink || !m_psink->batch(*this))
+                return false;
+            clear();
+            return true;
+        }
+    public:
+        // projects into the specified columns, holding batches of rowCapacity rows. each string
+        // column's dictionary holds up to dictionaryCapacity distinct strings of dictionaryBytes
+        // in total. the sink receives each batch when it fills, which includes a dictionary
+        // running low on room for another captured string. without one a full batch fails the
+        // evaluation, as does a string longer than the source's capture that doesn't fit
+        JsonColumns(MemoryPool& pool,const JsonColumn* columns,size_t count,size_t rowCapacity,size_t dictionaryCapacity,size_t dictionaryBytes,JsonColumnSink* psink=nullptr) :
+                m_pool(pool),
+                m_psink(psink),
+                m_count(count<JSON_COLUMNS_MAX?count:JSON_COLUMNS_MAX),
+                m_table(m_fields,0),
+                m_capacity(rowCapacity),
+                m_dictionaryCapacity(dictionaryCapacity),
+                m_dictionaryBytes(dictionaryBytes),
+                m_slotCount(0),
+                m_rows(0),
+                m_begun(false) {
+            for(size_t i = 0;i<m_count;++i) {
+                m_fields[i] = columns[i].field;
+                m_types[i] = columns[i].type;
+            }
+            m_table = JsonFieldTable(m_fields,m_count);
+            memset(m_columns,0,sizeof(m_columns));
+        }
+        bool match(JsonReader& reader) override {
+            if(JsonReader::Object!=reader.nodeType())
+                return reader.skipSubtree() || !reader.hasError();
+            if(!begin() || 0==m_capacity)
+                return false;
+            if((m_rows==m_capacity || !room(reader.source().captureCapacity())) && !flush())
+                return false;
+            clearRow();
+            bool found[JSON_COLUMNS_MAX];
+            memset(found,0,sizeof(found));
+            bool full = false;
+            bool result = true;
+            while(result) {
+                int i = reader.skipToFieldOf(m_fields,m_count,&m_table);
+                if(0>i || !reader.read())
+                    break;
+                if(found[i])
+                    result = reader.skipSubtree() || !reader.hasError();
+                else
+                    result = store(reader,i,full);
+                found[i] = true;
+            }
+            if(!result || reader.hasError() || JsonReader::EndObject!=reader.nodeType())
+                return false;
+            // the batch was flushed early enough unless a string was longer than the capture
+            if(full)
+                return false;
+            ++m_rows;
+            return reader.read() || !reader.hasError();
+        }
+        bool match(const JsonElement& value) override {
+            if(JsonElement::Object!=value.type())
+                return true;
+            if(!begin() || 0==m_capacity)
+                return false;
+            if(m_rows==m_capacity && !flush())
+                return false;
+            // the strings are all there, so a row that doesn't fit flushes the batch and
+            // is stored again
+            for(bool retry = false;;retry = true) {
+                clearRow();
+                bool found[JSON_COLUMNS_MAX];
+                memset(found,0,sizeof(found));
+                bool full = false;
+                for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe;pfe=pfe->pnext) {
+                    int i = m_table.find(pfe->name,strlen(pfe->name));
+                    if(0>i || found[i])
+                        continue;
+                    found[i] = true;
+                    store(*pfe->pvalue,i,full);
+                }
+                if(!full)
+                    break;
+                if(retry || 0==m_rows || !flush())
+                    return false;
+            }
+            ++m_rows;
+            return true;
+        }
+        // hands the last rows to the sink
+        bool finish() {
+            return flush();
+        }
+        // empties the batch, including the dictionaries
+        void clear() {
+            m_rows = 0;
+            if(!m_begun)
+                return;
+            for(size_t i = 0;i<m_count;++i) {
+                Column& c = m_columns[i];
+                memset(c.pvalid,0,bitmapSize(m_capacity));
+                if(JsonColumn::String==m_types[i]) {
+                    memset(c.pslots,0,m_slotCount*sizeof(uint32_t));
+                    c.poffsets[0] = 0;
+                    c.entries = 0;
+                }
+            }
+        }
+        // the number of columns
+        size_t columns() const { return m_count; }
+        const char* field(size_t column) const { return m_fields[column]; }
+        int8_t type(size_t column) const { return m_types[column]; }
+        // the number of rows in the batch
+        size_t rows() const { return m_rows; }
+        // the validity bitmap of a column, with bit n%8 of byte n/8 set if row n has a value
+        const uint8_t* valid(size_t column) const { return m_columns[column].pvalid; }
+        bool isNull(size_t column,size_t row) const {
+            return 0==(m_columns[column].pvalid[row/8]&(1<<(row%8)));
+        }
+        // the values of a column, or null if it's of another type. null values are 0
+        const int64_t* integers(size_t column) const {
+            return (JsonColumn::Integer==m_types[column])?(const int64_t*)m_columns[column].pvalues:nullptr;
+        }
+        const double* reals(size_t column) const {
+            return (JsonColumn::Real==m_types[column])?(const double*)m_columns[column].pvalues:nullptr;
+        }
+        const uint8_t* booleans(size_t column) const {
+            return (JsonColumn::Boolean==m_types[column])?m_columns[column].pvalues:nullptr;
+        }
+        const uint32_t* codes(size_t column) const {
+            return (JsonColumn::String==m_types[column])?(const uint32_t*)m_columns[column].pvalues:nullptr;
+        }
+        // the number of distinct strings in a string column
+        size_t dictionarySize(size_t column) const {
+            return (JsonColumn::String==m_types[column])?m_columns[column].entries:0;
+        }
+        // the string of a code in a string column, and its length. it isn't null terminated
+        const char* dictionaryString(size_t column,uint32_t code,size_t* psize=nullptr) const {
+            const Column& c = m_columns[column];
+            if(JsonColumn::String!=m_types[column] || code>=c.entries)
+                return nullptr;
+            if(nullptr!=psize)
+                *psize = c.poffsets[code+1]-c.poffsets[code];
+            return c.pbytes+c.poffsets[code];
+        }
+        // writes the batch in the columnar file format. batches can be written one after another
+        bool write(lex::LexSink& sink) const {
+            JsonColumnsHeader h;
+            memcpy(h.magic,"JCOL",4);
+            h.version = 1;
+            h.byteOrder = 0x0102;
+            h.columns = (uint32_t)m_count;
+            h.rows = (uint32_t)m_rows;
+            if(!sink.write((const char*)&h,sizeof(h)))
+                return false;
+            for(size_t i = 0;i<m_count;++i) {
+                const Column& c = m_columns[i];
+                int8_t type = m_types[i];
+                uint32_t len = (uint32_t)strlen(m_fields[i]);
+                if(!sink.write((const char*)&type,1) ||
+                        !sink.write((const char*)&len,sizeof(len)) ||
+                        !sink.write(m_fields[i],len) ||
+                        !sink.write((const char*)c.pvalid,bitmapSize(m_rows)) ||
+                        !sink.write((const char*)c.pvalues,m_rows*valueSize(type)))
+                    return false;
+                if(JsonColumn::String==type) {
+                    uint32_t entries = (uint32_t)c.entries;
+                    if(!sink.write((const char*)&entries,sizeof(entries)) ||
+                            !sink.write((const char*)c.poffsets,(entries+1)*sizeof(uint32_t)) ||
+                            !sink.write(c.pbytes,c.poffsets[entries]))
+                        return false;
+                }
+            }
+            return true;
+        }
+    };
+}
+#endif
@@ -0,0 +1,184 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONCOROUTINE_HPP
+#define HTCW_JSONCOROUTINE_HPP
+// coroutines need C++20. everything else stays C++11, so without them this header is empty
+#if !defined(ARDUINO) && defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define HTCW_JSON_COROUTINES 1
+#endif
+#endif
+#ifdef HTCW_JSON_COROUTINES
+#include <coroutine>
+#include <exception>
+#include "JsonReader.hpp"
+#include "JsonPush.hpp"
+
+namespace json {
+    // a coroutine that produces a T when awaited. it doesn't start until it's awaited, or until
+    // resume() is called on it from code that isn't a coroutine
+    template<typename T> class JsonTask {
+    public:
+        struct promise_type {
+            T value;
+            std::coroutine_handle<> continuation;
+            promise_type() : value(),continuation(nullptr) {
+            }
+            JsonTask get_return_object() {
+                return JsonTask(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            // hands control back to whoever awaited us
+            struct FinalAwaiter {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                    std::coroutine_handle<> continuation = handle.promise().continuation;
+                    return (nullptr!=continuation)?continuation:std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void return_value(T result) { value = result; }
+            // nothing in here throws
+            void unhandled_exception() { std::terminate(); }
+        };
+    private:
+        std::coroutine_handle<promise_type> m_handle;
+        JsonTask(const JsonTask& rhs)=delete;
+        JsonTask& operator=(const JsonTask& rhs)=delete;
+        explicit JsonTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {
+        }
+    public:
+        JsonTask(JsonTask&& rhs) : m_handle(rhs.m_handle) {
+            rhs.m_handle = nullptr;
+        }
+        ~JsonTask() {
+            if(m_handle)
+                m_handle.destroy();
+        }
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+            m_handle.promise().continuation = continuation;
+            return m_handle;
+        }
+        T await_resume() { return m_handle.promise().value; }
+        // starts or continues the task from code that isn't a coroutine
+        void resume() {
+            if(m_handle && !m_handle.done())
+                m_handle.resume();
+        }
+        bool done() const { return !m_handle || m_handle.done(); }
+        // the result, once done() is true
+        T result() const { return m_handle.promise().value; }
+    };
+    // reads JSON as it arrives from an asynchronous source without blocking a thread. when
+    // the reader runs out of input it awaits TSource::fill(JsonPushReader&), which should
+    // feed() the reader what's arrived and produce true, or call finish() or produce false at
+    // the end of the input
+    template<typename TSource> class JsonAsyncReader {
+        JsonPushReader m_reader;
+        TSource& m_source;
+        JsonAsyncReader(const JsonAsyncReader& rhs)=delete;
+        JsonAsyncReader& operator=(const JsonAsyncReader& rhs)=delete;
+        template<typename TFunc> JsonTask<bool> attempt(TFunc func) {
+            bool result;
+            while(!(result = func(m_reader)) && m_reader.needMoreInput()) {
+                if(!co_await m_source.fill(m_reader))
+                    m_reader.finish();
+            }
+            co_return result;
+        }
+    public:
+        JsonAsyncReader(lex::PushLexSource& input,TSource& source) : m_reader(input),m_source(source) {
+        }
+        // reads the next node, waiting for input as needed. produces false at the end or on an error
+        JsonTask<bool> read() {
+            return attempt([](JsonPushReader& reader) { return reader.read(); });
+        }
+        // skips the current subtree. see JsonPushReader::skipSubtree()
+        JsonTask<bool> skipSubtree() {
+            return attempt([](JsonPushReader& reader) { return reader.skipSubtree(); });
+        }
+        // moves to the first node of the next record of a stream of top level values
+        JsonTask<bool> nextRecord() {
+            return attempt([](JsonPushReader& reader) { return reader.nextRecord(); });
+        }
+        // the reader, for the value and the rest of the current node
+        JsonReader& reader() { return m_reader.reader(); }
+        void reset() { m_reader.reset(); }
+    };
+    // a coroutine that yields a sequence of T, for use with range based for
+    template<typename T> class JsonGenerator {
+    public:
+        struct promise_type {
+            T value;
+            promise_type() : value() {
+            }
+            JsonGenerator get_return_object() {
+                return JsonGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            std::suspend_always yield_value(T result) {
+                value = result;
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+        class iterator {
+            std::coroutine_handle<promise_type> m_handle;
+        public:
+            explicit iterator(std::coroutine_handle<promise_type> handle) : m_handle(handle) {
+            }
+            iterator& operator++() {
+                m_handle.resume();
+                if(m_handle.done())
+                    m_handle = nullptr;
+                return *this;
+            }
+            T operator*() const { return m_handle.promise().value; }
+            bool operator==(const iterator& rhs) const { return m_handle==rhs.m_handle; }
+            bool operator!=(const iterator& rhs) const { return m_handle!=rhs.m_handle; }
+        };
+    private:
+        std::coroutine_handle<promise_type> m_handle;
+        JsonGenerator(const JsonGenerator& rhs)=delete;
+        JsonGenerator& operator=(const JsonGenerator& rhs)=delete;
+        explicit JsonGenerator(std::coroutine_handle<promise_type> handle) : m_handle(handle) {
+        }
+    public:
+        JsonGenerator(JsonGenerator&& rhs) : m_handle(rhs.m_handle) {
+            rhs.m_handle = nullptr;
+        }
+        ~JsonGenerator() {
+            if(m_handle)
+                m_handle.destroy();
+        }
+        iterator begin() {
+            if(!m_handle)
+                return end();
+            m_handle.resume();
+            return m_handle.done()?end():iterator(m_handle);
+        }
+        iterator end() { return iterator(nullptr); }
+    };
+    // generators over blocking sources
+    class JsonCoroutines {
+    public:
+        // yields the reader on each node it reads, to the end of the document or the first error
+        static JsonGenerator<JsonReader*> nodes(JsonReader& reader) {
+            while(reader.read())
+                co_yield &reader;
+        }
+        // yields the reader on the first node of each record of a stream of top level values.
+        // read or query the record with the reader before moving on
+        static JsonGenerator<JsonReader*> records(JsonReader& reader) {
+            while(reader.nextRecord())
+                co_yield &reader;
+        }
+    };
+}
+#endif
+#endif
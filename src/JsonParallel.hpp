@@ -0,0 +1,217 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONPARALLEL_HPP
+#define HTCW_JSONPARALLEL_HPP
+// there are no threads to run this on without an OS
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include "MappedFile.hpp"
+#include "LexSource.hpp"
+#include "JsonReader.hpp"
+// the nominal size of the chunks records are handed out in. each chunk runs to the first
+// newline after its nominal end
+#ifndef JSON_PARALLEL_CHUNK_SIZE
+#define JSON_PARALLEL_CHUNK_SIZE (1024*1024)
+#endif
+// the most workers a run can have
+#ifndef JSON_PARALLEL_MAX_WORKERS
+#define JSON_PARALLEL_MAX_WORKERS 64
+#endif
+
+namespace json {
+    // processes the records one worker thread is given. each thread has its own, so it
+    // doesn't need to lock anything. chunks are numbered in input order, so results kept per
+    // chunk can be merged in input order once the run is done, and results reduced per
+    // worker can be combined
+    class JsonRecordWorker {
+    public:
+        // called before the first record of a chunk. return false to stop the run
+        virtual bool beginChunk(size_t chunk) {
+            (void)chunk;
+            return true;
+        }
+        // called with the reader on the first node of each record. the reader is in record
+        // mode, so it ends at the end of the record. return false to stop the run
+        virtual bool record(JsonReader& reader,size_t chunk)=0;
+        // called after the last record of a chunk. return false to stop the run
+        virtual bool endChunk(size_t chunk) {
+            (void)chunk;
+            return true;
+        }
+        virtual ~JsonRecordWorker() {}
+    };
+    // runs workers over the records of line delimited JSON in memory, such as a mapped file,
+    // one thread each. the input is split into chunks at newlines and dealt out evenly, and
+    // workers that run out take chunks from the back of the others
+    template<size_t TCapacity> class JsonParallelRecords {
+        mem::MappedFile m_file;
+        const char* m_data;
+        size_t m_size;
+        size_t m_chunkSize;
+        size_t m_workerCount;
+        JsonRecordWorker** m_pworkers;
+        // each worker's remaining chunks, with the next in the low half and one past the last
+        // in the high half, so both ends change together
+        std::atomic<uint64_t> m_queues[JSON_PARALLEL_MAX_WORKERS];
+        std::atomic<bool> m_stop;
+        std::atomic<unsigned long long> m_records;
+        std::atomic<unsigned long long> m_skippedRecords;
+        JsonParallelRecords(const JsonParallelRecords& rhs)=delete;
+        JsonParallelRecords& operator=(const JsonParallelRecords& rhs)=delete;
+        // chunks start after the first newline at or after their nominal start, so each
+        // record belongs to the chunk it starts in
+        const char* chunkStart(size_t chunk) const {
+            if(0==chunk)
+                return m_data;
+            size_t offset = chunk*m_chunkSize;
+            if(offset>=m_size)
+                return m_data+m_size;
+            const char* sz = (const char*)memchr(m_data+offset-1,'\n',m_size-offset+1);
+            return (nullptr==sz)?m_data+m_size:sz+1;
+        }
+        bool take(size_t worker,size_t& chunk) {
+            // our own chunks come off the front
+            std::atomic<uint64_t>& own = m_queues[worker];
+            uint64_t range = own.load();
+            while((uint32_t)range<(uint32_t)(range>>32)) {
+                if(own.compare_exchange_weak(range,range+1)) {
+                    chunk = (uint32_t)range;
+                    return true;
+                }
+            }
+            // everyone else's come off the back, away from where their owners are working
+            for(size_t i = 1;i<m_workerCount;++i) {
+                std::atomic<uint64_t>& other = m_queues[(worker+i)%m_workerCount];
+                range = other.load();
+                while((uint32_t)range<(uint32_t)(range>>32)) {
+                    uint64_t last = (range>>32)-1;
+                    if(other.compare_exchange_weak(range,(last<<32)|(uint32_t)range)) {
+                        chunk = (size_t)last;
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+        void work(size_t worker) {
+            lex::StaticSpanLexSource<TCapacity> source;
+            JsonReader reader(source);
+            JsonRecordWorker& rw = *m_pworkers[worker];
+            unsigned long long records = 0;
+            unsigned long long skipped = 0;
+            size_t chunk;
+            while(!m_stop.load(std::memory_order_relaxed) && take(worker,chunk)) {
+                const char* start = chunkStart(chunk);
+                const char* end = chunkStart(chunk+1);
+                if(!rw.beginChunk(chunk)) {
+                    m_stop = true;
+                    break;
+                }
+                source.detach();
+                source.attach(start,end-start);
+                reader.reset();
+                // records are lines, so the rest of one can be abandoned at its newline
+                reader.recordLines(true);
+                while(reader.nextRecord()) {
+                    ++records;
+                    if(!rw.record(reader,chunk)) {
+                        m_stop = true;
+                        break;
+                    }
+                }
+                skipped+=reader.skippedRecords();
+                if(!m_stop && !rw.endChunk(chunk))
+                    m_stop = true;
+            }
+            source.detach();
+            m_records+=records;
+            m_skippedRecords+=skipped;
+        }
+    public:
+        JsonParallelRecords(size_t chunkSize=JSON_PARALLEL_CHUNK_SIZE) :
+                m_data(nullptr),
+                m_size(0),
+                m_chunkSize(0==chunkSize?1:chunkSize),
+                m_workerCount(0),
+                m_pworkers(nullptr),
+                m_stop(false),
+                m_records(0),
+                m_skippedRecords(0) {
+        }
+        ~JsonParallelRecords() {
+            close();
+        }
+        // maps the file to run over
+        bool open(const char* filename) {
+            if(nullptr!=m_data || !m_file.open(filename))
+                return false;
+            m_data = m_file.data();
+            m_size = m_file.size();
+            return true;
+        }
+        // runs over input that's already in memory. it must stay valid while the instance uses it
+        bool attach(const char* data,size_t size) {
+            if(nullptr!=m_data || nullptr==data)
+                return false;
+            m_data = data;
+            m_size = size;
+            return true;
+        }
+        void close() {
+            if(m_file.open())
+                m_file.close();
+            m_data = nullptr;
+            m_size = 0;
+        }
+        // indicates the number of chunks the input splits into, for keeping results per chunk
+        size_t chunks() const {
+            return (m_size+m_chunkSize-1)/m_chunkSize;
+        }
+        // indicates how many workers the machine can run at once
+        static size_t hardwareWorkers() {
+            unsigned int result = std::thread::hardware_concurrency();
+            return (0==result)?1:result;
+        }
+        // runs each worker on its own thread, with the first on the calling thread, until all
+        // the records are processed. returns false if a worker stopped the run
+        bool run(JsonRecordWorker** workers,size_t workerCount) {
+            if(nullptr==m_data || nullptr==workers || 0==workerCount)
+                return false;
+            if(workerCount>JSON_PARALLEL_MAX_WORKERS)
+                workerCount = JSON_PARALLEL_MAX_WORKERS;
+            size_t count = chunks();
+            if(count>0xFFFFFFFFUL)
+                return false;
+            m_workerCount = workerCount;
+            m_pworkers = workers;
+            m_stop = false;
+            m_records = 0;
+            m_skippedRecords = 0;
+            // deal the chunks out evenly to begin with
+            for(size_t i = 0;i<workerCount;++i) {
+                uint64_t first = count*i/workerCount;
+                uint64_t last = count*(i+1)/workerCount;
+                m_queues[i] = (last<<32)|first;
+            }
+            std::thread threads[JSON_PARALLEL_MAX_WORKERS-1];
+            for(size_t i = 1;i<workerCount;++i)
+                threads[i-1] = std::thread(&JsonParallelRecords::work,this,i);
+            work(0);
+            for(size_t i = 1;i<workerCount;++i)
+                threads[i-1].join();
+            m_pworkers = nullptr;
+            return !m_stop;
+        }
+        // indicates the number of records the last run handed to workers
+        unsigned long long records() const { return m_records; }
+        // indicates the number of records the last run abandoned because of errors
+        unsigned long long skippedRecords() const { return m_skippedRecords; }
+    };
+}
+#endif
+#endif
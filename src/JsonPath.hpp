@@ -0,0 +1,1407 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONPATH_HPP
+#define HTCW_JSONPATH_HPP
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#include <string.h>
+#include <stdlib.h>
+#endif
+#include "MemoryPool.hpp"
+#include "LexSink.hpp"
+#include "JsonReader.hpp"
+#include "JsonWriter.hpp"
+// the number of segments a path can have. the evaluator tracks one bit per segment
+#define JSON_PATH_MAX_SEGMENTS 31
+// the number of operators and comparisons a filter can have
+#define JSON_PATH_MAX_PREDICATES 16
+
+namespace json {
+    // receives the values a query matches
+    class JsonQuerySink {
+    public:
+        // called with the reader on the first node of a matching value. it must move the
+        // reader to the node after the value, as skipSubtree(), parseSubtree(), extract()
+        // and JsonWriter::copySubtree() do
+        virtual bool match(JsonReader& reader)=0;
+        // called instead with the parsed value when a JsonQuerySet delivers one match to
+        // several queries
+        virtual bool match(const JsonElement& value)=0;
+        virtual ~JsonQuerySink() {}
+    };
+    // parses each match into the pool and hands it to element(), then gives the memory back
+    class JsonQueryElementSink : public JsonQuerySink {
+        MemoryPool& m_pool;
+    public:
+        JsonQueryElementSink(MemoryPool& pool) : m_pool(pool) {
+        }
+        virtual bool element(const JsonElement& value)=0;
+        bool match(JsonReader& reader) override {
+            size_t used = m_pool.used();
+            JsonElement e;
+            bool result = reader.parseSubtree(m_pool,&e) && element(e);
+            m_pool.unalloc(m_pool.used()-used);
+            return result;
+        }
+        bool match(const JsonElement& value) override {
+            return element(value);
+        }
+    };
+    // a node of a filter expression. comparisons read a field of the value being
+    // filtered, or the value itself, against a literal
+    struct JsonPathPredicate {
+        static const int8_t And = 0;
+        static const int8_t Or = 1;
+        static const int8_t Not = 2;
+        // true if the field is present
+        static const int8_t Exists = 3;
+        static const int8_t Equal = 4;
+        static const int8_t NotEqual = 5;
+        static const int8_t Less = 6;
+        static const int8_t LessOrEqual = 7;
+        static const int8_t Greater = 8;
+        static const int8_t GreaterOrEqual = 9;
+        int8_t op;
+        // the field under @, or null for @ itself
+        const char* field;
+        // the literal's type, as in JsonElement. all numbers are Real
+        int8_t type;
+        double number;
+        const char* string;
+        bool boolean;
+        // the operands of And, Or and Not
+        uint8_t left;
+        uint8_t right;
+    };
+    // one way to select children in a path segment
+    struct JsonPathSelector {
+        // a field by name
+        static const int8_t Name = 0;
+        // any field or element
+        static const int8_t Wildcard = 1;
+        // an element by index
+        static const int8_t Index = 2;
+        // a range of elements, [start:end:step]
+        static const int8_t Slice = 3;
+        // the fields or elements a filter expression holds for, [?(...)]
+        static const int8_t Filter = 4;
+        int8_t kind;
+        const char* name;
+        unsigned long start;
+        unsigned long end;
+        unsigned long step;
+        // the nodes of a filter, with the root last
+        const JsonPathPredicate* ppredicates;
+        size_t predicateCount;
+        bool match(const char* field,unsigned long index) const {
+            switch(kind) {
+                case Name:
+                    return nullptr!=field && 0==strcmp(name,field);
+                case Wildcard:
+                    return true;
+                case Index:
+                    return nullptr==field && index==start;
+                case Slice:
+                    return nullptr==field && index>=start && index<end && 0==(index-start)%step;
+            }
+            // filters depend on the content
+            return false;
+        }
+    };
+    // a step of a path. its selectors are alternatives, as in a union
+    struct JsonPathSegment {
+        // matches at any depth below, as with ".."
+        bool descendant;
+        const JsonPathSelector* pselectors;
+        size_t count;
+    };
+    // a compiled query in a subset of JSONPath: $, .name, ['name'], .*, [*], [index],
+    // [start:end:step], unions of those such as ['a','b'] or [0,2], and ".." before any
+    // of them. indices can't be negative since an array's length isn't known while streaming.
+    // the segments compile to a set of states, one bit each, which is advanced on every
+    // field or element. subtrees no state can match in are skipped without being read,
+    // and a lone "..name" state scans straight for the field.
+    // one segment can be a filter, such as [?(@.season_number > 5 && @.vote_count >= 10)],
+    // using &&, ||, !, parentheses, ==, !=, <, <=, >, >= and bare @.name for presence.
+    // comparisons are between @ or one of its fields and a number, string, true, false or null
+    class JsonPath {
+        friend class JsonQuerySet;
+        const JsonPathSegment* m_psegments;
+        size_t m_count;
+        // the segments that hold a filter, one bit each
+        uint32_t m_filters;
+        // replays buffered text with a capture buffer from the pool
+        class ReplaySource : public virtual lex::SpanLexSource {
+            char* m_pcapture;
+            size_t m_capacity;
+            size_t m_size;
+        protected:
+            bool appendCapture(char ch) override {
+                m_pcapture[m_size++]=ch;
+                m_pcapture[m_size]=0;
+                return true;
+            }
+        public:
+            ReplaySource(char* pcapture,size_t capacity) : m_pcapture(pcapture),m_capacity(capacity),m_size(0) {
+                *m_pcapture=0;
+            }
+            void reset() override {
+                LexSource::reset();
+                m_size=0;
+                *m_pcapture=0;
+            }
+            char* captureBuffer() override {return m_pcapture;}
+            size_t captureCapacity() const override {return m_capacity-1;}
+            size_t captureSize() const override {return m_size;}
+            void clearCapture() override {
+                m_size=0;
+                *m_pcapture=0;
+                // clear out of memory errors
+                if(OutOfMemoryError==error())
+                    clearError();
+            }
+        };
+        JsonPath(const JsonPath& rhs)=delete;
+        JsonPath& operator=(const JsonPath& rhs)=delete;
+        // the compile state. the output pointers are null on the counting pass
+        struct Compiler {
+            const char* sz;
+            JsonPathSegment* psegments;
+            JsonPathSelector* pselectors;
+            JsonPathPredicate* ppredicates;
+            char* pnames;
+            size_t segments;
+            size_t selectors;
+            size_t predicates;
+            size_t chars;
+            // where the current filter's nodes start
+            size_t filter;
+            uint32_t filters;
+        };
+        static void skipSpace(Compiler& c) {
+            while(' '==*c.sz)
+                ++c.sz;
+        }
+        static JsonPathSelector* addSelector(Compiler& c,int8_t kind) {
+            JsonPathSelector* result = nullptr;
+            if(nullptr!=c.pselectors) {
+                result = c.pselectors+c.selectors;
+                result->kind = kind;
+                result->name = nullptr;
+                result->start = 0;
+                result->end = (unsigned long)-1;
+                result->step = 1;
+                result->ppredicates = nullptr;
+                result->predicateCount = 0;
+                ++c.psegments[c.segments-1].count;
+            }
+            ++c.selectors;
+            return result;
+        }
+        static void addChar(Compiler& c,char ch) {
+            if(nullptr!=c.pnames)
+                c.pnames[c.chars]=ch;
+            ++c.chars;
+        }
+        static bool compileName(Compiler& c,char quote) {
+            JsonPathSelector* ps = addSelector(c,JsonPathSelector::Name);
+            if(nullptr!=ps)
+                ps->name = c.pnames+c.chars;
+            const char* start = c.sz;
+            while(0!=*c.sz) {
+                char ch = *c.sz;
+                if(0==quote) {
+                    if('.'==ch || '['==ch)
+                        break;
+                } else if(quote==ch) {
+                    ++c.sz;
+                    addChar(c,0);
+                    return true;
+                } else if('\\'==ch && 0!=c.sz[1])
+                    ch = *++c.sz;
+                addChar(c,ch);
+                ++c.sz;
+            }
+            addChar(c,0);
+            // quoted names must be closed, plain names can't be empty
+            return 0==quote && c.sz>start;
+        }
+        static bool compileNumber(Compiler& c,unsigned long& value) {
+            if('0'>*c.sz || '9'<*c.sz)
+                return false;
+            value = 0;
+            while('0'<=*c.sz && '9'>=*c.sz)
+                value = value*10+(*c.sz++-'0');
+            return true;
+        }
+        static bool compileIndex(Compiler& c) {
+            unsigned long start = 0;
+            unsigned long end = (unsigned long)-1;
+            unsigned long step = 1;
+            bool hasStart = compileNumber(c,start);
+            skipSpace(c);
+            if(':'!=*c.sz) {
+                if(!hasStart)
+                    return false;
+                JsonPathSelector* ps = addSelector(c,JsonPathSelector::Index);
+                if(nullptr!=ps)
+                    ps->start = start;
+                return true;
+            }
+            ++c.sz;
+            skipSpace(c);
+            compileNumber(c,end);
+            skipSpace(c);
+            if(':'==*c.sz) {
+                ++c.sz;
+                skipSpace(c);
+                if(compileNumber(c,step) && 0==step)
+                    return false;
+            }
+            JsonPathSelector* ps = addSelector(c,JsonPathSelector::Slice);
+            if(nullptr!=ps) {
+                ps->start = start;
+                ps->end = end;
+                ps->step = step;
+            }
+            return true;
+        }
+        // adds a filter node and returns its index within the filter, or -1 if there are too many
+        static int addPredicate(Compiler& c,int8_t op,JsonPathPredicate** ppp) {
+            size_t index = c.predicates-c.filter;
+            if(JSON_PATH_MAX_PREDICATES<=index)
+                return -1;
+            *ppp = nullptr;
+            if(nullptr!=c.ppredicates) {
+                *ppp = c.ppredicates+c.predicates;
+                memset(*ppp,0,sizeof(JsonPathPredicate));
+                (*ppp)->op = op;
+            }
+            ++c.predicates;
+            return (int)index;
+        }
+        static bool compileToken(Compiler& c,const char* token) {
+            size_t len = strlen(token);
+            if(0!=strncmp(c.sz,token,len))
+                return false;
+            c.sz+=len;
+            return true;
+        }
+        // compiles @, @.name or @['name'], leaving field null for @ itself
+        static bool compileOperandPath(Compiler& c,const char** pfield) {
+            ++c.sz;
+            *pfield = nullptr;
+            const char* start = c.pnames+c.chars;
+            char quote = 0;
+            if('.'==*c.sz) {
+                ++c.sz;
+            } else if('['==*c.sz) {
+                ++c.sz;
+                skipSpace(c);
+                quote = *c.sz++;
+                if('\''!=quote && '\"'!=quote)
+                    return false;
+            } else
+                return true;
+            const char* name = c.sz;
+            while(0!=*c.sz && (0!=quote?quote!=*c.sz:nullptr==strchr(" .[]()=!<>&|",*c.sz))) {
+                char ch = *c.sz;
+                if(0!=quote && '\\'==ch && 0!=c.sz[1])
+                    ch = *++c.sz;
+                addChar(c,ch);
+                ++c.sz;
+            }
+            addChar(c,0);
+            if(0!=quote) {
+                if(quote!=*c.sz)
+                    return false;
+                ++c.sz;
+                skipSpace(c);
+                if(']'!=*c.sz)
+                    return false;
+                ++c.sz;
+            } else if(c.sz==name)
+                return false;
+            // only direct fields of the value can be tested
+            if('.'==*c.sz || '['==*c.sz)
+                return false;
+            *pfield = start;
+            return true;
+        }
+        static bool compileLiteral(Compiler& c,JsonPathPredicate* pp) {
+            JsonPathPredicate dummy;
+            if(nullptr==pp)
+                pp = &dummy;
+            if('\''==*c.sz || '\"'==*c.sz) {
+                char quote = *c.sz++;
+                pp->type = JsonElement::String;
+                pp->string = c.pnames+c.chars;
+                while(quote!=*c.sz) {
+                    char ch = *c.sz;
+                    if(0==ch)
+                        return false;
+                    if('\\'==ch && 0!=c.sz[1])
+                        ch = *++c.sz;
+                    addChar(c,ch);
+                    ++c.sz;
+                }
+                ++c.sz;
+                addChar(c,0);
+                return true;
+            }
+            if(compileToken(c,"true") || compileToken(c,"false")) {
+                pp->type = JsonElement::Boolean;
+                pp->boolean = 'e'==c.sz[-1] && 'u'==c.sz[-2];
+                return true;
+            }
+            if(compileToken(c,"null")) {
+                pp->type = JsonElement::Null;
+                return true;
+            }
+            if('-'!=*c.sz && ('0'>*c.sz || '9'<*c.sz))
+                return false;
+            char* pend;
+            pp->type = JsonElement::Real;
+            pp->number = strtod(c.sz,&pend);
+            c.sz = pend;
+            return true;
+        }
+        static int8_t compileOperator(Compiler& c) {
+            if(compileToken(c,"=="))
+                return JsonPathPredicate::Equal;
+            if(compileToken(c,"!="))
+                return JsonPathPredicate::NotEqual;
+            if(compileToken(c,"<="))
+                return JsonPathPredicate::LessOrEqual;
+            if(compileToken(c,">="))
+                return JsonPathPredicate::GreaterOrEqual;
+            if(compileToken(c,"<"))
+                return JsonPathPredicate::Less;
+            if(compileToken(c,">"))
+                return JsonPathPredicate::Greater;
+            return JsonPathPredicate::Exists;
+        }
+        // compiles a comparison between @ or a field and a literal, in either order
+        static int compileComparison(Compiler& c) {
+            JsonPathPredicate* pp;
+            int result = addPredicate(c,JsonPathPredicate::Exists,&pp);
+            if(0>result)
+                return -1;
+            const char* field = nullptr;
+            bool reversed = '@'!=*c.sz;
+            if(reversed) {
+                if(!compileLiteral(c,pp))
+                    return -1;
+            } else if(!compileOperandPath(c,&field))
+                return -1;
+            skipSpace(c);
+            int8_t op = compileOperator(c);
+            if(JsonPathPredicate::Exists!=op) {
+                skipSpace(c);
+                if(reversed) {
+                    if('@'!=*c.sz || !compileOperandPath(c,&field))
+                        return -1;
+                    // keep the field on the left
+                    switch(op) {
+                        case JsonPathPredicate::Less:
+                            op = JsonPathPredicate::Greater;
+                            break;
+                        case JsonPathPredicate::LessOrEqual:
+                            op = JsonPathPredicate::GreaterOrEqual;
+                            break;
+                        case JsonPathPredicate::Greater:
+                            op = JsonPathPredicate::Less;
+                            break;
+                        case JsonPathPredicate::GreaterOrEqual:
+                            op = JsonPathPredicate::LessOrEqual;
+                            break;
+                    }
+                } else if(!compileLiteral(c,pp))
+                    return -1;
+            } else if(reversed)
+                return -1;
+            if(nullptr!=pp) {
+                pp->op = op;
+                pp->field = field;
+            }
+            return result;
+        }
+        static int compileUnary(Compiler& c) {
+            skipSpace(c);
+            JsonPathPredicate* pp;
+            int result;
+            if('!'==*c.sz && '='!=c.sz[1]) {
+                ++c.sz;
+                int operand = compileUnary(c);
+                if(0>operand || 0>(result = addPredicate(c,JsonPathPredicate::Not,&pp)))
+                    return -1;
+                if(nullptr!=pp)
+                    pp->left = (uint8_t)operand;
+                return result;
+            }
+            if('('==*c.sz) {
+                ++c.sz;
+                result = compileBinary(c,true);
+                skipSpace(c);
+                if(0>result || ')'!=*c.sz)
+                    return -1;
+                ++c.sz;
+                return result;
+            }
+            return compileComparison(c);
+        }
+        static int compileBinary(Compiler& c,bool isOr) {
+            int left = isOr?compileBinary(c,false):compileUnary(c);
+            while(0<=left) {
+                skipSpace(c);
+                if(!compileToken(c,isOr?"||":"&&"))
+                    break;
+                int right = isOr?compileBinary(c,false):compileUnary(c);
+                JsonPathPredicate* pp;
+                int result;
+                if(0>right || 0>(result = addPredicate(c,isOr?JsonPathPredicate::Or:JsonPathPredicate::And,&pp)))
+                    return -1;
+                if(nullptr!=pp) {
+                    pp->left = (uint8_t)left;
+                    pp->right = (uint8_t)right;
+                }
+                left = result;
+            }
+            return left;
+        }
+        // compiles [?(...)] given the selector count where its bracket started
+        static bool compileFilter(Compiler& c,size_t first) {
+            // one filter per path, and it must be alone in its brackets
+            if(0!=c.filters || first!=c.selectors)
+                return false;
+            ++c.sz;
+            skipSpace(c);
+            if('('!=*c.sz)
+                return false;
+            ++c.sz;
+            c.filters|=(1UL<<(c.segments-1));
+            c.filter = c.predicates;
+            JsonPathSelector* ps = addSelector(c,JsonPathSelector::Filter);
+            if(0>compileBinary(c,true))
+                return false;
+            skipSpace(c);
+            if(')'!=*c.sz)
+                return false;
+            ++c.sz;
+            skipSpace(c);
+            if(']'!=*c.sz)
+                return false;
+            if(nullptr!=ps) {
+                ps->ppredicates = c.ppredicates+c.filter;
+                ps->predicateCount = c.predicates-c.filter;
+            }
+            return true;
+        }
+        static bool compileBracket(Compiler& c) {
+            ++c.sz;
+            size_t first = c.selectors;
+            while(true) {
+                skipSpace(c);
+                switch(*c.sz) {
+                    case '?':
+                        if(!compileFilter(c,first))
+                            return false;
+                        break;
+                    case '*':
+                        ++c.sz;
+                        addSelector(c,JsonPathSelector::Wildcard);
+                        break;
+                    case '\'':
+                    case '\"': {
+                        char quote = *c.sz++;
+                        if(!compileName(c,quote))
+                            return false;
+                        break;
+                    }
+                    default:
+                        if(!compileIndex(c))
+                            return false;
+                        break;
+                }
+                skipSpace(c);
+                if(']'==*c.sz) {
+                    ++c.sz;
+                    return true;
+                }
+                if(','!=*c.sz)
+                    return false;
+                ++c.sz;
+            }
+        }
+        static bool compileSegments(Compiler& c) {
+            if('$'==*c.sz)
+                ++c.sz;
+            while(0!=*c.sz) {
+                if(JSON_PATH_MAX_SEGMENTS==c.segments)
+                    return false;
+                bool descendant = false;
+                bool dot = '.'==*c.sz;
+                if(dot) {
+                    ++c.sz;
+                    if('.'==*c.sz) {
+                        descendant = true;
+                        ++c.sz;
+                    }
+                } else if('['!=*c.sz)
+                    return false;
+                if(nullptr!=c.psegments) {
+                    JsonPathSegment& s = c.psegments[c.segments];
+                    s.descendant = descendant;
+                    s.pselectors = c.pselectors+c.selectors;
+                    s.count = 0;
+                }
+                ++c.segments;
+                if('['==*c.sz) {
+                    // a bracket can follow ".." but not "."
+                    if(dot && !descendant)
+                        return false;
+                    if(!compileBracket(c))
+                        return false;
+                } else if('*'==*c.sz) {
+                    ++c.sz;
+                    addSelector(c,JsonPathSelector::Wildcard);
+                } else if(!compileName(c,0))
+                    return false;
+            }
+            return true;
+        }
+        // the filter selector of a segment, given its bit
+        const JsonPathSelector& filterOf(uint32_t state) const {
+            size_t segment = 0;
+            while(0==(state&(1UL<<segment)))
+                ++segment;
+            return m_psegments[segment].pselectors[0];
+        }
+        // the outcome of a comparison given how the value orders against the literal,
+        // with 2 meaning they can't be compared
+        static int8_t outcome(int8_t op,int cmp) {
+            switch(op) {
+                case JsonPathPredicate::Exists:
+                    return 1;
+                case JsonPathPredicate::Equal:
+                    return 0==cmp;
+                case JsonPathPredicate::NotEqual:
+                    return 0!=cmp;
+                case JsonPathPredicate::Less:
+                    return -1==cmp;
+                case JsonPathPredicate::LessOrEqual:
+                    return -1==cmp || 0==cmp;
+                case JsonPathPredicate::Greater:
+                    return 1==cmp;
+                case JsonPathPredicate::GreaterOrEqual:
+                    return 1==cmp || 0==cmp;
+            }
+            return 0;
+        }
+        // evaluates a filter node with three valued logic, 1 true, 0 false and -1 not known yet
+        static int8_t test(const JsonPathPredicate* ppredicates,size_t index,const int8_t* presults) {
+            const JsonPathPredicate& p = ppredicates[index];
+            int8_t l,r;
+            switch(p.op) {
+                case JsonPathPredicate::And:
+                    l = test(ppredicates,p.left,presults);
+                    r = test(ppredicates,p.right,presults);
+                    if(0==l || 0==r)
+                        return 0;
+                    return (1==l && 1==r)?1:-1;
+                case JsonPathPredicate::Or:
+                    l = test(ppredicates,p.left,presults);
+                    r = test(ppredicates,p.right,presults);
+                    if(1==l || 1==r)
+                        return 1;
+                    return (0==l && 0==r)?0:-1;
+                case JsonPathPredicate::Not:
+                    l = test(ppredicates,p.left,presults);
+                    return (0>l)?-1:!l;
+            }
+            return presults[index];
+        }
+        static bool applies(const JsonPathPredicate& p,const char* field) {
+            if(JsonPathPredicate::Exists>p.op)
+                return false;
+            if(nullptr==field)
+                return nullptr==p.field;
+            return nullptr!=p.field && 0==strcmp(p.field,field);
+        }
+        // settles the comparisons on a field, or on @ when field is null, against the value
+        // under the cursor, and moves past the value
+        static bool testValue(JsonReader& reader,const JsonPathSelector& filter,const char* field,int8_t* presults) {
+            const JsonPathPredicate* pp = filter.ppredicates;
+            size_t count = filter.predicateCount;
+            switch(reader.nodeType()) {
+                case JsonReader::Object:
+                case JsonReader::Array:
+                    for(size_t i = 0;i<count;++i) {
+                        if(applies(pp[i],field))
+                            presults[i] = outcome(pp[i].op,2);
+                    }
+                    return skip(reader);
+            }
+            int8_t valueType = reader.valueType();
+            // how the string compares to each string literal so far, and how far it got
+            int8_t cmp[JSON_PATH_MAX_PREDICATES];
+            size_t offsets[JSON_PATH_MAX_PREDICATES];
+            memset(cmp,0,sizeof(cmp));
+            memset(offsets,0,sizeof(offsets));
+            bool parts = false;
+            while(true) {
+                // the node after a string's parts has nothing left in it
+                if(JsonReader::String==valueType && (!parts || JsonReader::ValuePart==reader.nodeType())) {
+                    const char* sz = reader.value();
+                    for(size_t i = 0;i<count;++i) {
+                        if(0!=cmp[i] || JsonElement::String!=pp[i].type || !applies(pp[i],field))
+                            continue;
+                        const char* lit = pp[i].string+offsets[i];
+                        size_t j = 0;
+                        while(0!=sz[j]) {
+                            if(0==lit[j]) {
+                                cmp[i] = 1;
+                                break;
+                            }
+                            if(sz[j]!=lit[j]) {
+                                cmp[i] = ((unsigned char)sz[j]<(unsigned char)lit[j])?-1:1;
+                                break;
+                            }
+                            ++j;
+                        }
+                        offsets[i]+=j;
+                    }
+                }
+                if(JsonReader::ValuePart!=reader.nodeType())
+                    break;
+                parts = true;
+                // a string at the top level ends with its last part
+                if(!reader.read()) {
+                    if(reader.hasError())
+                        return false;
+                    break;
+                }
+            }
+            for(size_t i = 0;i<count;++i) {
+                const JsonPathPredicate& p = pp[i];
+                if(!applies(p,field))
+                    continue;
+                int c = 2;
+                switch(p.type) {
+                    case JsonElement::String:
+                        if(JsonReader::String==valueType)
+                            c = (0==cmp[i] && 0!=p.string[offsets[i]])?-1:cmp[i];
+                        break;
+                    case JsonElement::Real:
+                        if(JsonReader::Integer==valueType || JsonReader::Real==valueType) {
+                            double d = (JsonReader::Integer==valueType)?(double)reader.integerValue():reader.realValue();
+                            c = (d<p.number)?-1:(d>p.number)?1:(d==p.number)?0:2;
+                        }
+                        break;
+                    case JsonElement::Boolean:
+                        if(JsonReader::Boolean==valueType)
+                            c = (reader.booleanValue()==p.boolean)?0:2;
+                        break;
+                    case JsonElement::Null:
+                        if(JsonReader::Null==valueType)
+                            c = 0;
+                        break;
+                }
+                presults[i] = outcome(p.op,c);
+            }
+            return reader.read() || !reader.hasError();
+        }
+        // evaluates a filter against the value a fresh reader starts on, reading only the
+        // fields the filter needs and stopping as soon as the outcome is known
+        static bool testElement(JsonReader& reader,const JsonPathSelector& filter,bool& result) {
+            const JsonPathPredicate* pp = filter.ppredicates;
+            size_t count = filter.predicateCount;
+            int8_t results[JSON_PATH_MAX_PREDICATES];
+            const char* names[JSON_PATH_MAX_PREDICATES];
+            size_t nameCount = 0;
+            for(size_t i = 0;i<count;++i) {
+                results[i] = -1;
+                if(JsonPathPredicate::Exists>pp[i].op || nullptr==pp[i].field)
+                    continue;
+                size_t j = 0;
+                while(j<nameCount && 0!=strcmp(names[j],pp[i].field))
+                    ++j;
+                if(j==nameCount)
+                    names[nameCount++] = pp[i].field;
+            }
+            if(!reader.read())
+                return false;
+            if(JsonReader::Object==reader.nodeType()) {
+                for(size_t i = 0;i<count;++i) {
+                    if(applies(pp[i],nullptr))
+                        results[i] = outcome(pp[i].op,2);
+                }
+                while(0<nameCount && 0>test(pp,count-1,results)) {
+                    int i = reader.skipToFieldOf(names,nameCount);
+                    if(0>i) {
+                        if(reader.hasError())
+                            return false;
+                        break;
+                    }
+                    if(!reader.read() || !testValue(reader,filter,names[i],results))
+                        return false;
+                }
+            } else if(!testValue(reader,filter,nullptr,results))
+                return false;
+            // what's left compares against fields that aren't there
+            for(size_t i = 0;i<count;++i) {
+                if(0>results[i])
+                    results[i] = (JsonPathPredicate::Exists==pp[i].op)?0:outcome(pp[i].op,2);
+            }
+            result = 1==test(pp,count-1,results);
+            return true;
+        }
+        // evaluates a filter against a value that's already been parsed
+        static bool testElement(const JsonElement& value,const JsonPathSelector& filter) {
+            const JsonPathPredicate* pp = filter.ppredicates;
+            int8_t results[JSON_PATH_MAX_PREDICATES];
+            for(size_t i = 0;i<filter.predicateCount;++i) {
+                const JsonPathPredicate& p = pp[i];
+                if(JsonPathPredicate::Exists>p.op)
+                    continue;
+                const JsonElement* pe = &value;
+                if(nullptr!=p.field) {
+                    pe = nullptr;
+                    for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe;pfe=pfe->pnext) {
+                        if(0==strcmp(pfe->name,p.field)) {
+                            pe = pfe->pvalue;
+                            break;
+                        }
+                    }
+                    if(nullptr==pe) {
+                        results[i] = (JsonPathPredicate::Exists==p.op)?0:outcome(p.op,2);
+                        continue;
+                    }
+                }
+                int c = 2;
+                switch(p.type) {
+                    case JsonElement::String:
+                        if(JsonElement::String==pe->type()) {
+                            c = strcmp(pe->string(),p.string);
+                            c = (0>c)?-1:(0<c)?1:0;
+                        }
+                        break;
+                    case JsonElement::Real:
+                        if(JsonElement::Integer==pe->type() || JsonElement::Real==pe->type()) {
+                            double d = (JsonElement::Integer==pe->type())?(double)pe->integer():pe->real();
+                            c = (d<p.number)?-1:(d>p.number)?1:(d==p.number)?0:2;
+                        }
+                        break;
+                    case JsonElement::Boolean:
+                        if(JsonElement::Boolean==pe->type())
+                            c = (pe->boolean()==p.boolean)?0:2;
+                        break;
+                    case JsonElement::Null:
+                        if(JsonElement::Null==pe->type())
+                            c = 0;
+                        break;
+                }
+                results[i] = outcome(p.op,c);
+            }
+            return 1==test(pp,filter.predicateCount-1,results);
+        }
+        // the outcome of a comparison on a field that isn't there
+        static int8_t absent(const JsonPathPredicate& p) {
+            return (JsonPathPredicate::Exists==p.op)?0:outcome(p.op,2);
+        }
+        // evaluates text buffered in the pool under the states, replaying it with the capture
+        // buffer, which must hold the reader's capture capacity and a terminator. out of memory
+        // errors are reported on the reader
+        bool replay(MemoryPool& pool,JsonReader& reader,const char* text,size_t size,char* pcapture,JsonQuerySink& sink,uint32_t states) const {
+            if(0==states)
+                return true;
+            ReplaySource source(pcapture,reader.source().captureCapacity()+1);
+            source.attach(text,size);
+            JsonReader r(source);
+            if(r.read() && evaluateValue(&pool,r,sink,states))
+                return true;
+            if(JSON_ERROR_OUT_OF_MEMORY==r.error())
+                reader.outOfMemory();
+            return false;
+        }
+        // settles the comparisons on a field against its value buffered in the pool
+        static bool testText(JsonReader& reader,const char* text,size_t size,char* pcapture,const JsonPathSelector& filter,const char* field,int8_t* presults) {
+            ReplaySource source(pcapture,reader.source().captureCapacity()+1);
+            source.attach(text,size);
+            JsonReader r(source);
+            return r.read() && testValue(r,filter,field,presults);
+        }
+        // evaluates buffered text under the states, first adding the conditional state if
+        // the text passes its filter
+        bool evaluateText(MemoryPool& pool,JsonReader& reader,const char* text,size_t size,JsonQuerySink& sink,uint32_t states,uint32_t conditional) const {
+            char* pcapture = (char*)pool.alloc(reader.source().captureCapacity()+1);
+            if(nullptr==pcapture)
+                return reader.outOfMemory();
+            if(0!=conditional) {
+                ReplaySource source(pcapture,reader.source().captureCapacity()+1);
+                source.attach(text,size);
+                JsonReader r(source);
+                bool pass;
+                if(!testElement(r,filterOf(conditional>>1),pass))
+                    return false;
+                if(pass)
+                    states|=conditional;
+            }
+            return replay(pool,reader,text,size,pcapture,sink,states);
+        }
+        // copies the value under the cursor to the text and moves past it. the reader reports
+        // a sink that fails as an I/O error, so running out of pool is reported here instead
+        static bool copy(JsonReader& reader,JsonTextWriter& writer,const lex::PoolLexSink& text) {
+            if(writer.copySubtree(reader))
+                return true;
+            if(text.full())
+                reader.outOfMemory();
+            return false;
+        }
+        // copies the value under the cursor to the pool and moves past it
+        static bool buffer(MemoryPool& pool,JsonReader& reader,const char** ptext,size_t* psize) {
+            lex::PoolLexSink text(pool);
+            JsonTextWriter writer(text);
+            if(!copy(reader,writer,text))
+                return false;
+            *ptext = text.data();
+            *psize = text.size();
+            return true;
+        }
+        // evaluates a child that's selected if it passes a filter. the filter is decided as
+        // the child is read, from the fields it tests, and children that fail are skipped
+        // without being kept. only what has to wait for the outcome is held in the pool
+        bool evaluateCandidate(MemoryPool* ppool,JsonReader& reader,JsonQuerySink& sink,uint32_t states,uint32_t conditional) const {
+            uint32_t accept = 1UL<<m_count;
+            // it's a match whether or not it passes
+            if(0!=(states&accept))
+                return evaluateValue(ppool,reader,sink,states);
+            const JsonPathSelector& filter = filterOf(conditional>>1);
+            const JsonPathPredicate* pp = filter.ppredicates;
+            size_t count = filter.predicateCount;
+            int8_t results[JSON_PATH_MAX_PREDICATES];
+            const char* names[JSON_PATH_MAX_PREDICATES];
+            size_t nameCount = 0;
+            bool self = false;
+            bool object = JsonReader::Object==reader.nodeType();
+            bool scalar = !object && JsonReader::Array!=reader.nodeType();
+            for(size_t i = 0;i<count;++i) {
+                results[i] = -1;
+                const JsonPathPredicate& p = pp[i];
+                if(JsonPathPredicate::Exists>p.op)
+                    continue;
+                if(nullptr==p.field) {
+                    // a container can't equal or order against a literal
+                    if(scalar)
+                        self = true;
+                    else
+                        results[i] = outcome(p.op,2);
+                } else if(!object) {
+                    results[i] = absent(p);
+                } else {
+                    size_t j = 0;
+                    while(j<nameCount && 0!=strcmp(names[j],p.field))
+                        ++j;
+                    if(j==nameCount)
+                        names[nameCount++] = p.field;
+                }
+            }
+            if(self)
+                return evaluateScalar(ppool,reader,sink,states,conditional,filter,results);
+            int8_t pass = test(pp,count-1,results);
+            if(0<=pass)
+                return evaluateValue(ppool,reader,sink,states|(pass?conditional:0));
+            return evaluateObject(ppool,reader,sink,states,conditional,filter,results,names,nameCount);
+        }
+        // evaluates a scalar candidate whose filter tests the scalar itself
+        bool evaluateScalar(MemoryPool* ppool,JsonReader& reader,JsonQuerySink& sink,uint32_t states,uint32_t conditional,const JsonPathSelector& filter,int8_t* presults) const {
+            const JsonPathPredicate* pp = filter.ppredicates;
+            size_t root = filter.predicateCount-1;
+            // if nothing takes the scalar it's only tested
+            if(0==(conditional&(1UL<<m_count)))
+                return testValue(reader,filter,nullptr,presults);
+            // otherwise it's held until the filter is decided
+            if(nullptr==ppool)
+                return reader.outOfMemory();
+            size_t used = ppool->used();
+            char* pcapture = (char*)ppool->alloc(reader.source().captureCapacity()+1);
+            const char* text;
+            size_t size;
+            bool result = (nullptr!=pcapture || reader.outOfMemory()) &&
+                buffer(*ppool,reader,&text,&size) &&
+                testText(reader,text,size,pcapture,filter,nullptr,presults);
+            if(result && 1==test(pp,root,presults))
+                result = replay(*ppool,reader,text,size,pcapture,sink,states|conditional);
+            ppool->restore(used);
+            return result;
+        }
+        // starts holding back fields of a candidate, with the capture buffer for replaying them under the text
+        static bool hold(MemoryPool* ppool,JsonReader& reader,JsonTextWriter& writer,char** ppcapture) {
+            if(nullptr==ppool)
+                return reader.outOfMemory();
+            *ppcapture = (char*)ppool->alloc(reader.source().captureCapacity()+1);
+            return (nullptr!=*ppcapture && writer.beginObject()) || reader.outOfMemory();
+        }
+        // streams the fields of a candidate object, deciding its filter as the fields it tests
+        // go by. until it's decided, fields whose evaluation depends on the outcome are held
+        // back in the pool as the text of an object, which is replayed once the outcome is
+        // known. if the object itself is what the filter selects, it's held back whole, but
+        // only until it fails
+        bool evaluateObject(MemoryPool* ppool,JsonReader& reader,JsonQuerySink& sink,uint32_t states,uint32_t conditional,const JsonPathSelector& filter,int8_t* presults,const char** names,size_t nameCount) const {
+            const JsonPathPredicate* pp = filter.ppredicates;
+            size_t root = filter.predicateCount-1;
+            bool whole = 0!=(conditional&(1UL<<m_count));
+            size_t used = (nullptr!=ppool)?ppool->used():0;
+            lex::PoolLexSink text(ppool);
+            JsonTextWriter writer(text);
+            char* pcapture = nullptr;
+            bool pending = false;
+            int8_t pass = -1;
+            if(!reader.read())
+                return false;
+            bool result = true;
+            if(whole)
+                result = pending = hold(ppool,reader,writer,&pcapture);
+            while(result && JsonReader::Field==reader.nodeType()) {
+                const char* name = reader.value();
+                int field = -1;
+                for(size_t i = 0;0>field && i<nameCount;++i) {
+                    if(0==strcmp(names[i],name))
+                        field = (int)i;
+                }
+                uint32_t child = next(states,name,0);
+                uint32_t held = next(conditional,name,0);
+                if(0<=pass)
+                    child|=pass?held:0;
+                if(!pending && (0<=pass || (0==held && (0>field || 0==(child&(1UL<<m_count)))))) {
+                    // nothing's held back and this field doesn't wait on the outcome
+                    if(0>field || 0<=pass) {
+                        if(0==child)
+                            result = skip(reader);
+                        else
+                            result = reader.read() && evaluateValue(ppool,reader,sink,child);
+                        continue;
+                    }
+                    if(!reader.read()) {
+                        result = false;
+                        continue;
+                    }
+                    if(JsonReader::Object==reader.nodeType() || JsonReader::Array==reader.nodeType()) {
+                        for(size_t i = 0;i<=root;++i) {
+                            if(applies(pp[i],names[field]))
+                                presults[i] = outcome(pp[i].op,2);
+                        }
+                        result = evaluateValue(ppool,reader,sink,child);
+                    } else
+                        result = testValue(reader,filter,names[field],presults);
+                } else {
+                    if(!pending && !(pending = hold(ppool,reader,writer,&pcapture))) {
+                        result = false;
+                        continue;
+                    }
+                    if(!writer.field(name)) {
+                        result = reader.outOfMemory();
+                        continue;
+                    }
+                    size_t start = text.size();
+                    if(!copy(reader,writer,text)) {
+                        result = false;
+                        continue;
+                    }
+                    if(0<=field && 0>pass)
+                        result = testText(reader,text.data()+start,text.size()-start,pcapture,filter,names[field],presults);
+                }
+                if(result && 0>pass && 0<=(pass = test(pp,root,presults)) && pending && !(whole && pass)) {
+                    // the held back fields are evaluated now that the outcome is known
+                    result = writer.endObject() || reader.outOfMemory();
+                    result = result && replay(*ppool,reader,text.data(),text.size(),pcapture,sink,states|(pass?conditional:0));
+                    ppool->restore(used);
+                    pending = false;
+                }
+            }
+            if(result && JsonReader::EndObject!=reader.nodeType())
+                result = false;
+            if(result && 0>pass) {
+                // what's left compares against fields that aren't there
+                for(size_t i = 0;i<=root;++i) {
+                    if(0>presults[i])
+                        presults[i] = absent(pp[i]);
+                }
+                pass = test(pp,root,presults);
+            }
+            if(result && pending) {
+                result = writer.endObject() || reader.outOfMemory();
+                result = result && replay(*ppool,reader,text.data(),text.size(),pcapture,sink,states|(pass?conditional:0));
+            }
+            if(nullptr!=ppool)
+                ppool->restore(used);
+            return result && (reader.read() || !reader.hasError());
+        }
+        // advances the states over a child, given its field name or its index when field is null
+        uint32_t next(uint32_t states,const char* field,unsigned long index) const {
+            uint32_t result = 0;
+            for(size_t i = 0;i<m_count;++i) {
+                if(0==(states&(1UL<<i)))
+                    continue;
+                const JsonPathSegment& s = m_psegments[i];
+                if(s.descendant)
+                    result|=(1UL<<i);
+                for(size_t j = 0;j<s.count;++j) {
+                    if(s.pselectors[j].match(field,index)) {
+                        result|=(1UL<<(i+1));
+                        break;
+                    }
+                }
+            }
+            return result;
+        }
+        static bool skip(JsonReader& reader) {
+            return reader.skipSubtree() || !reader.hasError();
+        }
+        // indicates whether the only state is a "..name" segment, which can be found by scanning for the field
+        bool scannable(uint32_t states,size_t& segment) const {
+            if(0==states || 0!=(states&(states-1)))
+                return false;
+            segment = 0;
+            while(0==(states&(1UL<<segment)))
+                ++segment;
+            const JsonPathSegment& s = m_psegments[segment];
+            return s.descendant && 1==s.count && JsonPathSelector::Name==s.pselectors[0].kind;
+        }
+        // evaluates the value under the cursor, leaving the reader on the node after it
+        bool evaluateValue(MemoryPool* ppool,JsonReader& reader,JsonQuerySink& sink,uint32_t states) const {
+            if(0!=(states&(1UL<<m_count)))
+                return sink.match(reader);
+            if(0!=states) {
+                size_t segment;
+                switch(reader.nodeType()) {
+                    case JsonReader::Object:
+                        if(scannable(states,segment))
+                            return scan(ppool,reader,sink,segment);
+                        return evaluateFields(ppool,reader,sink,states);
+                    case JsonReader::Array:
+                        if(scannable(states,segment))
+                            return scan(ppool,reader,sink,segment);
+                        return evaluateElements(ppool,reader,sink,states);
+                }
+            }
+            return skip(reader);
+        }
+        // evaluates a child under its states, and its filter if one applies
+        bool evaluateChild(MemoryPool* ppool,JsonReader& reader,JsonQuerySink& sink,uint32_t states,uint32_t conditional) const {
+            if(0!=conditional)
+                return evaluateCandidate(ppool,reader,sink,states,conditional);
+            return evaluateValue(ppool,reader,sink,states);
+        }
+        bool evaluateFields(MemoryPool* ppool,JsonReader& reader,JsonQuerySink& sink,uint32_t states) const {
+            if(!reader.read())
+                return false;
+            uint32_t conditional = (states&m_filters)<<1;
+            while(JsonReader::Field==reader.nodeType()) {
+                uint32_t child = next(states,reader.value(),0);
+                if(0==child && 0==conditional) {
+                    // skipping from the field avoids loading its value
+                    if(!skip(reader))
+                        return false;
+                } else if(!reader.read() || !evaluateChild(ppool,reader,sink,child,conditional))
+                    return false;
+            }
+            if(JsonReader::EndObject!=reader.nodeType())
+                return false;
+            return reader.read() || !reader.hasError();
+        }
+        bool evaluateElements(MemoryPool* ppool,JsonReader& reader,JsonQuerySink& sink,uint32_t states) const {
+            if(!reader.read())
+                return false;
+            uint32_t conditional = (states&m_filters)<<1;
+            unsigned long index = 0;
+            while(JsonReader::EndArray!=reader.nodeType()) {
+                if(JsonReader::EndDocument==reader.nodeType() || reader.hasError())
+                    return false;
+                if(!evaluateChild(ppool,reader,sink,next(states,nullptr,index++),conditional))
+                    return false;
+            }
+            return reader.read() || !reader.hasError();
+        }
+        // finds the fields of a "..name" segment under the container at the cursor by
+        // scanning the raw input for the name instead of reading every node
+        bool scan(MemoryPool* ppool,JsonReader& reader,JsonQuerySink& sink,size_t segment) const {
+            const char* name = m_psegments[segment].pselectors[0].name;
+            uint32_t child = (1UL<<segment)|(1UL<<(segment+1));
+            unsigned long int depth = 1;
+            while(true) {
+                if(!reader.skipToField(name,JsonReader::Descendants,&depth)) {
+                    if(reader.hasError())
+                        return false;
+                    break;
+                }
+                // reading past the match can land on a sibling with the same name
+                do {
+                    if(!reader.read() || !evaluateValue(ppool,reader,sink,child))
+                        return false;
+                } while(JsonReader::Field==reader.nodeType() && 0==strcmp(name,reader.value()));
+                // the reader consumed a closing bracket the scan didn't see
+                if(JsonReader::EndObject==reader.nodeType() && 0==--depth)
+                    break;
+                if(JsonReader::EndDocument==reader.nodeType())
+                    return !reader.hasError();
+            }
+            switch(reader.nodeType()) {
+                case JsonReader::EndObject:
+                case JsonReader::EndArray:
+                    return reader.read() || !reader.hasError();
+            }
+            return !reader.hasError();
+        }
+    public:
+        JsonPath() : m_psegments(nullptr),m_count(0),m_filters(0) {
+        }
+        // compiles a path, allocating its segments from the pool
+        bool compile(MemoryPool& pool,const char* path) {
+            m_psegments = nullptr;
+            m_count = 0;
+            m_filters = 0;
+            if(nullptr==path)
+                return false;
+            Compiler c;
+            memset(&c,0,sizeof(c));
+            c.sz = path;
+            if(!compileSegments(c))
+                return false;
+            size_t segments = c.segments;
+            size_t selectors = c.selectors;
+            size_t predicates = c.predicates;
+            size_t chars = c.chars;
+            // the predicates go first since they hold doubles
+            size_t size = predicates*sizeof(JsonPathPredicate)+segments*sizeof(JsonPathSegment)+selectors*sizeof(JsonPathSelector)+chars;
+            uint8_t* p = (uint8_t*)pool.alloc(size);
+            if(nullptr==p && 0<size)
+                return false;
+            memset(&c,0,sizeof(c));
+            c.sz = path;
+            c.ppredicates = (JsonPathPredicate*)p;
+            p+=predicates*sizeof(JsonPathPredicate);
+            c.psegments = (JsonPathSegment*)p;
+            p+=segments*sizeof(JsonPathSegment);
+            c.pselectors = (JsonPathSelector*)p;
+            c.pnames = (char*)(p+selectors*sizeof(JsonPathSelector));
+            compileSegments(c);
+            m_psegments = c.psegments;
+            m_count = segments;
+            m_filters = c.filters;
+            return true;
+        }
+        // the number of segments in the compiled path
+        size_t size() const { return m_count; }
+        const JsonPathSegment* segments() const { return m_psegments; }
+        // evaluates the query over the value under the reader's cursor, passing each
+        // match to the sink, and leaves the reader on the node after the value.
+        // the subtree of a match isn't searched for further matches.
+        // paths with a filter may need the overload that takes a pool
+        bool evaluate(JsonReader& reader,JsonQuerySink& sink) const {
+            return evaluate(nullptr,reader,sink);
+        }
+        // evaluates the query, holding back in the pool what has to wait on a filter's outcome.
+        // the pool is restored after each candidate, so sinks must not leave anything in it.
+        // running out of pool, or needing one without one, fails with an out of memory error
+        bool evaluate(MemoryPool& pool,JsonReader& reader,JsonQuerySink& sink) const {
+            return evaluate(&pool,reader,sink);
+        }
+        bool evaluate(MemoryPool* ppool,JsonReader& reader,JsonQuerySink& sink) const {
+            if(JsonReader::Initial==reader.nodeType() && !reader.read())
+                return false;
+            switch(reader.nodeType()) {
+                case JsonReader::Error:
+                case JsonReader::EndDocument:
+                    return false;
+            }
+            return evaluateValue(ppool,reader,sink,1);
+        }
+    };
+    // evaluates several queries in one pass over a document, each delivering to its own sink.
+    // the queries' states advance together on every field and element, so the input is read
+    // and lexed once. a subtree only one query can match in is handed to that query alone,
+    // keeping its fast paths. a value several queries need is parsed once into the pool and
+    // delivered to each of their sinks as a JsonElement. a value several queries need where
+    // one of them has to filter it is buffered once and replayed to each
+    class JsonQuerySet {
+        const JsonPath* m_ppaths;
+        JsonQuerySink** m_psinks;
+        size_t m_count;
+        JsonQuerySet(const JsonQuerySet& rhs)=delete;
+        JsonQuerySet& operator=(const JsonQuerySet& rhs)=delete;
+        static bool skip(JsonReader& reader) {
+            return reader.skipSubtree() || !reader.hasError();
+        }
+        bool accepts(size_t query,uint32_t states) const {
+            return 0!=(states&(1UL<<m_ppaths[query].m_count));
+        }
+        // continues a query that's still looking inside a value that was parsed for another
+        bool evaluateElement(size_t query,const JsonElement& value,uint32_t states) {
+            if(accepts(query,states))
+                return m_psinks[query]->match(value);
+            if(0==states)
+                return true;
+            const JsonPath& path = m_ppaths[query];
+            uint32_t conditional = (states&path.m_filters)<<1;
+            unsigned long index = 0;
+            switch(value.type()) {
+                case JsonElement::Object:
+                    for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe;pfe=pfe->pnext) {
+                        if(!evaluateElement(query,*pfe->pvalue,path.next(states,pfe->name,0)|filter(query,*pfe->pvalue,conditional)))
+                            return false;
+                    }
+                    break;
+                case JsonElement::Array:
+                    for(JsonArrayEntry* pae = value.parray();nullptr!=pae;pae=pae->pnext) {
+                        if(!evaluateElement(query,*pae->pvalue,path.next(states,nullptr,index++)|filter(query,*pae->pvalue,conditional)))
+                            return false;
+                    }
+                    break;
+            }
+            return true;
+        }
+        // the conditional states if the value passes the query's filter, otherwise 0
+        uint32_t filter(size_t query,const JsonElement& value,uint32_t conditional) const {
+            if(0==conditional || !JsonPath::testElement(value,m_ppaths[query].filterOf(conditional>>1)))
+                return 0;
+            return conditional;
+        }
+        // delivers a value that more than one query needs
+        bool share(MemoryPool& pool,JsonReader& reader,const uint32_t* pstates) {
+            size_t used = pool.used();
+            JsonElement e;
+            bool result = reader.parseSubtree(pool,&e);
+            for(size_t i = 0;result && i<m_count;++i)
+                result = evaluateElement(i,e,pstates[i]);
+            pool.unalloc(pool.used()-used);
+            return result;
+        }
+        // delivers a value that more than one query needs, where some must filter it first
+        bool replay(MemoryPool& pool,JsonReader& reader,const uint32_t* pstates) {
+            size_t used = pool.used();
+            const char* text;
+            size_t size;
+            bool result = JsonPath::buffer(pool,reader,&text,&size);
+            for(size_t i = 0;result && i<m_count;++i) {
+                if(0!=(pstates[i]|pstates[m_count+i]))
+                    result = m_ppaths[i].evaluateText(pool,reader,text,size,*m_psinks[i],pstates[i],pstates[m_count+i]);
+            }
+            pool.restore(used);
+            return result;
+        }
+        // evaluates the value under the cursor, leaving the reader on the node after it.
+        // the states are followed by the conditional states that hold if the value passes
+        // its query's filter
+        bool evaluateValue(MemoryPool& pool,JsonReader& reader,const uint32_t* pstates) {
+            size_t active = 0;
+            size_t query = 0;
+            bool accepted = false;
+            bool conditional = false;
+            for(size_t i = 0;i<m_count;++i) {
+                if(0!=(pstates[i]|pstates[m_count+i])) {
+                    ++active;
+                    query = i;
+                    accepted = accepted || accepts(i,pstates[i]);
+                    conditional = conditional || 0!=pstates[m_count+i];
+                }
+            }
+            if(0==active)
+                return skip(reader);
+            if(1==active)
+                return m_ppaths[query].evaluateChild(&pool,reader,*m_psinks[query],pstates[query],pstates[m_count+query]);
+            if(conditional)
+                return replay(pool,reader,pstates);
+            if(accepted)
+                return share(pool,reader,pstates);
+            switch(reader.nodeType()) {
+                case JsonReader::Object:
+                case JsonReader::Array:
+                    return evaluateContainer(pool,reader,pstates);
+            }
+            return skip(reader);
+        }
+        bool evaluateContainer(MemoryPool& pool,JsonReader& reader,const uint32_t* pstates) {
+            size_t size = 2*m_count*sizeof(uint32_t);
+            uint32_t* pchild = (uint32_t*)pool.alloc(size);
+            if(nullptr==pchild)
+                return false;
+            bool result = (JsonReader::Object==reader.nodeType())?
+                evaluateFields(pool,reader,pstates,pchild):
+                evaluateElements(pool,reader,pstates,pchild);
+            pool.unalloc(size);
+            return result;
+        }
+        // every child of a container shares its filters' conditional states
+        void conditions(const uint32_t* pstates,uint32_t* pchild) const {
+            for(size_t i = 0;i<m_count;++i)
+                pchild[m_count+i] = (pstates[i]&m_ppaths[i].m_filters)<<1;
+        }
+        bool evaluateFields(MemoryPool& pool,JsonReader& reader,const uint32_t* pstates,uint32_t* pchild) {
+            if(!reader.read())
+                return false;
+            conditions(pstates,pchild);
+            while(JsonReader::Field==reader.nodeType()) {
+                bool alive = false;
+                for(size_t i = 0;i<m_count;++i) {
+                    pchild[i] = m_ppaths[i].next(pstates[i],reader.value(),0);
+                    alive = alive || 0!=(pchild[i]|pchild[m_count+i]);
+                }
+                if(!alive) {
+                    if(!skip(reader))
+                        return false;
+                } else if(!reader.read() || !evaluateValue(pool,reader,pchild))
+                    return false;
+            }
+            if(JsonReader::EndObject!=reader.nodeType())
+                return false;
+            return reader.read() || !reader.hasError();
+        }
+        bool evaluateElements(MemoryPool& pool,JsonReader& reader,const uint32_t* pstates,uint32_t* pchild) {
+            if(!reader.read())
+                return false;
+            conditions(pstates,pchild);
+            unsigned long index = 0;
+            while(JsonReader::EndArray!=reader.nodeType()) {
+                if(JsonReader::EndDocument==reader.nodeType() || reader.hasError())
+                    return false;
+                for(size_t i = 0;i<m_count;++i)
+                    pchild[i] = m_ppaths[i].next(pstates[i],nullptr,index);
+                ++index;
+                if(!evaluateValue(pool,reader,pchild))
+                    return false;
+            }
+            return reader.read() || !reader.hasError();
+        }
+    public:
+        // the paths and sinks are parallel arrays of count entries
+        JsonQuerySet(const JsonPath* ppaths,JsonQuerySink** psinks,size_t count) : m_ppaths(ppaths),m_psinks(psinks),m_count(count) {
+        }
+        // evaluates every query over the value under the reader's cursor and leaves the reader
+        // on the node after it. the pool holds the query states while the value is walked, and
+        // values shared between queries while they're delivered, and is restored after
+        bool evaluate(MemoryPool& pool,JsonReader& reader) {
+            if(JsonReader::Initial==reader.nodeType() && !reader.read())
+                return false;
+            switch(reader.nodeType()) {
+                case JsonReader::Error:
+                case JsonReader::EndDocument:
+                    return false;
+            }
+            size_t size = 2*m_count*sizeof(uint32_t);
+            uint32_t* proot = (uint32_t*)pool.alloc(size);
+            if(nullptr==proot && 0<size)
+                return false;
+            for(size_t i = 0;i<m_count;++i) {
+                proot[i] = 1;
+                proot[m_count+i] = 0;
+            }
+            bool result = evaluateValue(pool,reader,proot);
+            pool.unalloc(size);
+            return result;
+        }
+    };
+}
+#endif
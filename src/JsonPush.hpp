@@ -0,0 +1,81 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONPUSH_HPP
+#define HTCW_JSONPUSH_HPP
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#endif
+#include "LexSource.hpp"
+#include "JsonReader.hpp"
+
+namespace json {
+    // reads JSON that's pushed to it a piece at a time, so an event loop can parse input as it
+    // arrives without blocking on it. when a node runs past the input fed so far, the reader
+    // goes back to where it was before the node and reports NeedMoreInput. feed() it more and
+    // call the same method again, and the node is read again from its start. only the input
+    // from the start of the unfinished node on is kept
+    class JsonPushReader {
+        lex::PushLexSource& m_source;
+        JsonReader m_reader;
+        bool m_needMoreInput;
+        JsonPushReader(const JsonPushReader& rhs)=delete;
+        JsonPushReader& operator=(const JsonPushReader& rhs)=delete;
+        template<typename TFunc> bool attempt(TFunc func) {
+            JsonReader::Checkpoint cp;
+            m_reader.checkpoint(cp);
+            m_source.mark();
+            bool result = func(m_reader);
+            if(m_source.starved()) {
+                m_reader.rollback(cp);
+                m_source.rewind();
+                m_needMoreInput = true;
+                return false;
+            }
+            m_needMoreInput = false;
+            return result;
+        }
+    public:
+        // the node type reported when the input fed so far runs out
+        static const int8_t NeedMoreInput = -4;
+        JsonPushReader(lex::PushLexSource& source) : m_source(source),m_reader(source),m_needMoreInput(false) {
+        }
+        // adds input. returns false if out of memory or finish() was called
+        bool feed(const char* data,size_t size) {
+            return m_source.feed(data,size);
+        }
+        // indicates no more input is coming
+        void finish() {
+            m_source.finish();
+        }
+        // drops all the input and readies the reader for a new document
+        void reset() {
+            m_source.clear();
+            m_reader.reset();
+            m_needMoreInput = false;
+        }
+        // reads the next node. returns false at the end, on an error, or if more input is needed
+        bool read() {
+            return attempt([](JsonReader& reader) { return reader.read(); });
+        }
+        // skips the current subtree. the subtree is kept until it's been skipped in full, so
+        // don't use this on values too big to buffer
+        bool skipSubtree() {
+            return attempt([](JsonReader& reader) { return reader.skipSubtree(); });
+        }
+        // moves to the first node of the next record of a stream of top level values, like JSON
+        // Lines. see JsonReader::nextRecord()
+        bool nextRecord() {
+            return attempt([](JsonReader& reader) { return reader.nextRecord(); });
+        }
+        // indicates the last call ran out of input
+        bool needMoreInput() const { return m_needMoreInput; }
+        int8_t nodeType() const { return m_needMoreInput?NeedMoreInput:m_reader.nodeType(); }
+        // the reader, for the value and the rest of the current node. don't move it with its
+        // own methods, since they can't be undone when the input runs out. the value isn't
+        // valid after NeedMoreInput
+        JsonReader& reader() { return m_reader; }
+    };
+}
+#endif
@@ -1,3 +1,8 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONREADER_HPP
+#define HTCW_JSONREADER_HPP
 #include <math.h>
 #ifndef ARDUINO
 #include <cinttypes>
@@ -96,6 +101,17 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
         uint8_t m_lastError;
         lex::LexSource& m_lc;
         unsigned long int m_objectDepth;
+        // set once nextRecord() is used, so read() stops at the end of each top level value
+        bool m_records;
+        // set while a record's top level value is a scalar
+        bool m_recordValue;
+        // set when nextRecord() abandons a partly read record at its newline
+        bool m_recordLines;
+        unsigned long long m_skippedRecords;
+        // in record mode, the position where the last run of whitespace ended, and where the
+        // last one with a newline in it ended
+        unsigned long long m_spaceEnd;
+        unsigned long long m_lineStart;
 
         void error(uint8_t code,const char* msg) {
             m_lastError = code;
@@ -130,9 +146,9 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
         }
         bool recoverValue() {
             uint32_t cp;
-            // recover the cursor
+            // recover the cursor. a record's top level scalar ends with its line
             m_state = Value;
-            while(m_lc.advance() && ']'!=(cp=m_lc.current())&&'}'!=cp&&','!=cp);
+            while(m_lc.advance() && ']'!=(cp=m_lc.current())&&'}'!=cp&&','!=cp&&(!m_recordValue || '\n'!=cp));
             if(m_lc.hasError()) {
                 m_state = Error; // unrecoverable
                 error(m_lc);
@@ -220,7 +236,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     if(!skipFinalRead)
                         read();
                     else {
-                        if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                        if(!skipWhiteSpace()) {
                             error(m_lc);
                             return false;
                         }
@@ -258,7 +274,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     if(!skipFinalRead)
                         read();
                     else {
-                        if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                        if(!skipWhiteSpace()) {
                             error(m_lc);
                             return false;
                         }
@@ -289,7 +305,8 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     }
                     if(!skipFinalRead) {
                         if(EndArray==m_state && !read()) 
-                            return false;
+                            if(EndDocument!=m_state)
+                                return false;
                     } else {
                         if(!skipIfComma())
                             return false;
@@ -351,6 +368,74 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
             }
             return false;
         }
+        // extracts one item of a wildcard or slice and hands it to the sink, leaving the
+        // reader on the node after the item
+        bool extractItem(MemoryPool& pool,JsonExtractor& extraction,unsigned long index,const char* field) {
+            JsonExtractor& child = *extraction.pchildren;
+            if(0==child.count) {
+                if(!parseSubtree(pool,child.presult))
+                    return false;
+            } else if(!extract(pool,child))
+                return false;
+            return extraction.psink->extracted(child,index,field);
+        }
+        bool extractEachImpl(MemoryPool& pool,JsonExtractor& extraction) {
+            if(nullptr==extraction.pchildren || nullptr==extraction.psink) {
+                JSON_ERROR(INVALID_ARGUMENT);
+                return false;
+            }
+            unsigned long idx = 0;
+            if(Array==m_state) {
+                if(!read())
+                    return false;
+                while(EndArray!=m_state) {
+                    if(hasError() || EndDocument==m_state)
+                        return false;
+                    if(JsonExtractor::Slice==extraction.kind && idx>=extraction.end) {
+                        if(!skipToEndArray())
+                            return false;
+                        break;
+                    }
+                    if(JsonExtractor::Wildcard==extraction.kind ||
+                            (idx>=extraction.start && 0==(idx-extraction.start)%extraction.step)) {
+                        // each item gets the pool back the way it was
+                        size_t savepoint = pool.savepoint();
+                        bool result = extractItem(pool,extraction,idx,nullptr);
+                        pool.restore(savepoint);
+                        if(!result)
+                            return false;
+                    } else if(!skipSubtree() && hasError())
+                        return false;
+                    ++idx;
+                }
+            } else if(Object==m_state && JsonExtractor::Wildcard==extraction.kind) {
+                if(!read())
+                    return false;
+                while(EndObject!=m_state) {
+                    if(hasError() || Field!=m_state)
+                        return false;
+                    size_t savepoint = pool.savepoint();
+                    char* field = (char*)pool.alloc(strlen(value())+1);
+                    if(nullptr==field) {
+                        JSON_ERROR(OUT_OF_MEMORY);
+                        return false;
+                    }
+                    strcpy(field,value());
+                    bool result = read() && extractItem(pool,extraction,idx,field);
+                    pool.restore(savepoint);
+                    if(!result)
+                        return false;
+                    ++idx;
+                }
+            } else {
+                // a scalar, or an object under a slice, has no items to hand over
+                JSON_ERROR(UNEXPECTED_VALUE);
+                return false;
+            }
+            // end like the fixed extractions do, so these can be their children
+            skipIfComma();
+            return !hasError();
+        }
         bool extractImpl(MemoryPool& pool,JsonExtractor& extraction,bool subcall) {
             //if(m_state==EndObject) asm("int $3");
             if(0==extraction.count) {
@@ -361,6 +446,11 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                 }
                 return false;
             }
+            if(JsonExtractor::Fixed!=extraction.kind) {
+                if(Initial==m_state && !read())
+                    return false;
+                return extractEachImpl(pool,extraction);
+            }
             int matched;
             size_t c;
             size_t idx;
@@ -429,28 +519,9 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     }
                     matched=-1;
                     c= extraction.count;
-                    // prepare our allocated space by copying our field pointers
                     depth = m_objectDepth;
                     while(!hasError() && ((m_state!=EndObject || (m_objectDepth>=depth)||'\"'==m_lc.current()))) {
-                        // we need space for extra string pointers for scanMatchFields()
-                        // scanMatchFields() is destructive to the pointers we give it.
-                        // so if we haven't already, allocate it
-                        if(nullptr==extraction.palloced) {
-                            extraction.palloced = (const void**)pool.alloc(extraction.count*sizeof(char*));
-                            if(nullptr==extraction.palloced) {
-                                JSON_ERROR(OUT_OF_MEMORY);
-                                return false;    
-                            }
-                        }
-                        // copy fresh field string pointers for scanMatchFields()
-                        memcpy(extraction.palloced,extraction.pfields,extraction.count*sizeof(char*));
-                        
-                        matched = scanMatchFields((const char**)extraction.palloced,extraction.count);
-                        // free what we just used since we can't later. it's just better to 
-                        // use the pool temporarily like this, since we can't call unalloc() after 
-                        // this pointer gets "stale" (meaning another alloc() happens since)
-                        pool.unalloc(extraction.count*sizeof(char*));
-                        extraction.palloced = nullptr;
+                        matched = scanMatchFields(extraction.pfields,extraction.count,extraction.ptable);
                         if(-1!=matched) {
                             if(nullptr!=extraction.pchildren) {
                                 // read to the field value
@@ -536,7 +607,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                 if(!m_lc.advance()) {
                     return false;
                 }
-                if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                if(!skipWhiteSpace()) {
                     error(m_lc);
                     return false;
                 }
@@ -550,7 +621,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         m_state = Error; // unrecoverable
                         return false;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -571,7 +642,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     m_state = Error;
                     return false;
                 }
-                if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                if(!skipWhiteSpace()) {
                     error(m_lc);
                     return false;
                 }
@@ -585,7 +656,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         m_state = Error; // unrecoverable
                         return false;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -598,13 +669,28 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
             }
             return false;
         }
-        int scanMatchFields(const char** fields,size_t fieldCount) {
+        // the index of the lowest field named by the bytes, or -1
+        static int matchField(const char* const* fields,size_t fieldCount,const char* name,size_t size) {
+            for(size_t i = 0;i<fieldCount;++i) {
+                const char* sz = fields[i];
+                if(nullptr!=sz && 0==strncmp(sz,name,size) && 0==sz[size])
+                    return (int)i;
+            }
+            return -1;
+        }
+        // matches the field name under the cursor against fields, leaving the reader on the
+        // field if it matched, or past the field's value if it didn't. the table is optional
+        int scanMatchFields(const char* const* fields,size_t fieldCount,const JsonFieldTable* ptable=nullptr) {
             int result = -1;
             int32_t ch;
             if('\"'!=m_lc.current()) {
                 JSON_ERROR(UNEXPECTED_VALUE);
                 return -1;  
             }
+            // names without escapes in an in memory source are matched against their bytes
+            const char* name;
+            size_t nameSize;
+            bool contiguous = m_lc.peekString(&name,&nameSize);
             if (!m_lc.advance()) {
                 if(m_lc.hasError()) {
                     error(m_lc);
@@ -614,8 +700,28 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                 m_state = Error;
                 return -1;
             }
-            size_t fc = fieldCount;
-            while(0<fc && m_lc.more() && '\"'!=m_lc.current())
+            // the lowest field whose start matches what we've read so far, and how far into it
+            // we are. any other candidates share those same bytes, since we compare codepoints
+            size_t cand = 0;
+            size_t off = 0;
+            bool any = false;
+            if(contiguous) {
+                result = (nullptr!=ptable)?ptable->find(name,nameSize):matchField(fields,fieldCount,name,nameSize);
+                if('\"'!=m_lc.current() && '\"'!=m_lc.skipToAny("\"")) {
+                    if(m_lc.hasError()) {
+                        error(m_lc);
+                        return false;
+                    }
+                    JSON_ERROR(UNTERMINATED_STRING);
+                    m_state = Error;
+                    return -1;
+                }
+            } else {
+                while(cand<fieldCount && nullptr==fields[cand])
+                    ++cand;
+                any = cand<fieldCount;
+            }
+            while(any && m_lc.more() && '\"'!=m_lc.current())
             {
                 if(!JsonUtility::undecorate(m_lc,ch,false)) {
                     if(m_lc.hasError()) {
@@ -626,27 +732,33 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     m_state = Error;
                     return -1;
                 }
-                  
                 int32_t cpcmp;
-                for(size_t i = 0;i<fieldCount;++i) {
-                    const char *sz = fields[i];
-                    if(nullptr!=sz) {
-                        sz=JsonUtility::decodeUtf8(fields[i],cpcmp);
-                        if(ch!=cpcmp) {
-                            // disqualify this entry
-                            fields[i]=nullptr;
-                            --fc;
-                            continue;
+                const char* sz = JsonUtility::decodeUtf8(fields[cand]+off,cpcmp);
+                if(0==fields[cand][off] || ch!=cpcmp) {
+                    // find the next field that shares the candidate's start and continues with ch
+                    any = false;
+                    for(size_t i = cand+1;i<fieldCount;++i) {
+                        if(nullptr!=fields[i] && 0==strncmp(fields[i],fields[cand],off) && 0!=fields[i][off]) {
+                            sz = JsonUtility::decodeUtf8(fields[i]+off,cpcmp);
+                            if(ch==cpcmp) {
+                                cand = i;
+                                any = true;
+                                break;
+                            }
                         }
-                        fields[i]=sz;
                     }
+                    if(!any)
+                        break;
                 }
+                off = sz-fields[cand];
             }
             if('\"'==m_lc.current()) {
-                for(size_t i = 0;i<fieldCount;++i) {
-                    if(fields[i] && 0==(*fields[i])) {
-                        result = i;
-                        break;
+                if(any) {
+                    for(size_t i = cand;i<fieldCount;++i) {
+                        if(nullptr!=fields[i] && 0==strncmp(fields[i],fields[cand],off) && 0==fields[i][off]) {
+                            result = (int)i;
+                            break;
+                        }
                     }
                 }
                 // if result != -1 there is potentially a match
@@ -656,7 +768,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         return false;
                     }
                 }
-                if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                if(!skipWhiteSpace()) {
                     error(m_lc);
                     return false;
                 }
@@ -670,7 +782,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         m_state = Error; // unrecoverable
                         return -1;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -702,7 +814,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     JSON_ERROR(UNTERMINATED_STRING);
                     return -1;
                 }
-                if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                if(!skipWhiteSpace()) {
                     error(m_lc);
                     return false;
                 }
@@ -715,7 +827,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         JSON_ERROR(FIELD_NO_VALUE);
                         return -1;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -747,8 +859,39 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
             }
             return false;
         }
+        // indicates whether the character can follow a scalar. a record's top level scalar can
+        // only be followed by whitespace or the end of the input
+        bool endsValue(int32_t cp) const {
+            if(m_recordValue)
+                return m_lc.eof() || m_spaceEnd==m_lc.position();
+            return m_lc.eof() || ']'==cp || '}'==cp || ','==cp;
+        }
+        // skips whitespace. in record mode it also notes where the whitespace ended, and where
+        // a line started, so that records can be told apart
+        bool skipWhiteSpace() {
+            if(!m_records)
+                return JsonUtility::skipWhiteSpace(m_lc);
+            bool spaced = false;
+            bool line = false;
+            int32_t cp = m_lc.current();
+            while(' '==cp || '\t'==cp || '\r'==cp || '\n'==cp) {
+                spaced = true;
+                if('\n'==cp)
+                    line = true;
+                if(!m_lc.advance())
+                    break;
+                cp = m_lc.current();
+            }
+            if(spaced) {
+                m_spaceEnd = m_lc.position();
+                if(line)
+                    m_lineStart = m_spaceEnd;
+            }
+            return !m_lc.hasError();
+        }
         bool readAnyOpen(bool allowFields=false) {
             int32_t cp;
+            bool real;
             m_valueType = Undefined;
             switch(m_lc.current()) {
                 case '[':
@@ -756,7 +899,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         error(m_lc);
                         return false;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -765,7 +908,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         m_state = Error; // unrecoverable            
                         return false;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -777,7 +920,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         error(m_lc);
                         return false;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -786,7 +929,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         m_state = Error; // unrecoverable           
                         return false;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -807,7 +950,16 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     m_valueType=Integer;
                     m_lexState.flags.state=0;
                     m_lc.clearCapture();
-            
+                    // sources that decoded the number already hand it over as is
+                    if(m_lc.takeNumber(&m_lexState.integer,&m_lexState.real,&real)) {
+                        if(m_lc.hasError() || !skipWhiteSpace()) {
+                            error(m_lc);
+                            return false;
+                        }
+                        m_valueType = real?Real:Integer;
+                        m_state = Value;
+                        return true;
+                    }
                     while(JsonUtility::lexNumber(m_lc,m_lexState));
                     
                     if(lex::LexSource::OutOfMemoryError==m_lc.error())  {
@@ -819,11 +971,11 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         recoverValue();
                         return false;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
-                    if(0!=m_lexState.flags.accept && !m_lc.hasError() && (m_lc.eof()||']'==(cp=m_lc.current())||'}'==cp||','==cp)) {
+                    if(0!=m_lexState.flags.accept && !m_lc.hasError() && endsValue(cp=m_lc.current())) {
                         m_state = Value;
                         if(m_lexState.flags.fracPart>1) {
                             double p = pow(10,m_lexState.flags.eCount);
@@ -867,8 +1019,8 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         recoverValue();
                         return false;
                     }
-                    JsonUtility::skipWhiteSpace(m_lc);
-                    if(0!=m_lexState.flags.accept && !m_lc.hasError() && (']'==(cp=m_lc.current())||'}'==cp||','==cp||m_lc.eof())) {
+                    skipWhiteSpace();
+                    if(0!=m_lexState.flags.accept && !m_lc.hasError() && endsValue(cp=m_lc.current())) {
                         m_state = Value;
                         return true;
                     } 
@@ -909,7 +1061,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         }
                     }
                     m_valueType = String;
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -920,7 +1072,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                                 return false;
                             }
                         }
-                        if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                        if(!skipWhiteSpace()) {
                             error(m_lc);
                             return false;
                         }   
@@ -973,7 +1125,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         }
                     }
                     m_lexState.flags.accept = 1;
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -999,8 +1151,8 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         recoverValue();
                         return false;
                     }
-                    JsonUtility::skipWhiteSpace(m_lc);
-                    if(0!=m_lexState.flags.accept && !m_lc.hasError() && (']'==(cp=m_lc.current())||'}'==cp||','==cp||m_lc.eof())) {
+                    skipWhiteSpace();
+                    if(0!=m_lexState.flags.accept && !m_lc.hasError() && endsValue(cp=m_lc.current())) {
                         m_state = EndValuePart;
                         if(m_lexState.flags.fracPart>1) {
                             double p = pow(10,m_lexState.flags.eCount);
@@ -1038,13 +1190,13 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         recoverValue();
                         return false;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         if(m_lc.hasError()) {
                             error(m_lc);
                             return false;
                         }
                     }
-                    if(0!=m_lexState.flags.accept && !m_lc.hasError() && (']'==(cp=m_lc.current())||'}'==cp||','==cp||m_lc.eof())) {
+                    if(0!=m_lexState.flags.accept && !m_lc.hasError() && endsValue(cp=m_lc.current())) {
                         m_state = EndValuePart;
                         return true;
                     } 
@@ -1083,7 +1235,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
             switch(m_lc.current()) {
                 case ',':
                     m_lc.advance();
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -1098,32 +1250,24 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     }
                     break;
                 case ']':
-                    if(!m_lc.advance()) {
-                        if(m_lc.hasError()) {
-                            error(m_lc);
-                            return false;
-                        }
-                        JSON_ERROR(UNTERMINATED_ARRAY);
-                        m_state = Error; // unrecoverable
+                    // the bracket can be the last thing in the input
+                    if(!m_lc.advance() && m_lc.hasError()) {
+                        error(m_lc);
                         return false;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
                     m_state = EndArray;
                     break;
                 case '}':
-                    if(!m_lc.advance()) {
-                        if(m_lc.hasError()) {
-                            error(m_lc);
-                            return false;
-                        }
-                        JSON_ERROR(UNTERMINATED_OBJECT);
-                        m_state = Error; // unrecoverable
+                    // the bracket can be the last thing in the input
+                    if(!m_lc.advance() && m_lc.hasError()) {
+                        error(m_lc);
                         return false;
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -1143,7 +1287,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         return false;
                     }
                 }
-                if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                if(!skipWhiteSpace()) {
                     error(m_lc);
                     return false;
                 }
@@ -1160,14 +1304,17 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
             if(!m_lc.more() || '}'!= m_lc.current())
                 return false;
             if(!m_lc.advance()) {
-                error(m_lc);
-                return !hasError();
+                if(m_lc.hasError()) {
+                    error(m_lc);
+                    return false;
+                }
             }
-            if(!JsonUtility::skipWhiteSpace(m_lc)) {
+            if(!skipWhiteSpace()) {
                 error(m_lc);
                 return false;
             }
-
+            if(0<m_objectDepth)
+                --m_objectDepth;
             m_state = EndObject;
             return true;
         }
@@ -1180,7 +1327,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     return false;
                 }
             }
-            if(!JsonUtility::skipWhiteSpace(m_lc)) {
+            if(!skipWhiteSpace()) {
                 error(m_lc);
                 return false;
             }
@@ -1197,7 +1344,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                             return false;
                         }
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -1213,6 +1360,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     
                     return true;
             }
+            JSON_ERROR(UNEXPECTED_VALUE);
             return false;
         }
         bool readValueOrEndArray() {
@@ -1224,7 +1372,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                             return false;
                         }
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
@@ -1249,7 +1397,9 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         return false;
                     return true;
                 default:
-                    if(!m_lc.skipToAny(",]}")) {
+                    // in record mode a scalar ends with its line at the latest, so a record
+                    // that was cut short doesn't swallow the next one
+                    if(!m_lc.skipToAny(m_records?",]}\n":",]}")) {
                         if(m_lc.hasError()) {
                             error(m_lc);
                             return false;
@@ -1257,6 +1407,17 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         m_state = EndDocument;
                         return false;
                     }
+                    if('\n'==m_lc.current()) {
+                        if(!skipWhiteSpace()) {
+                            error(m_lc);
+                            return false;
+                        }
+                        int32_t cp = m_lc.current();
+                        if(!m_lc.more() || (','!=cp && ']'!=cp && '}'!=cp)) {
+                            JSON_ERROR(UNTERMINATED_OBJECT_OR_ARRAY);
+                            return false;
+                        }
+                    }
                     m_state = Value;
                     return true;
             }
@@ -1271,7 +1432,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                             return false;
                         }
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         if(m_lc.hasError()) {
                             error(m_lc);
                             return false;
@@ -1292,7 +1453,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                             return false;
                         }
                     }
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         if(m_lc.hasError()) {
                             error(m_lc);
                             return false;
@@ -1339,7 +1500,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                 m_state=Error; // unrecoverable
                 return false;
             }
-            if(!JsonUtility::skipWhiteSpace(m_lc)) {
+            if(!skipWhiteSpace()) {
                 if(m_lc.hasError()) {
                     error(m_lc);
                     return false;
@@ -1353,7 +1514,15 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
             clearError();
             // TODO: this is so much faster when i don't have to track arrays
             // for some reason though, that breaks extract() and/or parseSubtree()
-            char ch = m_lc.skipToAny("\"{}[]");
+            // sources that know where their containers end can jump to the closing bracket
+            char ch = (1==depth)?m_lc.skipToContainerEnd():0;
+            if(0==ch) {
+                if(m_lc.hasError()) {
+                    error(m_lc);
+                    return false;
+                }
+                ch = m_lc.skipToAny("\"{}[]");
+            }
             while(0!=ch) {
                 switch(ch) {
                     case '\"':
@@ -1412,7 +1581,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                                     return false;
                                 }
                             }
-                            if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                            if(!skipWhiteSpace()) {
                                 error(m_lc);
                                 return false;
                             }
@@ -1442,7 +1611,15 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
         bool skipArrayPart(int depth=1)
         {
             clearError();
-            char ch = m_lc.skipToAny("\"{}[]");
+            // sources that know where their containers end can jump to the closing bracket
+            char ch = (1==depth)?m_lc.skipToContainerEnd():0;
+            if(0==ch) {
+                if(m_lc.hasError()) {
+                    error(m_lc);
+                    return false;
+                }
+                ch = m_lc.skipToAny("\"{}[]");
+            }
             while(0!=ch) {
                 switch (m_lc.current())
                 {
@@ -1505,7 +1682,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                         }
                         --depth;
                         if (0>=depth) {
-                            if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                            if(!skipWhiteSpace()) {
                                 error(m_lc);
                                 return false;
                             }
@@ -1522,6 +1699,168 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
            
             return false;
         }
+        // stops a raw copy and reports why it failed
+        bool copyFailed(uint8_t code,const char* msg) {
+            m_lc.tee(nullptr);
+            if(m_lc.hasError()) {
+                error(m_lc);
+                return false;
+            }
+            error(code,msg);
+            m_state = Error; // unrecoverable
+            return false;
+        }
+        // copies the raw text of the value under the cursor to the sink and moves past it
+        // when depth is non-zero, the remainder of the enclosing arrays or objects is copied instead
+        bool copyPart(lex::LexSink& sink,int depth) {
+            clearError();
+            if(!m_lc.more())
+                return false;
+            char ch = (char)m_lc.current();
+            m_lc.tee(&sink);
+            if(0==depth) {
+                switch(ch) {
+                    case '{':
+                    case '[':
+                        ++depth;
+                        if(!m_lc.advance())
+                            return copyFailed(JSON_ERROR_UNTERMINATED_OBJECT_OR_ARRAY,JSON_ERROR_UNTERMINATED_OBJECT_OR_ARRAY_MSG);
+                        break;
+                    case '\"':
+                        if(!m_lc.advance())
+                            return copyFailed(JSON_ERROR_UNTERMINATED_STRING,JSON_ERROR_UNTERMINATED_STRING_MSG);
+                        while('\"'!=(ch=m_lc.skipToAny("\"\\"))) {
+                            if(0==ch || !m_lc.advance() || !m_lc.advance())
+                                return copyFailed(JSON_ERROR_UNTERMINATED_STRING,JSON_ERROR_UNTERMINATED_STRING_MSG);
+                        }
+                        // write the final quote ourselves so trailing whitespace isn't copied
+                        m_lc.tee(nullptr);
+                        if(!sink.write(&ch,1))
+                            return copyFailed(JSON_ERROR_IO_ERROR,JSON_ERROR_IO_ERROR_MSG);
+                        if(!m_lc.advance() && m_lc.hasError()) {
+                            error(m_lc);
+                            return false;
+                        }
+                        if(!skipWhiteSpace()) {
+                            error(m_lc);
+                            return false;
+                        }
+                        m_state = Value;
+                        return true;
+                    default:
+                        while(m_lc.more()) {
+                            switch(m_lc.current()) {
+                                case ',':
+                                case ']':
+                                case '}':
+                                case ' ':
+                                case '\t':
+                                case '\r':
+                                case '\n':
+                                    break;
+                                default:
+                                    if(m_lc.advance())
+                                        continue;
+                                    break;
+                            }
+                            break;
+                        }
+                        m_lc.tee(nullptr);
+                        if(m_lc.hasError()) {
+                            error(m_lc);
+                            return false;
+                        }
+                        if(!skipWhiteSpace()) {
+                            error(m_lc);
+                            return false;
+                        }
+                        m_state = Value;
+                        return true;
+                }
+            }
+            while(true) {
+                ch = m_lc.skipToAny("\"{}[]");
+                switch(ch) {
+                    case '\"':
+                        if(!m_lc.advance() || !JsonUtility::skipStringPart(m_lc,true))
+                            return copyFailed(JSON_ERROR_UNTERMINATED_STRING,JSON_ERROR_UNTERMINATED_STRING_MSG);
+                        break;
+                    case '{':
+                        ++m_objectDepth;
+                        // fall through
+                    case '[':
+                        ++depth;
+                        if(!m_lc.advance())
+                            return copyFailed(JSON_ERROR_UNTERMINATED_OBJECT_OR_ARRAY,JSON_ERROR_UNTERMINATED_OBJECT_OR_ARRAY_MSG);
+                        break;
+                    case '}':
+                        --m_objectDepth;
+                        // fall through
+                    case ']':
+                        if(0==--depth) {
+                            m_lc.tee(nullptr);
+                            if(!sink.write(&ch,1))
+                                return copyFailed(JSON_ERROR_IO_ERROR,JSON_ERROR_IO_ERROR_MSG);
+                            m_state = ('}'==ch)?EndObject:EndArray;
+                            if(!m_lc.advance() && m_lc.hasError()) {
+                                error(m_lc);
+                                return false;
+                            }
+                            if(!skipWhiteSpace()) {
+                                error(m_lc);
+                                return false;
+                            }
+                            return true;
+                        }
+                        if(!m_lc.advance())
+                            return copyFailed(JSON_ERROR_UNTERMINATED_OBJECT_OR_ARRAY,JSON_ERROR_UNTERMINATED_OBJECT_OR_ARRAY_MSG);
+                        break;
+                    default:
+                        return copyFailed(JSON_ERROR_UNTERMINATED_OBJECT_OR_ARRAY,JSON_ERROR_UNTERMINATED_OBJECT_OR_ARRAY_MSG);
+                }
+            }
+        }
+        // indicates whether the top level value of a record was just finished. outside of
+        // objects, only a comma or a closing bracket after a value means there's more of it.
+        // anything else has to be set apart from the value by whitespace, or it's an error
+        bool recordEnded() {
+            switch(m_state) {
+                case Value:
+                case EndValuePart:
+                case EndObject:
+                case EndArray:
+                    break;
+                default:
+                    return false;
+            }
+            if(!skipWhiteSpace())
+                return false;
+            if(!m_lc.more())
+                return true;
+            int32_t ch = m_lc.current();
+            if(','==ch || ']'==ch || '}'==ch)
+                return false;
+            if(m_spaceEnd!=m_lc.position()) {
+                JSON_ERROR(INVALID_VALUE);
+                return false;
+            }
+            return true;
+        }
+        // abandons the rest of a record at the next newline, since newlines can't appear inside
+        // JSON strings. returns false at the end of the input
+        bool resyncRecord(bool failed=true) {
+            if(failed)
+                ++m_skippedRecords;
+            if(!m_lc.recover())
+                return false;
+            // a record cut short can fail on the first thing on the next line, which starts
+            // the next record
+            if(m_lineStart==m_lc.position())
+                return true;
+            if('\n'!=m_lc.current() && '\n'!=m_lc.skipToAny("\n"))
+                return false;
+            return true;
+        }
         JsonReader()=delete;
         JsonReader(const JsonReader& rhs) = delete;
         JsonReader(const JsonReader&& rhs) = delete;
@@ -1529,7 +1868,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
         JsonReader& operator=(const JsonReader&& rhs) = delete;
     public:
         // constructs an instance
-        JsonReader(lex::LexSource& source) : m_state(Initial),m_valueType(Undefined),m_lastError(0), m_lc(source),m_objectDepth(0) {
+        JsonReader(lex::LexSource& source) : m_state(Initial),m_valueType(Undefined),m_lastError(0), m_lc(source),m_objectDepth(0),m_records(false),m_recordValue(false),m_recordLines(false),m_skippedRecords(0),m_spaceEnd(0),m_lineStart(0) {
         
         }
         // destroys an instance
@@ -1541,8 +1880,107 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
             m_objectDepth = 0;
             m_lastError = 0;
             m_valueType = Undefined;
+            m_records = false;
+            m_recordValue = false;
+            m_recordLines = false;
+            m_skippedRecords = 0;
+            m_spaceEnd = 0;
+            m_lineStart = 0;
             m_lc.reset();
         }
+        // the reader's state between nodes, so a read can be undone when a push source runs out
+        // of input partway through it
+        struct Checkpoint {
+            int8_t state;
+            int8_t valueType;
+            JsonLexState lexState;
+            uint8_t lastError;
+            unsigned long int objectDepth;
+            bool records;
+            bool recordValue;
+            unsigned long long skippedRecords;
+            unsigned long long spaceEnd;
+            unsigned long long lineStart;
+        };
+        void checkpoint(Checkpoint& cp) const {
+            cp.state = m_state;
+            cp.valueType = m_valueType;
+            cp.lexState = m_lexState;
+            cp.lastError = m_lastError;
+            cp.objectDepth = m_objectDepth;
+            cp.records = m_records;
+            cp.recordValue = m_recordValue;
+            cp.skippedRecords = m_skippedRecords;
+            cp.spaceEnd = m_spaceEnd;
+            cp.lineStart = m_lineStart;
+        }
+        void rollback(const Checkpoint& cp) {
+            m_state = cp.state;
+            m_valueType = cp.valueType;
+            m_lexState = cp.lexState;
+            m_lastError = cp.lastError;
+            m_objectDepth = cp.objectDepth;
+            m_records = cp.records;
+            m_recordValue = cp.recordValue;
+            m_skippedRecords = cp.skippedRecords;
+            m_spaceEnd = cp.spaceEnd;
+            m_lineStart = cp.lineStart;
+        }
+        // moves to the first node of the next record of a stream of top level values, like
+        // JSON Lines, and readies the reader for it. once this is used, read() and the skip and
+        // parse methods report EndDocument at the end of each record. what's left of a record
+        // that wasn't read to its end is skipped. a record with an error, including one found
+        // while it was being read, is abandoned at the next newline and the record after it is
+        // read instead. returns false at the end of the input
+        bool nextRecord() {
+            m_records = true;
+            if(!hasError() && Initial!=m_state && EndDocument!=m_state) {
+                if(!m_recordLines) {
+                    // finish what's left of the record without loading its values
+                    while(EndDocument!=m_state && !hasError()) {
+                        if(Object==m_state || Array==m_state || Field==m_state)
+                            skipSubtree();
+                        else
+                            read();
+                    }
+                } else if((0!=m_objectDepth || !recordEnded()) && !hasError()) {
+                    // the last node of a record only shows the end once the next read() is called
+                    if(!resyncRecord(false)) {
+                        m_state = m_lc.hasError()?Error:EndDocument;
+                        return false;
+                    }
+                }
+            }
+            while(true) {
+                if(hasError() && !resyncRecord()) {
+                    m_state = m_lc.hasError()?Error:EndDocument;
+                    return false;
+                }
+                // everything else carries over to the next record as is
+                m_state = Initial;
+                m_objectDepth = 0;
+                m_lastError = 0;
+                m_valueType = Undefined;
+                m_spaceEnd = m_lineStart = 0;
+                if(!m_lc.ensureStarted() || !skipWhiteSpace() || !m_lc.more()) {
+                    if(m_lc.hasError())
+                        error(m_lc);
+                    else
+                        m_state = EndDocument;
+                    return false;
+                }
+                if(read())
+                    return true;
+                if(!hasError())
+                    return false;
+            }
+        }
+        // makes nextRecord() abandon a partly read record at its newline instead of skipping the
+        // rest of it. that's cheaper when only a few fields of each record are read, but it
+        // only works when every record is on a line of its own, as in JSON Lines
+        void recordLines(bool enabled) { m_recordLines = enabled; }
+        // indicates the number of records nextRecord() abandoned because of errors
+        unsigned long long skippedRecords() const { return m_skippedRecords; }
         // provides access to the LexSource being read from and captured to
         lex::LexSource& source() const { return m_lc; }
         // indicates whether there's an error
@@ -1552,6 +1990,11 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
         int8_t error() const {
             return m_lastError;
         }
+        // reports that code driving the reader, such as a query, ran out of memory. returns false
+        bool outOfMemory() {
+            JSON_ERROR(OUT_OF_MEMORY);
+            return false;
+        }
         // executes a step of the parse
         bool read() {
             if(!m_lc.ensureStarted()) {
@@ -1568,17 +2011,29 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                 m_state = EndDocument;
                 return false;
             }
+            if(m_records && 0==m_objectDepth) {
+                clearError();
+                if(recordEnded()) {
+                    m_state = EndDocument;
+                    return false;
+                }
+                if(hasError())
+                    return false;
+            }
             clearError();
             switch(m_state) {
                 case Initial:
                     m_objectDepth=0;
                     
-                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                    if(!skipWhiteSpace()) {
                         error(m_lc);
                         return false;
                     }
+                    m_recordValue = m_records;
                     if(!readAnyOpen(false))
                         return false;
+                    if(Object==m_state || Array==m_state)
+                        m_recordValue = false;
                     break;
 
                 case Value:
@@ -1649,6 +2104,9 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                     return skipSubtree();
                 return false;
             case JsonReader::Value: // value
+                // a record's scalar was already read, and the next record follows it
+                if(m_recordValue)
+                    return read() || EndDocument==m_state;
                 if(!skipObjectOrArrayOrValuePart())
                     return false;
                 if(!read() || Error==m_state)
@@ -1679,6 +2137,15 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                 if(m_state!=EndDocument && (m_state!=JsonReader::EndObject || !read() || Error==nodeType()))
                     return m_state==EndDocument;
                 return true;
+            case JsonReader::ValuePart: // partial value
+            case JsonReader::EndValuePart:
+                while(ValuePart==m_state) {
+                    if(!read())
+                        return false;
+                }
+                if(!read() || Error==m_state)
+                    return false;
+                return true;
             case JsonReader::EndArray: // end array
             case JsonReader::EndObject: // end object
                 if(Error==nodeType())
@@ -1687,6 +2154,86 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
             }
             return false;
         }
+        // copies the raw text of the subtree under the cursor to the sink and moves past it,
+        // without lexing values or touching the capture buffer.
+        // on a field, the field's value is copied. scalars that were already read
+        // have no raw text left to copy and must be written from value() instead
+        bool copySubtree(lex::LexSink& sink) {
+            clearError();
+            char ch;
+            switch(m_state) {
+                case Initial:
+                    if(!m_lc.ensureStarted()) {
+                        if(m_lc.hasError()) {
+                            error(m_lc);
+                            return false;
+                        }
+                        m_state = EndDocument;
+                        return false;
+                    }
+                    m_objectDepth = 0;
+                    if(!skipWhiteSpace()) {
+                        error(m_lc);
+                        return false;
+                    }
+                    // fall through
+                case Field:
+                    if(!copyPart(sink,0))
+                        return false;
+                    break;
+                case Object:
+                case Array:
+                    ch = (Object==m_state)?'{':'[';
+                    if(!sink.write(&ch,1)) {
+                        JSON_ERROR(IO_ERROR);
+                        m_state = Error;
+                        return false;
+                    }
+                    if(!copyPart(sink,1))
+                        return false;
+                    break;
+                case EndObject:
+                case EndArray:
+                    return true;
+                case Error:
+                case EndDocument:
+                    return false;
+                default:
+                    JSON_ERROR(INVALID_ARGUMENT);
+                    return false;
+            }
+            if(!read() && hasError())
+                return false;
+            return true;
+        }
+        // skips the value of the field under the cursor, or the document at the start,
+        // reporting the byte offset and length of its raw text in the input.
+        // the span excludes surrounding whitespace, so it can be patched in place
+        bool skipSubtree(unsigned long long& offset,unsigned long long& length) {
+            clearError();
+            if(Field!=m_state && Initial!=m_state) {
+                JSON_ERROR(INVALID_ARGUMENT);
+                return false;
+            }
+            if(!m_lc.ensureStarted()) {
+                if(m_lc.hasError()) {
+                    error(m_lc);
+                    return false;
+                }
+                m_state = EndDocument;
+                return false;
+            }
+            if(!skipWhiteSpace()) {
+                error(m_lc);
+                return false;
+            }
+            offset = m_lc.position()-((0<m_lc.current())?m_lc.currentLength():0);
+            lex::NullLexSink counter;
+            if(!copySubtree(counter))
+                return false;
+            length = counter.count();
+            return true;
+        }
         bool skipToFieldValue(const char* field, int8_t axis, unsigned long int *pdepth = nullptr) {
             return skipToField(field,axis,pdepth) && read();
         }
@@ -1796,7 +2343,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                                         return false;
                                     }
                                 }
-                                if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                                if(!skipWhiteSpace()) {
                                     error(m_lc);
                                     return false;
                                 }
@@ -1810,7 +2357,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                                         m_state = Error; // unrecoverable
                                         return false;
                                     }
-                                    if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                                    if(!skipWhiteSpace()) {
                                         error(m_lc);
                                         return false;
                                     }
@@ -1866,7 +2413,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                                 }
                                 return false;
                             }
-                            if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                            if(!skipWhiteSpace()) {
                                 if(m_lc.hasError()) {
                                     error(m_lc);
                                     return false;
@@ -1888,7 +2435,7 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
                                 }
                                 return false;
                             }
-                            if(!JsonUtility::skipWhiteSpace(m_lc)) {
+                            if(!skipWhiteSpace()) {
                                 if(m_lc.hasError()) {
                                     error(m_lc);
                                     return false;
@@ -1913,6 +2460,56 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
             }
             return false;
         }
+        // moves to the next field of the current object whose name is one of fields, skipping
+        // the others without loading their values. returns the index of the name, leaving the
+        // reader on the field, or -1 at the end of the object, leaving it on EndObject.
+        // call it on the object, or on a field after reading the previous match's value.
+        // the table is optional, and must be built over the same fields
+        int skipToFieldOf(const char* const* fields,size_t fieldCount,const JsonFieldTable* ptable=nullptr) {
+            clearError();
+            if(nullptr==fields) {
+                JSON_ERROR(INVALID_ARGUMENT);
+                return -1;
+            }
+            switch(m_state) {
+                case Field:
+                    // read() already loaded this name
+                    {
+                        int i = (nullptr!=ptable)?
+                            ptable->find(m_lc.captureBuffer(),m_lc.captureSize()):
+                            matchField(fields,fieldCount,m_lc.captureBuffer(),m_lc.captureSize());
+                        if(-1<i)
+                            return i;
+                    }
+                    if(!skipObjectOrArrayOrValuePart() || !skipCommaOrEndObjectOrEndArray())
+                        return -1;
+                    break;
+                case Object:
+                    break;
+                case EndObject:
+                    // the previous match was the last field
+                    return -1;
+                default:
+                    JSON_ERROR(INVALID_ARGUMENT);
+                    return -1;
+            }
+            while(EndObject!=m_state) {
+                if(!skipWhiteSpace()) {
+                    error(m_lc);
+                    return -1;
+                }
+                if('}'==m_lc.current()) {
+                    readFieldOrEndObject();
+                    return -1;
+                }
+                int result = scanMatchFields(fields,fieldCount,ptable);
+                if(hasError())
+                    return -1;
+                if(-1<result)
+                    return result;
+            }
+            return -1;
+        }
         bool skipToIndex(size_t index) {
             clearError();
             if(!m_lc.ensureStarted()) {
@@ -2019,3 +2616,4 @@ const char JSON_ERROR_FIELD_TOO_LONG_MSG[] PROGMEM = "Field name too long. Field
         }
     };
 }
+#endif
@@ -0,0 +1,377 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONSNAPSHOT_HPP
+#define HTCW_JSONSNAPSHOT_HPP
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "MappedFile.hpp"
+#endif
+#include "JsonTree.hpp"
+
+namespace json {
+    // identifies the version of the document a snapshot was built from
+    struct JsonSnapshotSource {
+        uint64_t size;
+        // the modification time, in seconds and the nanoseconds past them where the
+        // platform has them
+        int64_t time;
+        int64_t timeNanoseconds;
+        // so a file replaced by another of the same size and time is told apart
+        uint64_t device;
+        uint64_t inode;
+    };
+    // the layout of a snapshot file. everything is in the byte order of the machine
+    // that wrote it, and all references are offsets from the start of the file so
+    // the file can be mapped anywhere and used in place
+    struct JsonSnapshotHeader {
+        // "JSNP"
+        char magic[4];
+        uint16_t version;
+        // 0x0102 as written. reads differently on a machine of the other byte order
+        uint16_t byteOrder;
+        // FNV-1a of everything after the header
+        uint32_t checksum;
+        uint32_t reserved;
+        // the document the snapshot was built from
+        JsonSnapshotSource source;
+        // the offset of the root node
+        uint64_t root;
+        // the size of the whole snapshot
+        uint64_t size;
+    };
+    // a value in a snapshot. arrays point to count consecutive nodes, objects point to
+    // count consecutive pairs of nodes, name then value. strings point to count bytes
+    // followed by a terminator
+    struct JsonSnapshotNode {
+        int8_t type;
+        uint8_t reserved[3];
+        uint32_t count;
+        union {
+            uint64_t offset;
+            double real;
+            long long integer;
+            bool boolean;
+        };
+    };
+    // a read-only view of a value in a snapshot, with accessors like JsonElement's
+    class JsonSnapshotElement {
+        const char* m_pbase;
+        const JsonSnapshotNode* m_pnode;
+        const JsonSnapshotNode* children() const {
+            return (const JsonSnapshotNode*)(m_pbase+m_pnode->offset);
+        }
+    public:
+        JsonSnapshotElement() : m_pbase(nullptr),m_pnode(nullptr) {
+        }
+        JsonSnapshotElement(const char* pbase,const JsonSnapshotNode* pnode) : m_pbase(pbase),m_pnode(pnode) {
+        }
+        int8_t type() const { return nullptr==m_pnode?JsonElement::Undefined:m_pnode->type; }
+        bool undefined() const { return JsonElement::Undefined==type(); }
+        double real() const {
+            switch(type()) {
+                case JsonElement::Real:
+                    return m_pnode->real;
+                case JsonElement::Integer:
+                    return (double)m_pnode->integer;
+            }
+            return NAN;
+        }
+        long long integer() const {
+            switch(type()) {
+                case JsonElement::Integer:
+                    return m_pnode->integer;
+                case JsonElement::Real:
+                    return (long long)m_pnode->real;
+            }
+            return 0;
+        }
+        bool boolean() const { return JsonElement::Boolean==type() && m_pnode->boolean; }
+        const char* string() const { return JsonElement::String==type()?m_pbase+m_pnode->offset:nullptr; }
+        // the number of elements, fields or string bytes
+        size_t size() const {
+            switch(type()) {
+                case JsonElement::String:
+                case JsonElement::Array:
+                case JsonElement::Object:
+                    return m_pnode->count;
+            }
+            return 0;
+        }
+        // gets an element of an array or the value of a field by position
+        JsonSnapshotElement operator[](size_t index) const {
+            if(index>=size())
+                return JsonSnapshotElement();
+            switch(type()) {
+                case JsonElement::Array:
+                    return JsonSnapshotElement(m_pbase,children()+index);
+                case JsonElement::Object:
+                    return JsonSnapshotElement(m_pbase,children()+index*2+1);
+            }
+            return JsonSnapshotElement();
+        }
+        JsonSnapshotElement operator[](const char* name) const {
+            if(nullptr==name || JsonElement::Object!=type())
+                return JsonSnapshotElement();
+            const JsonSnapshotNode* pn = children();
+            for(size_t i = 0;i<m_pnode->count;++i,pn+=2) {
+                if(0==strcmp(m_pbase+pn->offset,name))
+                    return JsonSnapshotElement(m_pbase,pn+1);
+            }
+            return JsonSnapshotElement();
+        }
+        // gets the name of a field by position
+        const char* name(size_t index) const {
+            if(JsonElement::Object!=type() || index>=m_pnode->count)
+                return nullptr;
+            return m_pbase+children()[index*2].offset;
+        }
+    };
+    // builds and loads position independent snapshots of parsed trees, so a document
+    // can be reloaded later by mapping the snapshot instead of parsing it again
+    class JsonSnapshot {
+        struct Builder {
+            char* pbase;
+            size_t nodes;
+            size_t strings;
+        };
+#ifndef ARDUINO
+        MappedFile m_file;
+#endif
+        const char* m_pdata;
+        size_t m_size;
+        JsonSnapshot(const JsonSnapshot& rhs)=delete;
+        JsonSnapshot& operator=(const JsonSnapshot& rhs)=delete;
+        static void measure(const JsonElement& value,size_t& nodes,size_t& strings) {
+            switch(value.type()) {
+                case JsonElement::String:
+                    strings+=strlen(value.string())+1;
+                    break;
+                case JsonElement::Array:
+                    for(JsonArrayEntry* pae = value.parray();nullptr!=pae;pae=pae->pnext) {
+                        ++nodes;
+                        measure(*pae->pvalue,nodes,strings);
+                    }
+                    break;
+                case JsonElement::Object:
+                    for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe;pfe=pfe->pnext) {
+                        nodes+=2;
+                        strings+=strlen(pfe->name)+1;
+                        measure(*pfe->pvalue,nodes,strings);
+                    }
+                    break;
+            }
+        }
+        static void writeString(Builder& b,JsonSnapshotNode* pnode,const char* sz) {
+            size_t c = strlen(sz);
+            pnode->type = JsonElement::String;
+            pnode->count = (uint32_t)c;
+            pnode->offset = b.strings;
+            memcpy(b.pbase+b.strings,sz,c+1);
+            b.strings+=c+1;
+        }
+        static void writeNode(Builder& b,JsonSnapshotNode* pnode,const JsonElement& value) {
+            memset(pnode,0,sizeof(JsonSnapshotNode));
+            pnode->type = value.type();
+            JsonSnapshotNode* pchildren;
+            switch(value.type()) {
+                case JsonElement::String:
+                    writeString(b,pnode,value.string());
+                    break;
+                case JsonElement::Real:
+                    pnode->real = value.real();
+                    break;
+                case JsonElement::Integer:
+                    pnode->integer = value.integer();
+                    break;
+                case JsonElement::Boolean:
+                    pnode->boolean = value.boolean();
+                    break;
+                case JsonElement::Array:
+                    for(JsonArrayEntry* pae = value.parray();nullptr!=pae;pae=pae->pnext)
+                        ++pnode->count;
+                    pnode->offset = b.nodes;
+                    // reserve the children before descending so they stay contiguous
+                    pchildren = (JsonSnapshotNode*)(b.pbase+b.nodes);
+                    b.nodes+=pnode->count*sizeof(JsonSnapshotNode);
+                    for(JsonArrayEntry* pae = value.parray();nullptr!=pae;pae=pae->pnext)
+                        writeNode(b,pchildren++,*pae->pvalue);
+                    break;
+                case JsonElement::Object:
+                    for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe;pfe=pfe->pnext)
+                        ++pnode->count;
+                    pnode->offset = b.nodes;
+                    pchildren = (JsonSnapshotNode*)(b.pbase+b.nodes);
+                    b.nodes+=pnode->count*2*sizeof(JsonSnapshotNode);
+                    for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe;pfe=pfe->pnext) {
+                        memset(pchildren,0,sizeof(JsonSnapshotNode));
+                        writeString(b,pchildren++,pfe->name);
+                        writeNode(b,pchildren++,*pfe->pvalue);
+                    }
+                    break;
+            }
+        }
+    public:
+        static const uint16_t Version = 2;
+        static uint32_t checksum(const void* data,size_t size) {
+            const uint8_t* p = (const uint8_t*)data;
+            uint32_t result = 2166136261UL;
+            while(size--) {
+                result^=*p++;
+                result*=16777619UL;
+            }
+            return result;
+        }
+        // the number of bytes a snapshot of the tree takes
+        static size_t size(const JsonElement& root) {
+            size_t nodes = 1;
+            size_t strings = 0;
+            measure(root,nodes,strings);
+            return sizeof(JsonSnapshotHeader)+nodes*sizeof(JsonSnapshotNode)+strings;
+        }
+        // writes a snapshot of the tree to a buffer of at least size(root) bytes
+        // the source is recorded so a stale snapshot can be detected
+        static bool build(const JsonElement& root,void* buffer,size_t bufferSize,const JsonSnapshotSource* psource=nullptr) {
+            size_t nodes = 1;
+            size_t strings = 0;
+            measure(root,nodes,strings);
+            size_t total = sizeof(JsonSnapshotHeader)+nodes*sizeof(JsonSnapshotNode)+strings;
+            if(nullptr==buffer || total>bufferSize)
+                return false;
+            Builder b;
+            b.pbase = (char*)buffer;
+            b.nodes = sizeof(JsonSnapshotHeader);
+            // strings go after all the nodes, which keeps the nodes aligned
+            b.strings = b.nodes+nodes*sizeof(JsonSnapshotNode);
+            JsonSnapshotHeader* ph = (JsonSnapshotHeader*)buffer;
+            memset(ph,0,sizeof(JsonSnapshotHeader));
+            memcpy(ph->magic,"JSNP",4);
+            ph->version = Version;
+            ph->byteOrder = 0x0102;
+            if(nullptr!=psource)
+                ph->source = *psource;
+            ph->root = b.nodes;
+            ph->size = total;
+            b.nodes+=sizeof(JsonSnapshotNode);
+            writeNode(b,(JsonSnapshotNode*)(b.pbase+ph->root),root);
+            ph->checksum = checksum(b.pbase+sizeof(JsonSnapshotHeader),total-sizeof(JsonSnapshotHeader));
+            return true;
+        }
+        // indicates whether the data is a complete snapshot this machine can read
+        // verifying the checksum touches every byte, so it can be skipped for speed
+        static bool validate(const void* data,size_t size,bool verifyChecksum=true) {
+            if(nullptr==data || sizeof(JsonSnapshotHeader)+sizeof(JsonSnapshotNode)>size)
+                return false;
+            const JsonSnapshotHeader* ph = (const JsonSnapshotHeader*)data;
+            if(0!=memcmp(ph->magic,"JSNP",4) || Version!=ph->version || 0x0102!=ph->byteOrder)
+                return false;
+            if(size!=ph->size || sizeof(JsonSnapshotHeader)>ph->root || size<ph->root+sizeof(JsonSnapshotNode))
+                return false;
+            return !verifyChecksum || ph->checksum==checksum((const char*)data+sizeof(JsonSnapshotHeader),size-sizeof(JsonSnapshotHeader));
+        }
+        JsonSnapshot() : m_pdata(nullptr),m_size(0) {
+        }
+        ~JsonSnapshot() {
+            close();
+        }
+        // uses a snapshot already in memory. the data must stay valid while it's in use
+        bool attach(const void* data,size_t size,bool verifyChecksum=true) {
+            close();
+            if(!validate(data,size,verifyChecksum))
+                return false;
+            m_pdata = (const char*)data;
+            m_size = size;
+            return true;
+        }
+        const JsonSnapshotHeader* header() const {
+            return (const JsonSnapshotHeader*)m_pdata;
+        }
+        // the root of the tree, or an undefined element if nothing is loaded
+        JsonSnapshotElement root() const {
+            if(nullptr==m_pdata)
+                return JsonSnapshotElement();
+            return JsonSnapshotElement(m_pdata,(const JsonSnapshotNode*)(m_pdata+header()->root));
+        }
+        void close() {
+            m_pdata = nullptr;
+            m_size = 0;
+#ifndef ARDUINO
+            m_file.close();
+#endif
+        }
+#ifndef ARDUINO
+        // gets what identifies the current version of a file
+        static bool fingerprint(const char* path,JsonSnapshotSource& source) {
+            struct stat st;
+            if(nullptr==path || 0!=stat(path,&st))
+                return false;
+            memset(&source,0,sizeof(source));
+            source.size = (uint64_t)st.st_size;
+            source.time = (int64_t)st.st_mtime;
+#if defined(__APPLE__)
+            source.timeNanoseconds = (int64_t)st.st_mtimespec.tv_nsec;
+#elif !defined(_WIN32)
+            source.timeNanoseconds = (int64_t)st.st_mtim.tv_nsec;
+#endif
+            source.device = (uint64_t)st.st_dev;
+            source.inode = (uint64_t)st.st_ino;
+            return true;
+        }
+        static bool same(const JsonSnapshotSource& lhs,const JsonSnapshotSource& rhs) {
+            return lhs.size==rhs.size && lhs.time==rhs.time && lhs.timeNanoseconds==rhs.timeNanoseconds &&
+                lhs.device==rhs.device && lhs.inode==rhs.inode;
+        }
+        // writes a snapshot of a tree to a file. the source is the fingerprint of the document
+        // taken before it was parsed, so a change made while parsing leaves the snapshot stale
+        static bool save(const char* path,const JsonElement& root,const JsonSnapshotSource& source) {
+            if(nullptr==path)
+                return false;
+            size_t c = size(root);
+            void* buffer = malloc(c);
+            if(nullptr==buffer)
+                return false;
+            bool result = false;
+            if(build(root,buffer,c,&source)) {
+                FILE* pfile = fopen(path,"wb");
+                if(nullptr!=pfile) {
+                    result = 1==fwrite(buffer,c,1,pfile);
+                    result = 0==fclose(pfile) && result;
+                }
+            }
+            free(buffer);
+            return result;
+        }
+        // maps a snapshot file. fails if it's damaged, was written by an incompatible
+        // machine or version, or if sourcePath is given and the document has changed
+        // since. a failure means the snapshot should be rebuilt
+        bool open(const char* path,const char* sourcePath=nullptr,bool verifyChecksum=true) {
+            close();
+            JsonSnapshotSource source;
+            if(nullptr!=sourcePath && !fingerprint(sourcePath,source))
+                return false;
+            if(nullptr==path || !m_file.open(path))
+                return false;
+            if(!validate(m_file.data(),m_file.size(),verifyChecksum)) {
+                m_file.close();
+                return false;
+            }
+            const JsonSnapshotHeader* ph = (const JsonSnapshotHeader*)m_file.data();
+            if(nullptr!=sourcePath && !same(ph->source,source)) {
+                m_file.close();
+                return false;
+            }
+            m_pdata = m_file.data();
+            m_size = m_file.size();
+            return true;
+        }
+#endif
+    };
+}
+#endif
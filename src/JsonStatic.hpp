@@ -0,0 +1,499 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONSTATIC_HPP
+#define HTCW_JSONSTATIC_HPP
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#include <math.h>
+#endif
+#include "ArduinoCommon.h"
+#include "JsonTree.hpp"
+// parsing at compile time needs C++14 constexpr. MSVC only reports it in _MSVC_LANG
+#if __cplusplus < 201402L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+#error "JsonStatic.hpp needs C++14 or later (-std=c++14)"
+#else
+// on AVR, JSON_STATIC documents live in flash and are read with pgm_read, so their
+// accessors can't be used in constant expressions there
+#if defined(ARDUINO) && defined(__AVR__)
+#include <avr/pgmspace.h>
+#define JSON_STATIC_FLASH
+#define JSON_STATIC_CONSTEXPR inline
+#else
+#define JSON_STATIC_CONSTEXPR constexpr
+#endif
+
+namespace json {
+    // a value in a static document. arrays index count consecutive nodes, objects index
+    // count consecutive pairs of nodes, name then value, and strings index the characters
+    struct JsonStaticNode {
+        int8_t type;
+        size_t count;
+        size_t index;
+        long long integer;
+        double real;
+        constexpr JsonStaticNode() : type(JsonElement::Undefined),count(0),index(0),integer(0),real(0) {
+        }
+    };
+    // the storage a static document needs
+    struct JsonStaticSize {
+        size_t nodes;
+        size_t chars;
+    };
+    // a read-only view of a value in a static document, with accessors like JsonElement's
+    class JsonStaticElement {
+        const JsonStaticNode* m_pnodes;
+        const char* m_pchars;
+        const JsonStaticNode* m_pnode;
+#ifdef JSON_STATIC_FLASH
+        static JsonStaticNode node(const JsonStaticNode* pnode) {
+            JsonStaticNode result;
+            memcpy_P(&result,pnode,sizeof(result));
+            return result;
+        }
+        static char at(const char* sz) { return (char)pgm_read_byte(sz); }
+#else
+        static constexpr JsonStaticNode node(const JsonStaticNode* pnode) { return *pnode; }
+        static constexpr char at(const char* sz) { return *sz; }
+#endif
+        // compares a name in the document with one in RAM
+        static JSON_STATIC_CONSTEXPR bool equals(const char* lhs,const char* rhs) {
+            while(0!=at(lhs) && at(lhs)==*rhs) {
+                ++lhs;
+                ++rhs;
+            }
+            return at(lhs)==*rhs;
+        }
+    public:
+        constexpr JsonStaticElement() : m_pnodes(nullptr),m_pchars(nullptr),m_pnode(nullptr) {
+        }
+        constexpr JsonStaticElement(const JsonStaticNode* pnodes,const char* pchars,const JsonStaticNode* pnode) : m_pnodes(pnodes),m_pchars(pchars),m_pnode(pnode) {
+        }
+        JSON_STATIC_CONSTEXPR int8_t type() const { return nullptr==m_pnode?JsonElement::Undefined:node(m_pnode).type; }
+        JSON_STATIC_CONSTEXPR bool undefined() const { return JsonElement::Undefined==type(); }
+        JSON_STATIC_CONSTEXPR double real() const {
+            return (JsonElement::Real==type())?node(m_pnode).real:
+                (JsonElement::Integer==type())?(double)node(m_pnode).integer:NAN;
+        }
+        JSON_STATIC_CONSTEXPR long long integer() const {
+            return (JsonElement::Integer==type())?node(m_pnode).integer:
+                (JsonElement::Real==type())?(long long)node(m_pnode).real:0;
+        }
+        JSON_STATIC_CONSTEXPR bool boolean() const { return JsonElement::Boolean==type() && 0!=node(m_pnode).integer; }
+        // on AVR the string is in flash, so read it with the _P functions
+        JSON_STATIC_CONSTEXPR const char* string() const { return JsonElement::String==type()?m_pchars+node(m_pnode).index:nullptr; }
+        // the number of elements, fields or string bytes
+        JSON_STATIC_CONSTEXPR size_t size() const {
+            return (JsonElement::String==type() || JsonElement::Array==type() || JsonElement::Object==type())?node(m_pnode).count:0;
+        }
+        // gets an element of an array or the value of a field by position
+        JSON_STATIC_CONSTEXPR JsonStaticElement operator[](size_t index) const {
+            return (index>=size())?JsonStaticElement():
+                (JsonElement::Array==type())?JsonStaticElement(m_pnodes,m_pchars,m_pnodes+node(m_pnode).index+index):
+                (JsonElement::Object==type())?JsonStaticElement(m_pnodes,m_pchars,m_pnodes+node(m_pnode).index+index*2+1):
+                JsonStaticElement();
+        }
+        // gets the value of a field by name. a template so that [0] only matches the index
+        template<typename TChar> JSON_STATIC_CONSTEXPR JsonStaticElement operator[](const TChar* name) const {
+            if(nullptr!=name && JsonElement::Object==type()) {
+                for(size_t i = 0;i<size();++i) {
+                    const JsonStaticNode* pn = m_pnodes+node(m_pnode).index+i*2;
+                    if(equals(m_pchars+node(pn).index,name))
+                        return JsonStaticElement(m_pnodes,m_pchars,pn+1);
+                }
+            }
+            return JsonStaticElement();
+        }
+        // gets the name of a field by position. on AVR the name is in flash
+        JSON_STATIC_CONSTEXPR const char* name(size_t index) const {
+            return (JsonElement::Object==type() && index<size())?m_pchars+node(m_pnodes+node(m_pnode).index+index*2).index:nullptr;
+        }
+    };
+    // a document parsed at compile time. declare it constexpr so it lands in read-only data
+    template<size_t TNodes,size_t TChars> struct JsonStaticDocument {
+        JsonStaticNode nodes[TNodes];
+        char chars[TChars];
+        constexpr JsonStaticDocument() : nodes(),chars() {
+        }
+        constexpr JsonStaticElement root() const {
+            return JsonStaticElement(nodes,chars,nodes);
+        }
+    };
+    // not constexpr, so reaching it while parsing at compile time fails the build
+    inline void jsonStaticError(const char* message) {
+        (void)message;
+    }
+    // parses JSON text into a static document. only used at compile time
+    class JsonStaticParser {
+        const char* m_sz;
+        size_t m_pos;
+        size_t m_node;
+        size_t m_char;
+        constexpr char current() const { return m_sz[m_pos]; }
+        constexpr void skipWhiteSpace() {
+            while(' '==current() || '\t'==current() || '\r'==current() || '\n'==current())
+                ++m_pos;
+        }
+        constexpr void expect(char ch) {
+            skipWhiteSpace();
+            if(ch!=current())
+                jsonStaticError("unexpected character");
+            ++m_pos;
+        }
+        static constexpr int hex(char ch) {
+            return ('0'<=ch && '9'>=ch)?ch-'0':
+                ('a'<=ch && 'f'>=ch)?ch-'a'+10:
+                ('A'<=ch && 'F'>=ch)?ch-'A'+10:-1;
+        }
+        constexpr unsigned long readHex4() {
+            unsigned long result = 0;
+            for(int i = 0;i<4;++i) {
+                int h = hex(current());
+                if(0>h)
+                    jsonStaticError("invalid escape");
+                result=result*16+h;
+                ++m_pos;
+            }
+            return result;
+        }
+        // skips a string, or measures it when pchars is non-null
+        constexpr void skipString(size_t* pchars) {
+            expect('\"');
+            size_t start = m_pos;
+            while('\"'!=current()) {
+                if(0==current())
+                    jsonStaticError("unterminated string");
+                if('\\'==current())
+                    ++m_pos;
+                ++m_pos;
+            }
+            // escapes never decode to more bytes than they take up
+            if(nullptr!=pchars)
+                *pchars+=m_pos-start+1;
+            ++m_pos;
+        }
+        // skips a value, counting the nodes and characters it needs
+        constexpr void measureValue(JsonStaticSize& size) {
+            ++size.nodes;
+            skipWhiteSpace();
+            switch(current()) {
+                case '{':
+                    ++m_pos;
+                    skipWhiteSpace();
+                    if('}'==current()) {
+                        ++m_pos;
+                        return;
+                    }
+                    while(true) {
+                        ++size.nodes;
+                        skipString(&size.chars);
+                        expect(':');
+                        measureValue(size);
+                        skipWhiteSpace();
+                        if('}'==current())
+                            break;
+                        expect(',');
+                    }
+                    ++m_pos;
+                    return;
+                case '[':
+                    ++m_pos;
+                    skipWhiteSpace();
+                    if(']'==current()) {
+                        ++m_pos;
+                        return;
+                    }
+                    while(true) {
+                        measureValue(size);
+                        skipWhiteSpace();
+                        if(']'==current())
+                            break;
+                        expect(',');
+                    }
+                    ++m_pos;
+                    return;
+                case '\"':
+                    skipString(&size.chars);
+                    return;
+            }
+            while(0!=current() && ','!=current() && '}'!=current() && ']'!=current() &&
+                    ' '!=current() && '\t'!=current() && '\r'!=current() && '\n'!=current())
+                ++m_pos;
+        }
+        // counts the elements or fields of the container under the cursor without moving it
+        constexpr size_t countChildren() {
+            JsonStaticSize size = {0,0};
+            size_t pos = m_pos;
+            bool object = '{'==current();
+            ++m_pos;
+            skipWhiteSpace();
+            size_t result = 0;
+            if((object?'}':']')!=current()) {
+                while(true) {
+                    ++result;
+                    if(object) {
+                        skipString(nullptr);
+                        expect(':');
+                    }
+                    measureValue(size);
+                    skipWhiteSpace();
+                    if((object?'}':']')==current())
+                        break;
+                    expect(',');
+                }
+            }
+            m_pos = pos;
+            return result;
+        }
+        template<size_t TNodes,size_t TChars> constexpr void putChar(JsonStaticDocument<TNodes,TChars>& doc,unsigned long ch) {
+            if(0x80>ch) {
+                doc.chars[m_char++]=(char)ch;
+            } else if(0x800>ch) {
+                doc.chars[m_char++]=(char)(0xc0|(ch>>6));
+                doc.chars[m_char++]=(char)(0x80|(ch&0x3f));
+            } else if(0x10000>ch) {
+                doc.chars[m_char++]=(char)(0xe0|(ch>>12));
+                doc.chars[m_char++]=(char)(0x80|((ch>>6)&0x3f));
+                doc.chars[m_char++]=(char)(0x80|(ch&0x3f));
+            } else {
+                doc.chars[m_char++]=(char)(0xf0|(ch>>18));
+                doc.chars[m_char++]=(char)(0x80|((ch>>12)&0x3f));
+                doc.chars[m_char++]=(char)(0x80|((ch>>6)&0x3f));
+                doc.chars[m_char++]=(char)(0x80|(ch&0x3f));
+            }
+        }
+        template<size_t TNodes,size_t TChars> constexpr void parseString(JsonStaticDocument<TNodes,TChars>& doc,JsonStaticNode& node) {
+            expect('\"');
+            node.type = JsonElement::String;
+            node.index = m_char;
+            while('\"'!=current()) {
+                char ch = current();
+                if(0==ch)
+                    jsonStaticError("unterminated string");
+                ++m_pos;
+                if('\\'!=ch) {
+                    doc.chars[m_char++]=ch;
+                    continue;
+                }
+                ch = current();
+                ++m_pos;
+                switch(ch) {
+                    case 'b':
+                        doc.chars[m_char++]='\b';
+                        break;
+                    case 'f':
+                        doc.chars[m_char++]='\f';
+                        break;
+                    case 'n':
+                        doc.chars[m_char++]='\n';
+                        break;
+                    case 'r':
+                        doc.chars[m_char++]='\r';
+                        break;
+                    case 't':
+                        doc.chars[m_char++]='\t';
+                        break;
+                    case 'u': {
+                        unsigned long cp = readHex4();
+                        if(0xd800<=cp && 0xdbff>=cp && '\\'==current() && 'u'==m_sz[m_pos+1]) {
+                            m_pos+=2;
+                            unsigned long lo = readHex4();
+                            cp = 0x10000+((cp-0xd800)<<10)+(lo-0xdc00);
+                        }
+                        putChar(doc,cp);
+                        break;
+                    }
+                    default:
+                        doc.chars[m_char++]=ch;
+                        break;
+                }
+            }
+            ++m_pos;
+            node.count = m_char-node.index;
+            doc.chars[m_char++]=0;
+        }
+        static constexpr double pow10(int exp) {
+            double result = 1;
+            double base = 10;
+            for(int e = (0>exp)?-exp:exp;0!=e;e>>=1) {
+                if(e&1)
+                    result*=base;
+                base*=base;
+            }
+            return result;
+        }
+        constexpr bool match(const char* literal) {
+            size_t i = 0;
+            while(0!=literal[i]) {
+                if(literal[i]!=m_sz[m_pos+i])
+                    return false;
+                ++i;
+            }
+            m_pos+=i;
+            return true;
+        }
+        constexpr void parseNumber(JsonStaticNode& node) {
+            bool neg = '-'==current();
+            if(neg)
+                ++m_pos;
+            if('0'>current() || '9'<current())
+                jsonStaticError("invalid value");
+            // no leading zeroes
+            if('0'==current() && '0'<=m_sz[m_pos+1] && '9'>=m_sz[m_pos+1])
+                jsonStaticError("invalid value");
+            unsigned long long mantissa = 0;
+            int digits = 0;
+            int exp = 0;
+            bool real = false;
+            while('0'<=current() && '9'>=current()) {
+                // digits past what the mantissa holds only scale it
+                if(19>digits) {
+                    mantissa = mantissa*10+(current()-'0');
+                    if(0!=mantissa)
+                        ++digits;
+                } else {
+                    ++exp;
+                    real = true;
+                }
+                ++m_pos;
+            }
+            if('.'==current()) {
+                real = true;
+                ++m_pos;
+                if('0'>current() || '9'<current())
+                    jsonStaticError("invalid value");
+                while('0'<=current() && '9'>=current()) {
+                    if(19>digits) {
+                        mantissa = mantissa*10+(current()-'0');
+                        if(0!=mantissa)
+                            ++digits;
+                        --exp;
+                    }
+                    ++m_pos;
+                }
+            }
+            if('e'==current() || 'E'==current()) {
+                real = true;
+                ++m_pos;
+                bool eneg = '-'==current();
+                if('-'==current() || '+'==current())
+                    ++m_pos;
+                if('0'>current() || '9'<current())
+                    jsonStaticError("invalid value");
+                int e = 0;
+                while('0'<=current() && '9'>=current()) {
+                    e = e*10+(current()-'0');
+                    ++m_pos;
+                }
+                exp+=eneg?-e:e;
+            }
+            if(!real && (unsigned long long)9223372036854775807ULL+(neg?1:0)>=mantissa) {
+                node.type = JsonElement::Integer;
+                node.integer = neg?(long long)(0-mantissa):(long long)mantissa;
+                node.real = (double)node.integer;
+                return;
+            }
+            double d = (double)mantissa;
+            // a single multiply or divide by an exact power of ten keeps common values exact
+            d = (0>exp)?d/pow10(exp):d*pow10(exp);
+            node.type = JsonElement::Real;
+            node.real = neg?-d:d;
+            if(-9.2e18<node.real && 9.2e18>node.real)
+                node.integer = (long long)node.real;
+        }
+        // a number or literal has to be followed by the end of the value, so 12abc is invalid
+        constexpr void endScalar() {
+            char ch = current();
+            if(0!=ch && ','!=ch && '}'!=ch && ']'!=ch && ' '!=ch && '\t'!=ch && '\r'!=ch && '\n'!=ch)
+                jsonStaticError("invalid value");
+        }
+        template<size_t TNodes,size_t TChars> constexpr void parseValue(JsonStaticDocument<TNodes,TChars>& doc,size_t index) {
+            skipWhiteSpace();
+            JsonStaticNode& node = doc.nodes[index];
+            switch(current()) {
+                case '{':
+                case '[': {
+                    bool object = '{'==current();
+                    node.type = object?JsonElement::Object:JsonElement::Array;
+                    node.count = countChildren();
+                    // reserve the children before descending so they stay contiguous
+                    node.index = m_node;
+                    m_node+=object?node.count*2:node.count;
+                    size_t child = node.index;
+                    ++m_pos;
+                    for(size_t i = 0;i<node.count;++i) {
+                        if(0<i)
+                            expect(',');
+                        if(object) {
+                            skipWhiteSpace();
+                            parseString(doc,doc.nodes[child++]);
+                            expect(':');
+                        }
+                        parseValue(doc,child++);
+                    }
+                    expect(object?'}':']');
+                    return;
+                }
+                case '\"':
+                    parseString(doc,node);
+                    return;
+                case 't':
+                    if(!match("true"))
+                        break;
+                    node.type = JsonElement::Boolean;
+                    node.integer = 1;
+                    endScalar();
+                    return;
+                case 'f':
+                    if(!match("false"))
+                        break;
+                    node.type = JsonElement::Boolean;
+                    endScalar();
+                    return;
+                case 'n':
+                    if(!match("null"))
+                        break;
+                    node.type = JsonElement::Null;
+                    endScalar();
+                    return;
+                default:
+                    parseNumber(node);
+                    endScalar();
+                    return;
+            }
+            jsonStaticError("invalid value");
+        }
+    public:
+        constexpr JsonStaticParser(const char* sz) : m_sz(sz),m_pos(0),m_node(1),m_char(0) {
+        }
+        // gets the storage the document needs
+        static constexpr JsonStaticSize measure(const char* sz) {
+            JsonStaticParser parser(sz);
+            JsonStaticSize result = {0,0};
+            parser.measureValue(result);
+            parser.skipWhiteSpace();
+            if(0!=parser.current())
+                jsonStaticError("unexpected character");
+            return result;
+        }
+        template<size_t TNodes,size_t TChars> static constexpr JsonStaticDocument<TNodes,TChars> parse(const char* sz) {
+            JsonStaticDocument<TNodes,TChars> result;
+            JsonStaticParser parser(sz);
+            parser.parseValue(result,0);
+            return result;
+        }
+    };
+}
+// declares a document parsed from a JSON string literal at compile time, such as
+// JSON_STATIC(defaults,"{\"volume\":11}"); then defaults.root()["volume"].integer()
+// on AVR it's put in flash rather than copied to RAM at startup
+#define JSON_STATIC(name,text) \
+    constexpr ::json::JsonStaticDocument< \
+        ::json::JsonStaticParser::measure(text).nodes, \
+        ::json::JsonStaticParser::measure(text).chars+1> \
+        name PROGMEM = ::json::JsonStaticParser::parse< \
+            ::json::JsonStaticParser::measure(text).nodes, \
+            ::json::JsonStaticParser::measure(text).chars+1>(text)
+#endif
+#endif
@@ -0,0 +1,393 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONSTRUCTURE_HPP
+#define HTCW_JSONSTRUCTURE_HPP
+// there are no threads to run this on without an OS
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <new>
+#include "JsonParallel.hpp"
+// the number of elements a worker takes at a time in JsonStructure::run()
+#ifndef JSON_STRUCTURE_BATCH
+#define JSON_STRUCTURE_BATCH 16
+#endif
+
+namespace json {
+    // an index of the structure of one JSON document in memory: the offsets of the braces,
+    // brackets, colons and commas outside of strings, with how deeply each is nested. it's
+    // built in parallel by splitting the document into a chunk per worker. no chunk knows
+    // whether it starts inside a string, so each is scanned as though it doesn't, keeping
+    // what it finds inside strings as well. once the quotes before each chunk are counted,
+    // the half that was really outside of strings is kept
+    class JsonStructure {
+        // the candidates one chunk found, and what it learned about itself
+        struct Chunk {
+            const char* start;
+            const char* end;
+            uint64_t* pcandidates;
+            size_t count;
+            size_t capacity;
+            // whether an odd number of unescaped quotes is in the chunk
+            bool quotes;
+            // whether the chunk really starts inside of a string
+            bool inString;
+            // the depth at the end of the chunk relative to its start
+            int32_t delta;
+            // the kept entries, and the depth at the start of the chunk
+            size_t kept;
+            size_t first;
+            int32_t depth;
+        };
+        // candidates found inside of strings, if the chunk started outside of one, are marked
+        // with the top bit
+        static const uint64_t InString = ((uint64_t)1)<<63;
+        const char* m_data;
+        size_t m_dataSize;
+        uint64_t* m_positions;
+        int32_t* m_depths;
+        size_t m_size;
+        JsonStructure(const JsonStructure& rhs)=delete;
+        JsonStructure& operator=(const JsonStructure& rhs)=delete;
+        static bool add(Chunk& chunk,uint64_t candidate) {
+            if(chunk.count==chunk.capacity) {
+                size_t capacity = (0==chunk.capacity)?1024:chunk.capacity*2;
+                uint64_t* p = (uint64_t*)realloc(chunk.pcandidates,capacity*sizeof(uint64_t));
+                if(nullptr==p)
+                    return false;
+                chunk.pcandidates = p;
+                chunk.capacity = capacity;
+            }
+            chunk.pcandidates[chunk.count++] = candidate;
+            return true;
+        }
+        // the first pass, which finds the candidates and counts the quotes
+        bool scan(Chunk& chunk) const {
+            // escapes are tracked whether or not we're in a string, so the scan is the same
+            // either way except for which side of each quote is the string
+            bool escaped = false;
+            for(const char* sz = chunk.start;sz>m_data && '\\'==sz[-1];--sz)
+                escaped = !escaped;
+            bool inString = false;
+            for(const char* sz = chunk.start;sz<chunk.end;++sz) {
+                if(escaped) {
+                    escaped = false;
+                    continue;
+                }
+                switch(*sz) {
+                    case '\\':
+                        escaped = true;
+                        break;
+                    case '\"':
+                        inString = !inString;
+                        break;
+                    case '{':
+                    case '}':
+                    case '[':
+                    case ']':
+                    case ':':
+                    case ',':
+                        if(!add(chunk,(uint64_t)(sz-m_data)|(inString?InString:0)))
+                            return false;
+                        break;
+                }
+            }
+            chunk.quotes = inString;
+            return true;
+        }
+        // the second pass, which keeps the real entries and works out their relative depths
+        void keep(Chunk& chunk) const {
+            uint64_t mark = chunk.inString?InString:0;
+            int32_t depth = 0;
+            size_t kept = 0;
+            for(size_t i = 0;i<chunk.count;++i) {
+                uint64_t candidate = chunk.pcandidates[i];
+                if(mark!=(candidate&InString))
+                    continue;
+                candidate&=~InString;
+                switch(m_data[candidate]) {
+                    case '}':
+                    case ']':
+                        --depth;
+                        break;
+                }
+                chunk.pcandidates[kept++] = candidate;
+                switch(m_data[candidate]) {
+                    case '{':
+                    case '[':
+                        ++depth;
+                        break;
+                }
+            }
+            chunk.kept = kept;
+            chunk.delta = depth;
+        }
+        // the last pass, which writes the entries with their final depths
+        void write(const Chunk& chunk) {
+            int32_t depth = chunk.depth;
+            for(size_t i = 0;i<chunk.kept;++i) {
+                uint64_t position = chunk.pcandidates[i];
+                char ch = m_data[position];
+                if('}'==ch || ']'==ch)
+                    --depth;
+                m_positions[chunk.first+i] = position;
+                m_depths[chunk.first+i] = depth;
+                if('{'==ch || '['==ch)
+                    ++depth;
+            }
+        }
+        template<typename TFunc> static void parallel(size_t count,TFunc func) {
+            std::thread threads[JSON_PARALLEL_MAX_WORKERS-1];
+            for(size_t i = 1;i<count;++i)
+                threads[i-1] = std::thread(func,i);
+            func(0);
+            for(size_t i = 1;i<count;++i)
+                threads[i-1].join();
+        }
+    public:
+        JsonStructure() : m_data(nullptr),m_dataSize(0),m_positions(nullptr),m_depths(nullptr),m_size(0) {
+        }
+        ~JsonStructure() {
+            clear();
+        }
+        // indexes the document with the specified number of threads. the document must stay
+        // valid while the index is used. returns false if out of memory
+        bool build(const char* data,size_t size,size_t workers) {
+            clear();
+            if(nullptr==data)
+                return false;
+            if(0==workers)
+                workers = 1;
+            if(workers>JSON_PARALLEL_MAX_WORKERS)
+                workers = JSON_PARALLEL_MAX_WORKERS;
+            // tiny chunks aren't worth a thread
+            if(size<workers*4096)
+                workers = size/4096+1;
+            m_data = data;
+            m_dataSize = size;
+            Chunk chunks[JSON_PARALLEL_MAX_WORKERS];
+            memset(chunks,0,sizeof(chunks));
+            for(size_t i = 0;i<workers;++i) {
+                chunks[i].start = data+size*i/workers;
+                chunks[i].end = data+size*(i+1)/workers;
+            }
+            std::atomic<bool> failed(false);
+            parallel(workers,[&](size_t i) {
+                if(!scan(chunks[i]))
+                    failed = true;
+            });
+            bool result = !failed;
+            if(result) {
+                // now we know which chunks start inside of strings
+                bool inString = false;
+                for(size_t i = 0;i<workers;++i) {
+                    chunks[i].inString = inString;
+                    inString = inString!=chunks[i].quotes;
+                }
+                parallel(workers,[&](size_t i) {
+                    keep(chunks[i]);
+                });
+                // and where each chunk's entries go, at what depth
+                size_t first = 0;
+                int32_t depth = 0;
+                for(size_t i = 0;i<workers;++i) {
+                    chunks[i].first = first;
+                    chunks[i].depth = depth;
+                    first+=chunks[i].kept;
+                    depth+=chunks[i].delta;
+                }
+                m_positions = (uint64_t*)malloc((0==first?1:first)*sizeof(uint64_t));
+                m_depths = (int32_t*)malloc((0==first?1:first)*sizeof(int32_t));
+                result = nullptr!=m_positions && nullptr!=m_depths;
+                if(result) {
+                    m_size = first;
+                    parallel(workers,[&](size_t i) {
+                        write(chunks[i]);
+                    });
+                }
+            }
+            for(size_t i = 0;i<workers;++i)
+                free(chunks[i].pcandidates);
+            if(!result)
+                clear();
+            return result;
+        }
+        void clear() {
+            free(m_positions);
+            free(m_depths);
+            m_positions = nullptr;
+            m_depths = nullptr;
+            m_size = 0;
+            m_data = nullptr;
+            m_dataSize = 0;
+        }
+        // indicates the number of entries
+        size_t size() const { return m_size; }
+        // the offset of the entry into the document
+        uint64_t position(size_t index) const { return m_positions[index]; }
+        // the character of the entry
+        char at(size_t index) const { return m_data[m_positions[index]]; }
+        // the number of objects and arrays around the entry. an opening or closing brace or
+        // bracket isn't inside its own object or array
+        int32_t depth(size_t index) const { return m_depths[index]; }
+        // finds the entry that closes the object or array opened at index. returns size() if
+        // there isn't one
+        size_t close(size_t index) const {
+            if(index>=m_size)
+                return m_size;
+            int32_t d = m_depths[index];
+            for(size_t i = index+1;i<m_size;++i) {
+                if(d==m_depths[i])
+                    return ('}'==at(i) || ']'==at(i))?i:m_size;
+            }
+            return m_size;
+        }
+        // finds the entry that opens the object or array value of the named field of the object
+        // opened at index. names with escapes in the document aren't matched. returns size()
+        // if there's no such field or its value isn't an object or array
+        size_t value(size_t index,const char* name) const {
+            if(index>=m_size || '{'!=at(index) || nullptr==name)
+                return m_size;
+            int32_t d = m_depths[index]+1;
+            size_t len = strlen(name);
+            for(size_t i = index+1;i<m_size && d<=m_depths[i];++i) {
+                if(d!=m_depths[i] || ':'!=at(i))
+                    continue;
+                // back up over the whitespace and the name before the colon
+                const char* sz = m_data+m_positions[i];
+                while(sz>m_data && ('\"'!=sz[-1]))
+                    --sz;
+                const char* pend = sz-1;
+                if(pend<m_data+len+1 || '\"'!=pend[-(ptrdiff_t)len-1] || 0!=memcmp(pend-len,name,len))
+                    continue;
+                if(i+1<m_size && m_depths[i+1]==d) {
+                    char ch = at(i+1);
+                    if('{'==ch || '['==ch)
+                        return i+1;
+                }
+                return m_size;
+            }
+            return m_size;
+        }
+        // indicates the number of elements in the array opened at index
+        size_t elements(size_t index) const {
+            size_t end = close(index);
+            if(end==m_size || '['!=at(index))
+                return 0;
+            // empty arrays have nothing but whitespace between the brackets
+            const char* sz = m_data+m_positions[index]+1;
+            while(sz<m_data+m_positions[end] && (' '==*sz || '\t'==*sz || '\r'==*sz || '\n'==*sz))
+                ++sz;
+            if(sz==m_data+m_positions[end])
+                return 0;
+            size_t result = 1;
+            int32_t d = m_depths[index]+1;
+            for(size_t i = index+1;i<end;++i) {
+                if(d==m_depths[i] && ','==at(i))
+                    ++result;
+            }
+            return result;
+        }
+        // runs the workers over the elements of the array opened at index, one thread each
+        // with the first on the calling thread. each element is handed to a worker as a record
+        // in a chunk of its own, numbered by its index in the array. returns false if the
+        // array isn't there, memory runs out, or a worker stopped the run
+        template<size_t TCapacity> bool run(size_t index,JsonRecordWorker** workers,size_t workerCount) {
+            if(nullptr==workers)
+                return false;
+            return each<TCapacity>(index,workerCount,[&](size_t worker,size_t element,JsonReader& reader) {
+                JsonRecordWorker& rw = *workers[worker];
+                return rw.beginChunk(element) &&
+                    (!reader.nextRecord() || rw.record(reader,element)) &&
+                    rw.endChunk(element);
+            });
+        }
+        // parses the array opened at index into pelem, parsing its elements on a thread per
+        // pool in pools, with the first on the calling thread. the array and its entries come
+        // from pool, which may also be the first of pools, and each element comes from the
+        // pool of the thread that parsed it, so all of them must outlive the result. returns
+        // false if the array isn't there, an element is empty or malformed, or memory runs out
+        template<size_t TCapacity> bool parse(size_t index,MemoryPool& pool,MemoryPool** pools,size_t poolCount,JsonElement* pelem) {
+            if(nullptr==pelem || nullptr==pools || 0==poolCount || index>=m_size || '['!=at(index))
+                return false;
+            size_t count = elements(index);
+            JsonArrayEntry* pentries = nullptr;
+            JsonElement* pelems = nullptr;
+            if(0<count) {
+                // lay out the entries and their elements ahead of time, in order, so each
+                // thread only has to fill in its own
+                pentries = (JsonArrayEntry*)pool.alloc(count*sizeof(JsonArrayEntry));
+                pelems = (JsonElement*)pool.alloc(count*sizeof(JsonElement));
+                if(nullptr==pentries || nullptr==pelems)
+                    return false;
+                for(size_t i = 0;i<count;++i) {
+                    new(pelems+i) JsonElement();
+                    pentries[i].pvalue = pelems+i;
+                    pentries[i].pnext = (i+1<count)?pentries+i+1:nullptr;
+                }
+                if(!each<TCapacity>(index,poolCount,[&](size_t worker,size_t element,JsonReader& reader) {
+                    return reader.nextRecord() && reader.parseSubtree(*pools[worker],pelems+element);
+                }))
+                    return false;
+            }
+            JsonElement e;
+            e.parray(pentries);
+            *pelem = e;
+            return true;
+        }
+    private:
+        // calls func(worker,element,reader) for each element of the array opened at index,
+        // with the reader ready at the start of the element
+        template<size_t TCapacity,typename TFunc> bool each(size_t index,size_t workerCount,TFunc func) const {
+            size_t end = close(index);
+            if(end==m_size || '['!=at(index) || 0==workerCount)
+                return false;
+            if(workerCount>JSON_PARALLEL_MAX_WORKERS)
+                workerCount = JSON_PARALLEL_MAX_WORKERS;
+            // the entries that end each element
+            size_t count = elements(index);
+            size_t* pends = (size_t*)malloc((count+1)*sizeof(size_t));
+            if(nullptr==pends)
+                return false;
+            // the entry before each element is at 0, so element i is between i and i+1
+            pends[0] = index;
+            size_t c = 1;
+            int32_t d = m_depths[index]+1;
+            for(size_t i = index+1;i<end;++i) {
+                if(d==m_depths[i] && ','==at(i))
+                    pends[c++] = i;
+            }
+            pends[count] = end;
+            std::atomic<size_t> next(0);
+            std::atomic<bool> stop(false);
+            parallel(workerCount,[&](size_t worker) {
+                lex::StaticSpanLexSource<TCapacity> source;
+                JsonReader reader(source);
+                while(!stop) {
+                    size_t first = next.fetch_add(JSON_STRUCTURE_BATCH);
+                    if(first>=count)
+                        break;
+                    size_t last = (first+JSON_STRUCTURE_BATCH<count)?first+JSON_STRUCTURE_BATCH:count;
+                    for(size_t i = first;i<last && !stop;++i) {
+                        uint64_t start = m_positions[pends[i]]+1;
+                        source.detach();
+                        source.attach(m_data+start,(size_t)(m_positions[pends[i+1]]-start));
+                        reader.reset();
+                        if(!func(worker,i,reader))
+                            stop = true;
+                    }
+                }
+                source.detach();
+            });
+            free(pends);
+            return !stop;
+        }
+    };
+}
+#endif
+#endif
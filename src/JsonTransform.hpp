@@ -0,0 +1,210 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONTRANSFORM_HPP
+#define HTCW_JSONTRANSFORM_HPP
+#ifndef ARDUINO
+#include <cinttypes>
+#include <string.h>
+#endif
+#include "MemoryPool.hpp"
+#include "JsonReader.hpp"
+#include "JsonWriter.hpp"
+
+namespace json {
+    // describes one rewrite applied by a JsonTransform
+    struct JsonTransformRule {
+        // removes the field or element
+        static const int8_t Drop = 0;
+        // renames the field
+        static const int8_t Rename = 1;
+        // replaces the value
+        static const int8_t Replace = 2;
+        // the location, as dot separated field names from the root, optionally starting with "$."
+        // "*" matches any field or element and a number matches an array index
+        const char* path;
+        int8_t action;
+        // the new field name for Rename
+        const char* name;
+        // the new value for Replace
+        const JsonElement* pvalue;
+        JsonTransformRule(const char* path) : path(path),action(Drop),name(nullptr),pvalue(nullptr) {
+        }
+        JsonTransformRule(const char* path,const char* name) : path(path),action(Rename),name(name),pvalue(nullptr) {
+        }
+        JsonTransformRule(const char* path,const JsonElement& value) : path(path),action(Replace),name(nullptr),pvalue(&value) {
+        }
+    };
+    // streams a document from a reader to a writer, applying the rules along the way.
+    // subtrees no rule can reach are handed to JsonWriter::copySubtree() so a text
+    // writer copies them byte for byte instead of lexing them.
+    class JsonTransform {
+        const JsonTransformRule* m_prules;
+        size_t m_count;
+        JsonTransform(const JsonTransform& rhs)=delete;
+        JsonTransform& operator=(const JsonTransform& rhs)=delete;
+        // matches the path segment at pcursor against a field name, or an index when name is null
+        // returns the cursor for the next segment or null if it doesn't match
+        static const char* matchSegment(const char* pcursor,const char* name,unsigned long int index) {
+            const char* pend = strchr(pcursor,'.');
+            if(nullptr==pend)
+                pend = pcursor+strlen(pcursor);
+            size_t c = pend-pcursor;
+            bool match;
+            if(1==c && '*'==*pcursor) {
+                match = true;
+            } else if(nullptr!=name) {
+                match = 0==strncmp(pcursor,name,c) && 0==name[c];
+            } else {
+                unsigned long int i = 0;
+                const char* sz = pcursor;
+                while(sz<pend && '0'<=*sz && '9'>=*sz) {
+                    i=i*10+(*sz-'0');
+                    ++sz;
+                }
+                match = 0<c && sz==pend && i==index;
+            }
+            if(!match)
+                return nullptr;
+            return ('.'==*pend)?pend+1:pend;
+        }
+        // computes each rule's cursor for a child node
+        // returns the first rule that ends at the child, if any
+        const JsonTransformRule* descend(const char** pcursors,const char** pchild,const char* name,unsigned long int index) const {
+            const JsonTransformRule* result = nullptr;
+            for(size_t i = 0;i<m_count;++i) {
+                const char* pc = pcursors[i];
+                pchild[i] = (nullptr==pc || 0==*pc)?nullptr:matchSegment(pc,name,index);
+                if(nullptr==result && nullptr!=pchild[i] && 0==*pchild[i])
+                    result = m_prules+i;
+            }
+            return result;
+        }
+        // indicates whether any rule can still match below this level
+        bool alive(const char** pcursors) const {
+            for(size_t i = 0;i<m_count;++i) {
+                if(nullptr!=pcursors[i] && 0!=*pcursors[i])
+                    return true;
+            }
+            return false;
+        }
+        static bool skip(JsonReader& reader) {
+            return reader.skipSubtree() || !reader.hasError();
+        }
+        bool transformNode(MemoryPool& pool,JsonReader& reader,JsonWriter& writer,const char** pcursors) {
+            if(alive(pcursors)) {
+                switch(reader.nodeType()) {
+                    case JsonReader::Object:
+                    case JsonReader::Array:
+                        return transformContainer(pool,reader,writer,pcursors);
+                }
+            }
+            return writer.copySubtree(reader);
+        }
+        bool transformContainer(MemoryPool& pool,JsonReader& reader,JsonWriter& writer,const char** pcursors) {
+            size_t size = m_count*sizeof(const char*);
+            const char** pchild = (const char**)pool.alloc(size);
+            if(nullptr==pchild)
+                return false;
+            bool result = (JsonReader::Object==reader.nodeType())?
+                transformFields(pool,reader,writer,pcursors,pchild):
+                transformElements(pool,reader,writer,pcursors,pchild);
+            pool.unalloc(size);
+            return result;
+        }
+        bool transformFields(MemoryPool& pool,JsonReader& reader,JsonWriter& writer,const char** pcursors,const char** pchild) {
+            if(!writer.beginObject() || !reader.read())
+                return false;
+            while(JsonReader::Field==reader.nodeType()) {
+                const char* name = reader.value();
+                const JsonTransformRule* prule = descend(pcursors,pchild,name,0);
+                if(nullptr!=prule) {
+                    switch(prule->action) {
+                        case JsonTransformRule::Drop:
+                            if(!skip(reader))
+                                return false;
+                            continue;
+                        case JsonTransformRule::Replace:
+                            if(!writer.field(name) || !writer.element(*prule->pvalue) || !skip(reader))
+                                return false;
+                            continue;
+                        case JsonTransformRule::Rename:
+                            name = prule->name;
+                            break;
+                    }
+                }
+                if(!writer.field(name))
+                    return false;
+                if(alive(pchild)) {
+                    if(!reader.read() || !transformNode(pool,reader,writer,pchild))
+                        return false;
+                } else if(!writer.copySubtree(reader))
+                    return false;
+            }
+            if(JsonReader::EndObject!=reader.nodeType() || !writer.endObject())
+                return false;
+            return reader.read() || !reader.hasError();
+        }
+        bool transformElements(MemoryPool& pool,JsonReader& reader,JsonWriter& writer,const char** pcursors,const char** pchild) {
+            if(!writer.beginArray() || !reader.read())
+                return false;
+            unsigned long int index = 0;
+            while(JsonReader::EndArray!=reader.nodeType()) {
+                if(JsonReader::EndDocument==reader.nodeType() || reader.hasError())
+                    return false;
+                const JsonTransformRule* prule = descend(pcursors,pchild,nullptr,index++);
+                // elements have no names, so renames don't apply
+                if(nullptr!=prule && JsonTransformRule::Rename!=prule->action) {
+                    if(JsonTransformRule::Replace==prule->action && !writer.element(*prule->pvalue))
+                        return false;
+                    if(!skip(reader))
+                        return false;
+                    continue;
+                }
+                if(!transformNode(pool,reader,writer,pchild))
+                    return false;
+            }
+            if(!writer.endArray())
+                return false;
+            return reader.read() || !reader.hasError();
+        }
+    public:
+        JsonTransform(const JsonTransformRule* prules,size_t count) : m_prules(prules),m_count(count) {
+        }
+        // transforms the value under the reader's cursor, leaving the reader on the node after it.
+        // call it again to transform the next record of a JSON lines stream.
+        // the pool holds the path cursors while the value is walked and is restored after
+        bool transform(MemoryPool& pool,JsonReader& reader,JsonWriter& writer) {
+            if(JsonReader::Initial==reader.nodeType() && !reader.read())
+                return false;
+            switch(reader.nodeType()) {
+                case JsonReader::Error:
+                case JsonReader::EndDocument:
+                    return false;
+            }
+            size_t size = m_count*sizeof(const char*);
+            const char** proot = (const char**)pool.alloc(size);
+            if(nullptr==proot && 0<size)
+                return false;
+            const JsonTransformRule* prule = nullptr;
+            for(size_t i = 0;i<m_count;++i) {
+                const char* sz = m_prules[i].path;
+                if('$'==*sz)
+                    ++sz;
+                if('.'==*sz)
+                    ++sz;
+                proot[i]=sz;
+                if(nullptr==prule && 0==*sz)
+                    prule = m_prules+i;
+            }
+            bool result;
+            if(nullptr!=prule && JsonTransformRule::Rename!=prule->action) {
+                result = (JsonTransformRule::Replace!=prule->action || writer.element(*prule->pvalue)) && skip(reader);
+            } else
+                result = transformNode(pool,reader,writer,proot);
+            pool.unalloc(size);
+            return result;
+        }
+    };
+}
+#endif
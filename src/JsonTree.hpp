@@ -15,6 +15,10 @@
 // for memory management
 #include "MemoryPool.hpp"
 using namespace mem;
+// the number of fields a JsonFieldTable can hold
+#ifndef JSON_FIELD_TABLE_MAX_FIELDS
+#define JSON_FIELD_TABLE_MAX_FIELDS 64
+#endif
 const char JSON_LITERAL_NULL[] PROGMEM =  "null";
 #define JSON_LITERAL_NULL_LEN 5
 const char JSON_LITERAL_TRUE[] PROGMEM =  "true";
@@ -59,15 +63,83 @@ const char JSON_LITERAL_ESCAPE_UNICODE[] PROGMEM =  "\\u";
 namespace json {
     class JsonElement;
 
+    // a hash table over a set of field names, built once so names can be looked up without
+    // comparing them against every field. names that aren't null terminated can be looked up
+    class JsonFieldTable {
+        const char* const* m_pfields;
+        size_t m_count;
+        // field indices plus one, 0 for empty
+        uint8_t m_slots[JSON_FIELD_TABLE_MAX_FIELDS*2];
+        static uint32_t hash(const char* name,size_t size) {
+            uint32_t result = 2166136261UL;
+            for(size_t i = 0;i<size;++i)
+                result = (result^(uint8_t)name[i])*16777619UL;
+            return result;
+        }
+    public:
+        // the fields must stay valid while the table is in use. fields past the maximum are
+        // never found
+        JsonFieldTable(const char* const* pfields,size_t count) : m_pfields(pfields),m_count(count<JSON_FIELD_TABLE_MAX_FIELDS?count:JSON_FIELD_TABLE_MAX_FIELDS) {
+            memset(m_slots,0,sizeof(m_slots));
+            // insert backward so the first of any duplicate names wins
+            for(size_t i = m_count;0<i;--i) {
+                const char* sz = m_pfields[i-1];
+                size_t s = hash(sz,strlen(sz))%sizeof(m_slots);
+                while(0!=m_slots[s] && 0!=strcmp(m_pfields[m_slots[s]-1],sz))
+                    s = (s+1)%sizeof(m_slots);
+                m_slots[s] = (uint8_t)i;
+            }
+        }
+        // finds the index of the field with the specified name, or -1
+        int find(const char* name,size_t size) const {
+            size_t s = hash(name,size)%sizeof(m_slots);
+            while(0!=m_slots[s]) {
+                const char* sz = m_pfields[m_slots[s]-1];
+                if(0==strncmp(sz,name,size) && 0==sz[size])
+                    return m_slots[s]-1;
+                s = (s+1)%sizeof(m_slots);
+            }
+            return -1;
+        }
+        size_t size() const { return m_count; }
+    };
+
+    struct JsonExtractor;
+    // receives the items wildcard and slice extractors select
+    class JsonExtractSink {
+    public:
+        // called for each item once the child extractor has filled in its results. field is
+        // the item's field name for objects, or null for arrays. the pool is rolled back after
+        // each item, so copy anything that needs to outlive the call. return false to stop
+        virtual bool extracted(const JsonExtractor& child,unsigned long index,const char* field)=0;
+        virtual ~JsonExtractSink() {}
+    };
+
     struct JsonExtractor {
+        // extracts the listed fields or indices, or the value itself when count is 0
+        static const int8_t Fixed = 0;
+        // extracts every element of an array or field of an object with the one child
+        static const int8_t Wildcard = 1;
+        // extracts the elements of an array in [start:end:step] with the one child
+        static const int8_t Slice = 2;
 
+        int8_t kind;
         size_t count;
         const char** pfields;
         const size_t* pindices;
+        // no longer used. kept so existing initializers still compile
         const void** palloced;
         JsonElement* presult;
         JsonExtractor* pchildren;
-        
+        // an optional table over pfields, for wide object extractions
+        const JsonFieldTable* ptable;
+        // the range of a slice
+        unsigned long start;
+        unsigned long end;
+        unsigned long step;
+        // receives each item of a wildcard or slice
+        JsonExtractSink* psink;
+
         JsonExtractor(JsonElement* presult) {
             this->pfields = nullptr;
             this->pindices = nullptr;
@@ -75,14 +147,18 @@ namespace json {
             this->presult = presult;
             this->pchildren = nullptr;
             this->palloced = nullptr;
+            this->ptable = nullptr;
+            init(Fixed,0,0,1,nullptr);
         }
-        JsonExtractor(const char** pfields,size_t count,JsonExtractor*pchildren) {
+        JsonExtractor(const char** pfields,size_t count,JsonExtractor*pchildren,const JsonFieldTable* ptable=nullptr) {
             this->pfields =pfields;
             this->pindices = nullptr;
             this->count = count;
             this->presult = nullptr;
             this->pchildren = pchildren;
             this->palloced = nullptr;
+            this->ptable = ptable;
+            init(Fixed,0,0,1,nullptr);
         }
         JsonExtractor(const size_t* pindices,size_t count,JsonExtractor* pchildren) {
             this->pindices =pindices;
@@ -91,11 +167,46 @@ namespace json {
             this->presult = nullptr;
             this->pchildren = pchildren;
             this->palloced = nullptr;
+            this->ptable = nullptr;
+            init(Fixed,0,0,1,nullptr);
+        }
+        // extracts every element of an array, or every field value of an object, with the child.
+        // any other value fails with JSON_ERROR_UNEXPECTED_VALUE
+        JsonExtractor(JsonExtractor* pchild,JsonExtractSink* psink) {
+            this->pfields = nullptr;
+            this->pindices = nullptr;
+            this->count = 1;
+            this->presult = nullptr;
+            this->pchildren = pchild;
+            this->palloced = nullptr;
+            this->ptable = nullptr;
+            init(Wildcard,0,(unsigned long)-1,1,psink);
+        }
+        // extracts the elements of an array from start up to but not including end, every step
+        // elements, with the child. pass (unsigned long)-1 for the end to go to the end. any
+        // other value fails with JSON_ERROR_UNEXPECTED_VALUE
+        JsonExtractor(unsigned long start,unsigned long end,unsigned long step,JsonExtractor* pchild,JsonExtractSink* psink) {
+            this->pfields = nullptr;
+            this->pindices = nullptr;
+            this->count = 1;
+            this->presult = nullptr;
+            this->pchildren = pchild;
+            this->palloced = nullptr;
+            this->ptable = nullptr;
+            init(Slice,start,end,0==step?1:step,psink);
         }
         JsonExtractor(const JsonExtractor& rhs)=default;
         JsonExtractor& operator=(const JsonExtractor& rhs)=default;
         JsonExtractor& operator=(JsonExtractor&& rhs)=default;
         ~JsonExtractor()=default;
+    private:
+        void init(int8_t kind,unsigned long start,unsigned long end,unsigned long step,JsonExtractSink* psink) {
+            this->kind = kind;
+            this->start = start;
+            this->end = end;
+            this->step = step;
+            this->psink = psink;
+        }
     };
 
     struct JsonFieldEntry {
@@ -430,16 +541,21 @@ namespace json {
         void boolean(bool value) { m_type=Boolean; m_boolean = value; }
         char* string() const {return (m_type==String)?m_string:nullptr; }
         void string(char* value) { m_type = String; m_string=value;}
-        JsonFieldEntry* pobject() { return (m_type==Object)?m_pobject:nullptr;}
+        JsonFieldEntry* pobject() const { return (m_type==Object)?m_pobject:nullptr;}
         void pobject(nullptr_t dummy) {
             m_type=Object;
             m_pobject = nullptr;
         }
-        JsonArrayEntry* parray() { return m_type==Array?m_parray:nullptr;}
+        JsonArrayEntry* parray() const { return m_type==Array?m_parray:nullptr;}
         void parray(nullptr_t dummy) {
             m_type=Array;
             m_parray = nullptr;
         }
+        // sets the array to entries that are already linked
+        void parray(JsonArrayEntry* value) {
+            m_type=Array;
+            m_parray = value;
+        }
         bool undefined() const {return m_type==Undefined;}
         char* toString(MemoryPool &pool) const {
             char* result = (char*)pool.next();
@@ -1,3 +1,8 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONUTILITY_HPP
+#define HTCW_JSONUTILITY_HPP
 #include <math.h>
 #ifndef ARDUINO
 #include <cstdint>
@@ -835,4 +840,5 @@ namespace json {
 
         } 
     };
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,342 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_JSONWRITER_HPP
+#define HTCW_JSONWRITER_HPP
+#ifndef ARDUINO
+#include <cinttypes>
+#include <string.h>
+#include <stdio.h>
+#endif
+#include "ArduinoCommon.h"
+#include "LexSink.hpp"
+#include "JsonReader.hpp"
+
+namespace json {
+    // represents a target for a stream of JSON events
+    // the events mirror the nodes JsonReader reports
+    class JsonWriter {
+        JsonWriter(const JsonWriter& rhs)=delete;
+        JsonWriter& operator=(const JsonWriter& rhs)=delete;
+    protected:
+        // writes the scalar under the reader's cursor, including any value parts
+        // leaves the reader on the scalar's final node
+        virtual bool copyScalar(JsonReader& reader) {
+            int8_t valueType = reader.valueType();
+            if(JsonReader::ValuePart==reader.nodeType()) {
+                if(JsonReader::String==valueType) {
+                    if(!beginString())
+                        return false;
+                    while(JsonReader::ValuePart==reader.nodeType()) {
+                        if(!stringPart(reader.value()) || !reader.read())
+                            return false;
+                    }
+                    return endString();
+                }
+                // numbers and literals only have a value at the end
+                while(JsonReader::ValuePart==reader.nodeType()) {
+                    if(!reader.read())
+                        return false;
+                }
+            }
+            switch(valueType) {
+                case JsonReader::Null:
+                    return null();
+                case JsonReader::String:
+                    return string(reader.value());
+                case JsonReader::Real:
+                    return real(reader.realValue());
+                case JsonReader::Integer:
+                    return integer(reader.integerValue());
+                case JsonReader::Boolean:
+                    return boolean(reader.booleanValue());
+            }
+            return false;
+        }
+    public:
+        JsonWriter() {}
+        virtual bool beginObject()=0;
+        virtual bool endObject()=0;
+        virtual bool beginArray()=0;
+        virtual bool endArray()=0;
+        // writes a field name. the field's value must be written next
+        virtual bool field(const char* name)=0;
+        virtual bool null()=0;
+        virtual bool boolean(bool value)=0;
+        virtual bool integer(long long value)=0;
+        virtual bool real(double value)=0;
+        virtual bool string(const char* value)=0;
+        // writes a string in pieces, for values too big to hold at once
+        virtual bool beginString()=0;
+        virtual bool stringPart(const char* value)=0;
+        virtual bool endString()=0;
+        // writes the subtree under the reader's cursor and moves the reader past it.
+        // on a field, the field's value is written. the name must already have been written.
+        virtual bool copySubtree(JsonReader& reader) {
+            unsigned long int depth = 0;
+            switch(reader.nodeType()) {
+                case JsonReader::EndObject:
+                case JsonReader::EndArray:
+                    return true;
+                case JsonReader::Initial:
+                case JsonReader::Field:
+                    if(!reader.read())
+                        return false;
+                    break;
+            }
+            while(true) {
+                switch(reader.nodeType()) {
+                    case JsonReader::Object:
+                        if(!beginObject())
+                            return false;
+                        ++depth;
+                        break;
+                    case JsonReader::EndObject:
+                        if(!endObject())
+                            return false;
+                        --depth;
+                        break;
+                    case JsonReader::Array:
+                        if(!beginArray())
+                            return false;
+                        ++depth;
+                        break;
+                    case JsonReader::EndArray:
+                        if(!endArray())
+                            return false;
+                        --depth;
+                        break;
+                    case JsonReader::Field:
+                        if(!field(reader.value()))
+                            return false;
+                        break;
+                    case JsonReader::Value:
+                    case JsonReader::ValuePart:
+                        if(!copyScalar(reader))
+                            return false;
+                        break;
+                    default:
+                        return false;
+                }
+                if(!reader.read())
+                    return 0==depth && !reader.hasError();
+                if(0==depth)
+                    return true;
+            }
+        }
+        // writes an in memory tree
+        bool element(const JsonElement& value) {
+            switch(value.type()) {
+                case JsonElement::Null:
+                    return null();
+                case JsonElement::String:
+                    return string(value.string());
+                case JsonElement::Real:
+                    return real(value.real());
+                case JsonElement::Integer:
+                    return integer(value.integer());
+                case JsonElement::Boolean:
+                    return boolean(value.boolean());
+                case JsonElement::Array:
+                    if(!beginArray())
+                        return false;
+                    for(JsonArrayEntry* pae = value.parray();nullptr!=pae;pae=pae->pnext) {
+                        if(!element(*pae->pvalue))
+                            return false;
+                    }
+                    return endArray();
+                case JsonElement::Object:
+                    if(!beginObject())
+                        return false;
+                    for(JsonFieldEntry* pfe = value.pobject();nullptr!=pfe;pfe=pfe->pnext) {
+                        if(!field(pfe->name) || !element(*pfe->pvalue))
+                            return false;
+                    }
+                    return endObject();
+            }
+            return false;
+        }
+        virtual ~JsonWriter() {}
+    };
+    // writes compact JSON text to a LexSink
+    class JsonTextWriter : public JsonWriter {
+        lex::LexSink& m_sink;
+        // indicates a comma is due before the next value or field
+        bool m_comma;
+        bool separate() {
+            if(m_comma) {
+                m_comma = false;
+                return m_sink.write(",",1);
+            }
+            return true;
+        }
+        bool writeEscaped(const char* sz) {
+            const char* run = sz;
+            const char* esc;
+            char szu[8];
+            char ch;
+            while(0!=(ch=*sz)) {
+                switch(ch) {
+                    case '\"':
+                        esc = "\\\"";
+                        break;
+                    case '\\':
+                        esc = "\\\\";
+                        break;
+                    case '\r':
+                        esc = "\\r";
+                        break;
+                    case '\n':
+                        esc = "\\n";
+                        break;
+                    case '\t':
+                        esc = "\\t";
+                        break;
+                    case '\b':
+                        esc = "\\b";
+                        break;
+                    case '\f':
+                        esc = "\\f";
+                        break;
+                    default:
+                        if(32>(unsigned char)ch) {
+                            sprintf(szu,"\\u%04x",(unsigned int)ch);
+                            esc = szu;
+                        } else
+                            esc = nullptr;
+                        break;
+                }
+                if(nullptr!=esc) {
+                    if(sz>run && !m_sink.write(run,sz-run))
+                        return false;
+                    if(!m_sink.write(esc,strlen(esc)))
+                        return false;
+                    run = sz+1;
+                }
+                ++sz;
+            }
+            return sz==run || m_sink.write(run,sz-run);
+        }
+        bool writeString(const char* value) {
+            return m_sink.write("\"",1) &&
+                writeEscaped(value) &&
+                m_sink.write("\"",1);
+        }
+        bool scalar(const char* lexical) {
+            if(!separate() || !m_sink.write(lexical,strlen(lexical)))
+                return false;
+            m_comma = true;
+            return true;
+        }
+    protected:
+        bool copyScalar(JsonReader& reader) override {
+            if(JsonReader::String==reader.valueType())
+                return JsonWriter::copyScalar(reader);
+            // numbers and literals are written as they appear in the document
+            if(!separate())
+                return false;
+            while(true) {
+                const char* sz = reader.value();
+                if(nullptr!=sz && !m_sink.write(sz,strlen(sz)))
+                    return false;
+                if(JsonReader::ValuePart!=reader.nodeType())
+                    break;
+                if(!reader.read())
+                    return false;
+            }
+            m_comma = true;
+            return true;
+        }
+    public:
+        JsonTextWriter(lex::LexSink& sink) : m_sink(sink),m_comma(false) {
+        }
+        // starts a new top level value without a separator, such as the next record of a JSON lines stream
+        void reset() {
+            m_comma = false;
+        }
+        lex::LexSink& sink() const { return m_sink; }
+        bool beginObject() override {
+            if(!separate() || !m_sink.write("{",1))
+                return false;
+            m_comma = false;
+            return true;
+        }
+        bool endObject() override {
+            if(!m_sink.write("}",1))
+                return false;
+            m_comma = true;
+            return true;
+        }
+        bool beginArray() override {
+            if(!separate() || !m_sink.write("[",1))
+                return false;
+            m_comma = false;
+            return true;
+        }
+        bool endArray() override {
+            if(!m_sink.write("]",1))
+                return false;
+            m_comma = true;
+            return true;
+        }
+        bool field(const char* name) override {
+            if(nullptr==name || !separate() || !writeString(name) || !m_sink.write(":",1))
+                return false;
+            m_comma = false;
+            return true;
+        }
+        bool null() override {
+            return scalar("null");
+        }
+        bool boolean(bool value) override {
+            return scalar(value?"true":"false");
+        }
+        bool integer(long long value) override {
+            char szn[32];
+            sprintf(szn,"%lld",value);
+            return scalar(szn);
+        }
+        bool real(double value) override {
+            char szn[32];
+#ifdef ARDUINO
+            dtostrf(value, 1,6,szn);
+#else
+            sprintf(szn,"%.17g",value);
+#endif
+            return scalar(szn);
+        }
+        bool string(const char* value) override {
+            if(nullptr==value || !separate() || !writeString(value))
+                return false;
+            m_comma = true;
+            return true;
+        }
+        bool beginString() override {
+            return separate() && m_sink.write("\"",1);
+        }
+        bool stringPart(const char* value) override {
+            return nullptr!=value && writeEscaped(value);
+        }
+        bool endString() override {
+            if(!m_sink.write("\"",1))
+                return false;
+            m_comma = true;
+            return true;
+        }
+        // copies objects, arrays and fields byte for byte without lexing them
+        bool copySubtree(JsonReader& reader) override {
+            switch(reader.nodeType()) {
+                case JsonReader::Initial:
+                case JsonReader::Field:
+                case JsonReader::Object:
+                case JsonReader::Array:
+                    if(!separate() || !reader.copySubtree(m_sink))
+                        return false;
+                    m_comma = true;
+                    return true;
+            }
+            return JsonWriter::copySubtree(reader);
+        }
+    };
+}
+#endif
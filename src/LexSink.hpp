@@ -0,0 +1,190 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_LEXSINK_HPP
+#define HTCW_LEXSINK_HPP
+
+#ifndef ARDUINO
+#include <cinttypes>
+#include <cstddef>
+#include <stdio.h>
+#include <string.h>
+#endif
+#include "MemoryPool.hpp"
+
+namespace lex {
+// represents an output target for raw text or bytes
+// this is the writing counterpart of LexSource
+class LexSink {
+        LexSink(LexSink& rhs) = delete;
+        LexSink(LexSink&& rhs) = delete;
+        LexSink& operator=(LexSink& rhs) = delete;
+    public:
+        LexSink() {}
+        // writes the specified bytes
+        // returns false on failure
+        virtual bool write(const char* data,size_t size)=0;
+        // flushes any buffered output
+        virtual bool flush() { return true; }
+        virtual ~LexSink() {}
+};
+// discards everything written to it, keeping count of the bytes
+class NullLexSink : public LexSink {
+    unsigned long long m_count;
+public:
+    NullLexSink() : m_count(0) {}
+    bool write(const char* data,size_t size) override {
+        (void)data;
+        m_count+=size;
+        return true;
+    }
+    unsigned long long count() const { return m_count; }
+    void reset() { m_count = 0; }
+};
+// appends everything written to it to a memory pool, keeping it contiguous
+// the pool must not be used for anything else while it's being written
+class PoolLexSink : public LexSink {
+    mem::MemoryPool* m_ppool;
+    char* m_pstart;
+    size_t m_size;
+    bool m_full;
+public:
+    PoolLexSink(mem::MemoryPool& pool) : m_ppool(&pool),m_pstart(nullptr),m_size(0),m_full(false) {}
+    // without a pool every write fails
+    PoolLexSink(mem::MemoryPool* ppool) : m_ppool(ppool),m_pstart(nullptr),m_size(0),m_full(false) {}
+    bool write(const char* data,size_t size) override {
+        if(0==size)
+            return true;
+        char* p = (nullptr!=m_ppool)?(char*)m_ppool->alloc(size):nullptr;
+        if(nullptr==p) {
+            m_full = true;
+            return false;
+        }
+        if(nullptr==m_pstart)
+            m_pstart = p;
+        else if(p!=m_pstart+m_size) {
+            // someone else allocated from the pool
+            m_ppool->unalloc(size);
+            return false;
+        }
+        memcpy(p,data,size);
+        m_size+=size;
+        return true;
+    }
+    // the start of what was written, or null if nothing was
+    char* data() const { return m_pstart; }
+    size_t size() const { return m_size; }
+    // indicates a write failed because the pool ran out, or there isn't one
+    bool full() const { return m_full; }
+};
+#ifndef ARDUINO
+class FileLexSink : public LexSink {
+    FILE* m_pfile;
+    FileLexSink(FileLexSink& rhs)=delete;
+    FileLexSink(FileLexSink&& rhs)=delete;
+    FileLexSink& operator=(FileLexSink& rhs)=delete;
+public:
+    FileLexSink() : m_pfile(nullptr) {
+    }
+    ~FileLexSink() override {}
+    bool write(const char* data,size_t size) override {
+        if(nullptr==m_pfile)
+            return false;
+        return size==fwrite(data,1,size,m_pfile);
+    }
+    bool flush() override {
+        if(nullptr==m_pfile)
+            return false;
+        return 0==fflush(m_pfile);
+    }
+    bool open(const char* filename) {
+        if(nullptr!=m_pfile)
+            return false;
+        m_pfile=fopen(filename,"wb");
+        return nullptr!=m_pfile;
+    }
+    bool attach(FILE* pfile) {
+        if(nullptr==pfile)
+            return false;
+        if(nullptr!=m_pfile)
+            return false;
+        m_pfile = pfile;
+        return true;
+    }
+    bool detach() {
+        if(nullptr==m_pfile)
+            return false;
+        m_pfile = nullptr;
+        return true;
+    }
+    void close() {
+        if(nullptr!=m_pfile) {
+            fclose(m_pfile);
+            m_pfile = nullptr;
+        }
+    }
+};
+#endif
+// writes to a caller supplied buffer, keeping it null terminated
+class SZLexSink : public LexSink {
+    char* m_sz;
+    size_t m_capacity;
+    size_t m_size;
+    SZLexSink(SZLexSink& rhs)=delete;
+    SZLexSink(SZLexSink&& rhs)=delete;
+    SZLexSink& operator=(SZLexSink& rhs)=delete;
+public:
+    SZLexSink() : m_sz(nullptr),m_capacity(0),m_size(0) {
+    }
+    ~SZLexSink() override {}
+    bool write(const char* data,size_t size) override {
+        if(nullptr==m_sz)
+            return false;
+        // leave room for the null terminator
+        if(m_size+size>=m_capacity)
+            return false;
+        memcpy(m_sz+m_size,data,size);
+        m_size+=size;
+        m_sz[m_size]=0;
+        return true;
+    }
+    bool attach(char* buffer,size_t capacity) {
+        if(nullptr==buffer || 0==capacity)
+            return false;
+        if(nullptr!=m_sz)
+            return false;
+        m_sz = buffer;
+        m_capacity = capacity;
+        m_size = 0;
+        *m_sz = 0;
+        return true;
+    }
+    bool detach() {
+        if(nullptr==m_sz)
+            return false;
+        m_sz = nullptr;
+        m_capacity = 0;
+        m_size = 0;
+        return true;
+    }
+    // indicates the number of bytes written, not including the terminator
+    size_t size() const { return m_size; }
+};
+#if defined ARDUINO
+class ArduinoLexSink : public LexSink {
+    Print* m_pprint;
+public:
+    ArduinoLexSink() : m_pprint(nullptr) {}
+    bool write(const char* data,size_t size) override {
+        if(nullptr==m_pprint)
+            return false;
+        return size==m_pprint->write((const uint8_t*)data,size);
+    }
+    bool begin(Print& print) {
+        m_pprint = &print;
+        return true;
+    }
+};
+#endif
+} // namespace lex
+#endif
@@ -9,9 +9,11 @@
 #include <cinttypes>
 #include <cstddef>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "MemoryPool.hpp"
 #endif
+#include "LexSink.hpp"
 
 namespace lex {
 
@@ -26,6 +28,8 @@ class LexSource {
         */
             
         unsigned long long m_position;
+        // when set, consumed characters are copied here
+        LexSink* m_ptee;
     public:
         static const int8_t IOError = -3;
         static const int8_t OutOfMemoryError=-4;
@@ -35,8 +39,41 @@ class LexSource {
         LexSource& operator=(LexSource& rhs) = delete;
         
         const int8_t Initial = -5;
+        // writes the current codepoint to the tee as utf8
+        bool teeCurrent() {
+            char buf[4];
+            size_t c;
+            if (0 == ((int32_t)0xffffff80 & m_current)) {
+                buf[0]=(char)m_current;
+                c=1;
+            } else if (0 == ((int32_t)0xfffff800 & m_current)) {
+                buf[0]=0xc0 | (char)(m_current >> 6);
+                buf[1]=0x80 | (char)(m_current & 0x3f);
+                c=2;
+            } else if (0 == ((int32_t)0xffff0000 & m_current)) {
+                buf[0]=0xe0 | (char)(m_current >> 12);
+                buf[1]=0x80 | (char)((m_current >> 6) & 0x3f);
+                buf[2]=0x80 | (char)(m_current & 0x3f);
+                c=3;
+            } else {
+                buf[0]=0xf0 | (char)(m_current >> 18);
+                buf[1]=0x80 | (char)((m_current >> 12) & 0x3f);
+                buf[2]=0x80 | (char)((m_current >> 6) & 0x3f);
+                buf[3]=0x80 | (char)(m_current & 0x3f);
+                c=4;
+            }
+            if(!m_ptee->write(buf,c)) {
+                m_state = IOError;
+                m_current = 0;
+                return false;
+            }
+            return true;
+        }
         bool advanceImpl() {
             int16_t ch;
+            // the tee trails the cursor by one character
+            if(nullptr!=m_ptee && 0<m_current && !teeCurrent())
+                return false;
             
             /* I'm keeping this in for now so I can try to make it simd later
             int e=0;
@@ -110,7 +147,7 @@ class LexSource {
                     return false;
                 }
                 m_current |= 0x3f & ch;
-                ++m_position;
+                m_position+=3;
                 return true;
             }
             if (0xe0 == (0xf0 & m_current)) {
@@ -128,7 +165,7 @@ class LexSource {
                     return false;
                 }
                 m_current |= 0x3f & ch;
-                ++m_position;
+                m_position+=2;
                 return true;
             }
             //if (0xc0 == (0xe0 & ch)) {
@@ -197,6 +234,7 @@ class LexSource {
         virtual bool skipToAny(const char* characters7bit,unsigned long long& position,int16_t& match,int8_t& error) {
             error = 0;
             const char *sz;
+            char ch;
             if(current()>-1&&current()<128) {
                 match=(int16_t)current();
                 sz = strchr(characters7bit,match);
@@ -205,25 +243,61 @@ class LexSource {
                     return true;
                 }
             }
+            if(nullptr!=m_ptee && 0<m_current && !teeCurrent()) {
+                match = 0;
+                error = IOError;
+                return false;
+            }
             while(-1<(match=read())) {
                 ++position;
-                if(match>127)
-                    continue;
-                sz = strchr(characters7bit,(char)match);
-                if(nullptr!=sz) {
-                    match=*sz;
-                    return true;
+                if(match<128) {
+                    sz = strchr(characters7bit,(char)match);
+                    if(nullptr!=sz) {
+                        match=*sz;
+                        return true;
+                    }
+                }
+                if(nullptr!=m_ptee) {
+                    ch = (char)match;
+                    if(!m_ptee->write(&ch,1)) {
+                        match = 0;
+                        error = IOError;
+                        return false;
+                    }
                 }
-            
             }
             error = match;
             return false;
         }
+        // does the work of skipToContainerEnd(). sources that can't skip that way return false
+        // without an error
+        virtual bool skipContainer(unsigned long long& position,int16_t& match,int8_t& error) {
+            (void)position;
+            match = 0;
+            error = 0;
+            return false;
+        }
         virtual bool appendCapture(char ch)=0;
         void clearError() {m_state = 0;}
+        // the cursor, for sources that can go back to an earlier point in their input
+        struct Cursor {
+            int8_t state;
+            int32_t current;
+            unsigned long long position;
+        };
+        void saveCursor(Cursor& cursor) const {
+            cursor.state = m_state;
+            cursor.current = m_current;
+            cursor.position = m_position;
+        }
+        void restoreCursor(const Cursor& cursor) {
+            m_state = cursor.state;
+            m_current = cursor.current;
+            m_position = cursor.position;
+        }
         
     public:
-        LexSource()  {
+        LexSource() : m_ptee(nullptr) {
             reset();
         }
         
@@ -253,7 +327,53 @@ class LexSource {
             m_position=pos;
             return match;
         }
-      
+        // when the cursor is on a string's opening quote and the input is in memory, gives the
+        // bytes of the string up to its closing quote without moving the cursor. returns false
+        // if the source can't do that or the string has escapes in it
+        virtual bool peekString(const char** pstart,size_t* psize) {
+            (void)pstart;
+            (void)psize;
+            return false;
+        }
+        // moves the cursor to the closing bracket of the array or object it's in without
+        // reading what's in between, for sources that know where their containers end. the
+        // bracket becomes the current character. returns 0, leaving the cursor alone, if the
+        // source can't do that, or on an error
+        char skipToContainerEnd() {
+            int16_t match;
+            unsigned long long int pos=m_position;
+            int8_t error=0;
+            if(!skipContainer(pos,match,error)) {
+                if(0>error) {
+                    m_state=error;
+                    m_position=pos;
+                }
+                return 0;
+            }
+            m_current = match;
+            m_position=pos;
+            return (char)match;
+        }
+        // when the cursor is on the first character of a number the source decoded from a
+        // binary encoding, captures the number's text, moves past it and gives its value
+        // without lexing it. returns false if the source can't do that
+        virtual bool takeNumber(long long* pinteger,double* preal,bool* pisReal) {
+            (void)pinteger;
+            (void)preal;
+            (void)pisReal;
+            return false;
+        }
+
+        // clears running out of capture space, so the input can be read on from another spot.
+        // returns false if it can't be read any further
+        bool recover() {
+            if(OutOfMemoryError==m_state) {
+                m_state = 0;
+                clearCapture();
+            }
+            return !hasError() && EndOfInput!=m_state;
+        }
+
         inline bool advance() {
             /*if (EndOfInput == m_state || IOError==m_state) {
                 m_current = 0;
@@ -294,7 +414,22 @@ class LexSource {
             }
             return true;
         }
+        // copies all input consumed from here on to the sink, or stops when it's null
+        // the character under the cursor is written once the cursor moves past it
+        void tee(LexSink* psink) { m_ptee = psink; }
+        LexSink* tee() const { return m_ptee; }
+        // indicates the number of bytes consumed from the input, including the current codepoint
         inline unsigned long long position() const { return m_position; }
+        // indicates the number of bytes the current codepoint occupies in the input
+        size_t currentLength() const {
+            if(0 == ((int32_t)0xffffff80 & m_current))
+                return 1;
+            if(0 == ((int32_t)0xfffff800 & m_current))
+                return 2;
+            if(0 == ((int32_t)0xffff0000 & m_current))
+                return 3;
+            return 4;
+        }
         inline bool more() const {
             return -1<m_state||Initial==m_state;
         }
@@ -433,6 +568,7 @@ public:
             return false;
         reset();
         m_pfile = pfile;
+        return true;
     }
     bool detach() {
         if(nullptr==m_pfile)
@@ -473,15 +609,27 @@ protected:
         } 
 
         const char*sz=strpbrk(m_sz-1, characters7bit);
+        LexSink* ptee = tee();
+        // the tee hasn't seen the current character yet
+        const char* pteed = m_sz-(0<current()?currentLength():0);
         if(nullptr==sz) {
             // advance everything to the end since we found jack
             size_t c = strlen(m_sz);
+            if(nullptr!=ptee && !ptee->write(pteed,(m_sz+c)-pteed)) {
+                match = 0;
+                error = IOError;
+                return false;
+            }
             position+=c;
             m_sz +=c;
             error = EndOfInput;
             return false;
         }
-        
+        if(nullptr!=ptee && sz>pteed && !ptee->write(pteed,sz-pteed)) {
+            match = 0;
+            error = IOError;
+            return false;
+        }
         match = *sz;
         position += (sz - m_sz)+1;
         m_sz = sz+1;
@@ -492,8 +640,18 @@ protected:
 public:
     SZLexSource() {
         m_sz = nullptr;
-    }   
+    }
     ~SZLexSource() override {}
+    bool peekString(const char** pstart,size_t* psize) override {
+        if(nullptr==m_sz || '\"'!=current())
+            return false;
+        const char* sz = strpbrk(m_sz,"\"\\");
+        if(nullptr==sz || '\"'!=*sz)
+            return false;
+        *pstart = m_sz;
+        *psize = sz-m_sz;
+        return true;
+    }
     bool attach(const char* sz) {
         if(nullptr==sz)
             return false;
@@ -510,6 +668,227 @@ public:
         return true;
     } 
 };
+// reads from a span of memory, which doesn't need to be null terminated
+class SpanLexSource : public virtual LexSource {
+    const char* m_start;
+    const char* m_cur;
+    const char* m_end;
+    SpanLexSource(SpanLexSource& rhs)=delete;
+    SpanLexSource(SpanLexSource&& rhs)=delete;
+    SpanLexSource& operator=(SpanLexSource& rhs)=delete;
+
+protected:
+    int16_t read() final {
+        if(nullptr==m_cur)
+            return LexSource::Closed;
+        if(m_cur>=m_end)
+            return LexSource::EndOfInput;
+        return (unsigned char)*(m_cur++);
+    }
+    bool skipToAny(const char* characters7bit,unsigned long long& position,int16_t& match,int8_t& error) final {
+        if(nullptr==m_cur){
+            match = 0;
+            error=Closed;
+            return false;
+        }
+        // the span isn't terminated, so we can't use strpbrk(). bytes past 127 are looked up
+        // too, and are never in the set
+        uint32_t set[8] = {0,0,0,0,0,0,0,0};
+        for(const char* sz = characters7bit;0!=*sz;++sz)
+            set[((uint8_t)*sz)>>5]|=((uint32_t)1)<<(*sz&31);
+        // we're always one ahead of where we want to start searching
+        const char* sz = (m_cur>m_start)?m_cur-1:m_cur;
+        while(sz<m_end && 0==(set[((uint8_t)*sz)>>5]&(((uint32_t)1)<<(*sz&31))))
+            ++sz;
+        LexSink* ptee = tee();
+        // the tee hasn't seen the current character yet
+        const char* pteed = m_cur-(0<current()?currentLength():0);
+        if(sz==m_end) {
+            if(nullptr!=ptee && !ptee->write(pteed,m_end-pteed)) {
+                match = 0;
+                error = IOError;
+                return false;
+            }
+            position+=m_end-m_cur;
+            m_cur = m_end;
+            error = EndOfInput;
+            return false;
+        }
+        if(nullptr!=ptee && sz>pteed && !ptee->write(pteed,sz-pteed)) {
+            match = 0;
+            error = IOError;
+            return false;
+        }
+        match = *sz;
+        position += (sz - m_cur)+1;
+        m_cur = sz+1;
+        error=0;
+        return true;
+    }
+
+public:
+    SpanLexSource() : m_start(nullptr),m_cur(nullptr),m_end(nullptr) {
+    }
+    ~SpanLexSource() override {}
+    bool peekString(const char** pstart,size_t* psize) override {
+        if(nullptr==m_cur || '\"'!=current())
+            return false;
+        const char* sz = (const char*)memchr(m_cur,'\"',m_end-m_cur);
+        if(nullptr==sz || nullptr!=memchr(m_cur,'\\',sz-m_cur))
+            return false;
+        *pstart = m_cur;
+        *psize = sz-m_cur;
+        return true;
+    }
+    bool attach(const char* data,size_t size) {
+        if(nullptr==data)
+            return false;
+        if(nullptr!=m_cur)
+            return false;
+        reset();
+        m_start = m_cur = data;
+        m_end = data+size;
+        return true;
+    }
+    bool detach() {
+        if(nullptr==m_cur)
+            return false;
+        m_start = m_cur = m_end = nullptr;
+        return true;
+    }
+};
+// reads input that's pushed to it a piece at a time, as it arrives from a socket or the like.
+// when the input it has runs out before finish() is called, it reports the end of input and
+// flags itself as starved, and JsonPushReader rewinds to the last mark() to try again once
+// more is fed. only the input from the mark on is kept
+class PushLexSource : public virtual LexSource {
+    char* m_pbuffer;
+    size_t m_capacity;
+    size_t m_size;
+    size_t m_cur;
+    size_t m_mark;
+    Cursor m_markCursor;
+    bool m_finished;
+    bool m_starved;
+    PushLexSource(PushLexSource& rhs)=delete;
+    PushLexSource(PushLexSource&& rhs)=delete;
+    PushLexSource& operator=(PushLexSource& rhs)=delete;
+    int8_t dry() {
+        if(m_finished)
+            return LexSource::EndOfInput;
+        m_starved = true;
+        return LexSource::EndOfInput;
+    }
+protected:
+    int16_t read() final {
+        if(m_cur>=m_size)
+            return dry();
+        return (unsigned char)m_pbuffer[m_cur++];
+    }
+    bool skipToAny(const char* characters7bit,unsigned long long& position,int16_t& match,int8_t& error) final {
+        // bytes past 127 are looked up too, and are never in the set
+        uint32_t set[8] = {0,0,0,0,0,0,0,0};
+        for(const char* sz = characters7bit;0!=*sz;++sz)
+            set[((uint8_t)*sz)>>5]|=((uint32_t)1)<<(*sz&31);
+        // we're always one ahead of where we want to start searching
+        size_t i = (0<m_cur && 0<current())?m_cur-1:m_cur;
+        while(i<m_size && 0==(set[((uint8_t)m_pbuffer[i])>>5]&(((uint32_t)1)<<(m_pbuffer[i]&31))))
+            ++i;
+        LexSink* ptee = tee();
+        // the tee hasn't seen the current character yet
+        size_t teed = m_cur-((0<current() && m_cur>=currentLength())?currentLength():0);
+        if(i==m_size) {
+            if(nullptr!=ptee && !ptee->write(m_pbuffer+teed,m_size-teed)) {
+                match = 0;
+                error = IOError;
+                return false;
+            }
+            position+=m_size-m_cur;
+            m_cur = m_size;
+            match = 0;
+            error = dry();
+            return false;
+        }
+        if(nullptr!=ptee && i>teed && !ptee->write(m_pbuffer+teed,i-teed)) {
+            match = 0;
+            error = IOError;
+            return false;
+        }
+        match = m_pbuffer[i];
+        position += (i+1)-m_cur;
+        m_cur = i+1;
+        error=0;
+        return true;
+    }
+public:
+    PushLexSource() : m_pbuffer(nullptr),m_capacity(0),m_size(0),m_cur(0),m_mark(0),m_finished(false),m_starved(false) {
+        saveCursor(m_markCursor);
+    }
+    ~PushLexSource() override {
+        free(m_pbuffer);
+    }
+    bool peekString(const char** pstart,size_t* psize) override {
+        if(0==m_cur || '\"'!=current())
+            return false;
+        const char* sz = (const char*)memchr(m_pbuffer+m_cur,'\"',m_size-m_cur);
+        if(nullptr==sz || nullptr!=memchr(m_pbuffer+m_cur,'\\',sz-(m_pbuffer+m_cur)))
+            return false;
+        *pstart = m_pbuffer+m_cur;
+        *psize = sz-(m_pbuffer+m_cur);
+        return true;
+    }
+    // adds input. what came before the mark is dropped first, so the buffer only has to
+    // hold the unfinished part of the input. returns false if out of memory
+    bool feed(const char* data,size_t size) {
+        if(nullptr==data || m_finished)
+            return false;
+        // keep the character under the cursor at the mark, since searches start there
+        size_t drop = (0<m_mark)?m_mark-1:0;
+        if(0<drop) {
+            memmove(m_pbuffer,m_pbuffer+drop,m_size-drop);
+            m_size-=drop;
+            m_cur-=drop;
+            m_mark-=drop;
+        }
+        if(m_size+size>m_capacity) {
+            size_t capacity = (0==m_capacity)?256:m_capacity;
+            while(capacity<m_size+size)
+                capacity*=2;
+            char* p = (char*)realloc(m_pbuffer,capacity);
+            if(nullptr==p)
+                return false;
+            m_pbuffer = p;
+            m_capacity = capacity;
+        }
+        memcpy(m_pbuffer+m_size,data,size);
+        m_size+=size;
+        return true;
+    }
+    // indicates that no more input is coming, so running out is the end of the input
+    void finish() { m_finished = true; }
+    bool finished() const { return m_finished; }
+    // indicates the input ran out before finish() was called
+    bool starved() const { return m_starved; }
+    // remembers the current point in the input to rewind to
+    void mark() {
+        m_mark = m_cur;
+        saveCursor(m_markCursor);
+    }
+    // goes back to the mark
+    void rewind() {
+        m_cur = m_mark;
+        restoreCursor(m_markCursor);
+        m_starved = false;
+    }
+    // drops all the input and readies the source for new input
+    void clear() {
+        reset();
+        m_size = m_cur = m_mark = 0;
+        m_finished = false;
+        m_starved = false;
+        saveCursor(m_markCursor);
+    }
+};
 #if defined ARDUINO
 template<size_t TCapacity> class ArduinoLexSource : public StaticLexSource<TCapacity>, public virtual LexSource {
     Stream* m_pstream;
@@ -535,6 +914,12 @@ template<size_t TCapacity> class StaticFileLexSource : public StaticLexSource<TC
 #endif
 template<size_t TCapacity> class StaticSZLexSource : public StaticLexSource<TCapacity>, public virtual SZLexSource {
 
+};
+template<size_t TCapacity> class StaticSpanLexSource : public StaticLexSource<TCapacity>, public virtual SpanLexSource {
+
+};
+template<size_t TCapacity> class StaticPushLexSource : public StaticLexSource<TCapacity>, public virtual PushLexSource {
+
 };
 } // namespace lex
 #endif
\ No newline at end of file
@@ -56,28 +56,37 @@
 #endif /* !_WIN32 && !HAVE_MMAP */
 namespace mem {
 /*!
- * mapped_file allows you to create a simple read-only file mapping in an
- * object-oriented cross-platform way.
+ * mapped_file allows you to create a simple file mapping in an
+ * object-oriented cross-platform way. Mappings are read-only unless
+ * opened as writable, in which case changes go back to the file.
  */
 class MappedFile
 {
 private:
 	size_t m_size;
 	char *m_pdata;
+	bool m_writable;
+#if !defined(_WIN32) && !HAVE_MMAP
+	// without a real mapping, writes are copied back through this
+	FILE* m_pfile;
+#endif
 	
 		/*!
 	* Maps the specified file into memory.
 	* \param path the path of the file being mapped
 	* \param length pointer which the mapped length is written to.
+	* \param writable true if the mapping can be written to
+	* \param ppfile receives the open file when there's no real mapping to write through
 	* \return the pointer to the mapping. On failure NULL is returned.
 	*/
-	static char *map_file(const char *path, size_t *psize) {
+	static char *map_file(const char *path, size_t *psize, bool writable, void** ppfile) {
 		char *data = NULL;
 		size_t size = 0;
 
 	#ifdef _WIN32
 		HANDLE hMap;
-		HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+		(void)ppfile;
+		HANDLE hFile = CreateFileA(path, writable?(GENERIC_READ|GENERIC_WRITE):GENERIC_READ, FILE_SHARE_READ, NULL,
 								OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
 		if (hFile == INVALID_HANDLE_VALUE)
 			return NULL;
@@ -86,11 +95,11 @@ private:
 		if (size == INVALID_FILE_SIZE || size == 0)
 			goto fail;
 
-		hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, size, NULL);
+		hMap = CreateFileMappingA(hFile, NULL, writable?PAGE_READWRITE:PAGE_READONLY, 0, size, NULL);
 		if (!hMap)
 			goto fail;
 
-		data = (char *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, size);
+		data = (char *)MapViewOfFile(hMap, writable?FILE_MAP_WRITE:FILE_MAP_READ, 0, 0, size);
 
 		/* We can call CloseHandle here, but it will not be closed until
 		* we unmap the view */
@@ -99,24 +108,15 @@ private:
 		CloseHandle(hFile);
 
 	#elif HAVE_MMAP
-		int fd = ::open(path, O_RDONLY);
+		(void)ppfile;
+		int fd = ::open(path, writable?O_RDWR:O_RDONLY);
 		if (fd < 0)
 			return NULL;
-
-		/* lseek returns the offset from the beginning of the file */
-		size = lseek(fd, 0, SEEK_END);
-		if (size <= 0)
-			goto fail;
-
-		/* we don't need to lseek again as mmap ignores the offset */
-		data = (char *)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
-		if (data == MAP_FAILED)
-			data = NULL;
-	fail:
+		data = map_fd(fd, &size, writable);
 		::close(fd);
 
 	#else /* !_WIN32 && !HAVE_MMAP */
-		FILE *fd = fopen(path, "rb");
+		FILE *fd = fopen(path, writable?"r+b":"rb");
 		if (!fd)
 			return NULL;
 
@@ -135,9 +135,14 @@ private:
 			free(data);
 			data = NULL;
 		}
-
+		/* keep the file open so flush() can write changes back */
+		if (data && writable) {
+			*ppfile = fd;
+			fd = NULL;
+		}
 	fail:
-		fclose(fd);
+		if (fd)
+			fclose(fd);
 	#endif /* !_WIN32 && !HAVE_MMAP */
 
 		if (psize)
@@ -145,6 +150,26 @@ private:
 		return data;
 	}
 
+#if HAVE_MMAP
+	/*!
+	* Maps a file that's already open. The descriptor can be closed afterwards.
+	* \return the pointer to the mapping. On failure NULL is returned.
+	*/
+	static char *map_fd(int fd, size_t *psize, bool writable) {
+		/* lseek returns the offset from the beginning of the file */
+		off_t end = lseek(fd, 0, SEEK_END);
+		/* files too big for the address space need WindowedMappedLexSource */
+		if (end <= 0 || (unsigned long long)end > (size_t)-1)
+			return NULL;
+		/* we don't need to lseek again as mmap ignores the offset */
+		char *data = (char *)mmap(NULL, (size_t)end, writable?(PROT_READ|PROT_WRITE):PROT_READ, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED)
+			return NULL;
+		*psize = (size_t)end;
+		return data;
+	}
+#endif
+
 	/*! Releases memory allocated by map_file().
 	* \param data the pointer returned by map_file().
 	* \param length the length returned by map_file().
@@ -160,7 +185,7 @@ private:
 	#endif /* !_WIN32 && !HAVE_MMAP */
 	}
 
-    MappedFile(const MappedFile&) : m_size(), m_pdata() {}
+    MappedFile(const MappedFile&) : m_size(), m_pdata(), m_writable(false) {}
 	MappedFile& operator=(const MappedFile&) { return *this; }
 
 public:
@@ -170,20 +195,69 @@ public:
 	 * \param path path of the file being mapped
 	 * \exception IOException the file couldn't be opened
 	 */
-	MappedFile()  : m_size(), m_pdata() {
-		
+	MappedFile()  : m_size(), m_pdata(), m_writable(false) {
+#if !defined(_WIN32) && !HAVE_MMAP
+		m_pfile = nullptr;
+#endif
 	}
 	bool open(const char* path) {
+		return open(path,false);
+	}
+	/*!
+	 * Maps the named file, optionally for writing.
+	 * Writes to a writable mapping are shared with the file.
+	 */
+	bool open(const char* path,bool writable) {
+		if(nullptr!=m_pdata)
+			return false;
+		void* pfile = nullptr;
+		m_pdata = map_file(path, &m_size, writable, &pfile);
+#if !defined(_WIN32) && !HAVE_MMAP
+		m_pfile = (FILE*)pfile;
+#endif
+		m_writable = writable && nullptr!=m_pdata;
+		return nullptr!=m_pdata;
+	}
+#if HAVE_MMAP
+	/*!
+	 * Maps a file that's already open, read-only. The descriptor stays the caller's.
+	 */
+	bool open(int fd) {
 		if(nullptr!=m_pdata)
 			return false;
-		m_pdata = map_file(path, &m_size);
+		m_pdata = map_fd(fd, &m_size, false);
+		m_writable = false;
 		return nullptr!=m_pdata;
 	}
+#endif
+	/*!
+	 * Commits changes made to a writable mapping to the file.
+	 */
+	bool flush() {
+		if(nullptr==m_pdata || !m_writable)
+			return false;
+	#ifdef _WIN32
+		return 0!=FlushViewOfFile(m_pdata, m_size);
+	#elif HAVE_MMAP
+		return 0==msync(m_pdata, m_size, MS_SYNC);
+	#else /* !_WIN32 && !HAVE_MMAP */
+		rewind(m_pfile);
+		return 1==fwrite(m_pdata, m_size, 1, m_pfile) && 0==fflush(m_pfile);
+	#endif /* !_WIN32 && !HAVE_MMAP */
+	}
 	void close() {
 		if(nullptr!=m_pdata) {
+#if !defined(_WIN32) && !HAVE_MMAP
+			if(m_writable) {
+				flush();
+				fclose(m_pfile);
+				m_pfile = nullptr;
+			}
+#endif
 			unmap_file(m_pdata, m_size);
 			m_size = 0;
 			m_pdata = nullptr;
+			m_writable = false;
 		}
 	}
 	/*!
@@ -201,6 +275,11 @@ public:
 	inline size_t size() const { return m_size; }
 	
 	inline const char* data() {return m_pdata;}
+	/*!
+	 * Get the data for writing, or NULL if the mapping is read-only.
+	 */
+	inline char* writableData() {return m_writable?m_pdata:nullptr;}
+	inline bool writable() const { return m_writable; }
 };
 }
 #endif // ARDUINO
@@ -35,14 +35,26 @@ protected:
         // TODO: i *think* the memory mapped region is padded with zeroes
         // we're always one ahead of where we want to start searching
         const char*sz=strpbrk(m_cur-1, characters7bit);
+        LexSink* ptee = tee();
+        // the tee hasn't seen the current character yet
+        const char* pteed = m_cur-(0<current()?currentLength():0);
         if(nullptr==sz) {
+            if(nullptr!=ptee && !ptee->write(pteed,(m_start+m_mapped.size())-pteed)) {
+                match = 0;
+                error = IOError;
+                return false;
+            }
             // advance everything to the end since we found jack
             position+=m_mapped.size()-(m_cur-m_start);
             m_cur = m_start+m_mapped.size();
             error = EndOfInput;
             return false;
         }
-        
+        if(nullptr!=ptee && sz>pteed && !ptee->write(pteed,sz-pteed)) {
+            match = 0;
+            error = IOError;
+            return false;
+        }
         match = *sz;
         m_cur = sz+1;
         position = m_cur - m_start;
@@ -54,16 +66,48 @@ public:
        
     }
     ~MemoryMappedLexSource() override {}
-    
-    bool open(const char* filename) {
+    bool peekString(const char** pstart,size_t* psize) override {
+        if(nullptr==m_start || '\"'!=current())
+            return false;
+        size_t remaining = m_mapped.size()-(m_cur-m_start);
+        const char* sz = (const char*)memchr(m_cur,'\"',remaining);
+        if(nullptr==sz || nullptr!=memchr(m_cur,'\\',sz-m_cur))
+            return false;
+        *pstart = m_cur;
+        *psize = sz-m_cur;
+        return true;
+    }
+
+    // opens the file, optionally mapping it for writing so values can be patched
+    bool open(const char* filename,bool writable=false) {
         if(nullptr!=m_start)
             return false;
-        if(!m_mapped.open(filename))
+        if(!m_mapped.open(filename,writable))
             return false;
         reset();
         m_cur = m_start = m_mapped.data();
         return true;
     }   
+    // overwrites the length bytes at offset with the lexical text, padding what's left with spaces.
+    // the file must be open for writing and the text must fit.
+    // use JsonReader::skipSubtree(offset,length) to find a value's span
+    bool patch(unsigned long long offset,size_t length,const char* lexical) {
+        char* pdata = m_mapped.writableData();
+        if(nullptr==pdata || nullptr==lexical)
+            return false;
+        if(offset>m_mapped.size() || length>m_mapped.size()-offset)
+            return false;
+        size_t c = strlen(lexical);
+        if(c>length)
+            return false;
+        memcpy(pdata+offset,lexical,c);
+        memset(pdata+offset+c,' ',length-c);
+        return true;
+    }
+    // commits patches to the file
+    bool flush() {
+        return m_mapped.flush();
+    }
     
     void close() {
         if(m_mapped.open()) {
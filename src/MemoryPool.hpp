@@ -29,6 +29,13 @@ namespace mem {
         virtual size_t capacity() const =0;
         // indicates how many bytes are currently used
         virtual size_t used() const=0;
+        // marks how much of the pool is in use, so it can be rolled back to that later
+        size_t savepoint() const { return used(); }
+        // frees everything allocated since the savepoint
+        void restore(size_t savepoint) {
+            if(used()>savepoint)
+                unalloc(used()-savepoint);
+        }
         virtual ~MemoryPool() {}
     };
 
@@ -160,5 +167,60 @@ namespace mem {
         size_t used() const override { return m_next-m_heap;}
         ~DynamicMemoryPool() { if(nullptr!=m_heap) delete m_heap;}
     };
+    // represents a memory pool over a buffer supplied by the caller
+    class BufferMemoryPool : public MemoryPool {
+        // the actual buffer
+        uint8_t *m_heap;
+        // the capacity
+        size_t m_capacity;
+        // the next free pointer
+        uint8_t *m_next;
+        BufferMemoryPool(const BufferMemoryPool& rhs) = delete;
+        BufferMemoryPool(const BufferMemoryPool&& rhs) = delete;
+        BufferMemoryPool& operator=(const BufferMemoryPool& rhs) = delete;
+    public:
+        BufferMemoryPool() : m_heap(nullptr),m_capacity(0),m_next(nullptr) {}
+        BufferMemoryPool(void* buffer,size_t capacity) {
+            attach(buffer,capacity);
+        }
+        // points the pool at a buffer, emptying it. the buffer must outlive its use
+        void attach(void* buffer,size_t capacity) {
+            m_heap = m_next = (uint8_t*)buffer;
+            m_capacity = (nullptr==buffer)?0:capacity;
+        }
+        // allocates the specified number of bytes
+        // returns nullptr if there's not enough free
+        void* alloc(const size_t size) override {
+            if(nullptr==m_heap || used()+size>m_capacity)
+                return nullptr;
+            void* result = m_next;
+            m_next+=size;
+            return result;
+        }
+        // unallocates the most recently allocated bytes of the specified size
+        // returns nullptr if failed, or the new next()
+        void* unalloc(size_t size) override {
+            if(size>used()) return nullptr;
+            m_next-=size;
+            return m_next;
+        }
+        // invalidates all the pointers in the pool and frees the memory
+        void freeAll() override {
+            m_next = m_heap;
+        }
+        // retrieves the base pointer for the pool
+        void* base() override {
+            return m_heap;
+        }
+        // retrieves the next pointer that will be allocated
+        // (for optimization opportunities)
+        void* next() const override {
+            return m_next;
+        }
+        // indicates the maximum capacity of the pool
+        size_t capacity() const override { return m_capacity; }
+        // indicates how many bytes are currently used
+        size_t used() const override { return m_next-m_heap;}
+    };
 }
 #endif
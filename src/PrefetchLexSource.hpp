@@ -0,0 +1,233 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_PREFETCH_LEXSOURCE_HPP
+#define HTCW_PREFETCH_LEXSOURCE_HPP
+// there are no threads to read on without an OS
+#ifndef ARDUINO
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "LexSource.hpp"
+// the size of each block read ahead of the parser
+#ifndef JSON_PREFETCH_BLOCK_SIZE
+#define JSON_PREFETCH_BLOCK_SIZE (256*1024)
+#endif
+// the number of blocks in the ring between the reading thread and the parser
+#ifndef JSON_PREFETCH_BLOCKS
+#define JSON_PREFETCH_BLOCKS 4
+#endif
+namespace lex {
+// reads a file on a thread of its own so the disk and the parser work at the same time.
+// filled blocks are handed to the parser through a ring with one writer and one reader,
+// and the parser hands each back once it has moved past it. a side that has to wait for
+// the other sleeps on a condition variable
+class PrefetchLexSource : public virtual LexSource {
+    FILE* m_pfile;
+    char* m_pblocks;
+    size_t* m_psizes;
+    size_t m_blockSize;
+    size_t m_blockCount;
+    // the blocks filled so far, written by the reading thread
+    std::atomic<size_t> m_filled;
+    // the blocks handed back so far, written by the parser
+    std::atomic<size_t> m_consumed;
+    std::atomic<bool> m_done;
+    std::atomic<bool> m_failed;
+    std::atomic<bool> m_stop;
+    // guards the counts and flags while either side waits on them
+    std::mutex m_lock;
+    std::condition_variable m_changed;
+    std::thread m_thread;
+    // the unread part of the block the parser is in
+    const char* m_cur;
+    const char* m_end;
+    PrefetchLexSource(PrefetchLexSource& rhs)=delete;
+    PrefetchLexSource(PrefetchLexSource&& rhs)=delete;
+    PrefetchLexSource& operator=(PrefetchLexSource& rhs)=delete;
+    // updates a count or flag the other side may be waiting on
+    template<typename T> void publish(std::atomic<T>& value,T newValue) {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            value.store(newValue,std::memory_order_release);
+        }
+        m_changed.notify_one();
+    }
+    void fill() {
+        size_t filled = 0;
+        while(true) {
+            // wait for the parser to hand a block back when the ring is full
+            if(filled-m_consumed.load(std::memory_order_acquire)==m_blockCount) {
+                std::unique_lock<std::mutex> lock(m_lock);
+                m_changed.wait(lock,[&]() {
+                    return m_stop.load() || filled-m_consumed.load()<m_blockCount;
+                });
+            }
+            if(m_stop.load(std::memory_order_relaxed))
+                break;
+            size_t i = filled%m_blockCount;
+            size_t c = fread(m_pblocks+i*m_blockSize,1,m_blockSize,m_pfile);
+            if(0<c) {
+                m_psizes[i] = c;
+                publish(m_filled,++filled);
+            }
+            if(c<m_blockSize) {
+                if(ferror(m_pfile))
+                    m_failed = true;
+                break;
+            }
+        }
+        publish(m_done,true);
+    }
+    // hands back the current block and waits for the next. returns false at the end
+    bool nextBlock() {
+        size_t consumed = m_consumed.load(std::memory_order_relaxed);
+        if(nullptr!=m_cur)
+            publish(m_consumed,++consumed);
+        m_cur = m_end = nullptr;
+        if(m_filled.load(std::memory_order_acquire)==consumed) {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_changed.wait(lock,[&]() {
+                return m_filled.load()!=consumed || m_done.load();
+            });
+            // the last block may have been filled just before the end was flagged
+            if(m_filled.load()==consumed)
+                return false;
+        }
+        size_t i = consumed%m_blockCount;
+        m_cur = m_pblocks+i*m_blockSize;
+        m_end = m_cur+m_psizes[i];
+        return true;
+    }
+protected:
+    int16_t read() final {
+        if(nullptr==m_pfile)
+            return LexSource::Closed;
+        if(m_cur==m_end && !nextBlock())
+            return m_failed?LexSource::IOError:LexSource::EndOfInput;
+        return (unsigned char)*(m_cur++);
+    }
+    bool skipToAny(const char* characters7bit,unsigned long long& position,int16_t& match,int8_t& error) final {
+        if(nullptr==m_pfile) {
+            match = 0;
+            error = Closed;
+            return false;
+        }
+        // the current character may be in a block we've handed back, so the tee gets the
+        // slow path
+        if(nullptr!=tee())
+            return LexSource::skipToAny(characters7bit,position,match,error);
+        // bytes past 127 are looked up too, and are never in the set
+        uint32_t set[8] = {0,0,0,0,0,0,0,0};
+        for(const char* sz = characters7bit;0!=*sz;++sz)
+            set[((uint8_t)*sz)>>5]|=((uint32_t)1)<<(*sz&31);
+        int32_t cur = current();
+        if(0<cur && 128>cur && 0!=(set[cur>>5]&(((uint32_t)1)<<(cur&31)))) {
+            match = (int16_t)cur;
+            error = 0;
+            return true;
+        }
+        while(true) {
+            const char* sz = m_cur;
+            while(sz<m_end && 0==(set[((uint8_t)*sz)>>5]&(((uint32_t)1)<<(*sz&31))))
+                ++sz;
+            if(sz<m_end) {
+                match = *sz;
+                position += (sz-m_cur)+1;
+                m_cur = sz+1;
+                error = 0;
+                return true;
+            }
+            position += m_end-m_cur;
+            m_cur = m_end;
+            if(!nextBlock()) {
+                match = 0;
+                error = m_failed?IOError:EndOfInput;
+                return false;
+            }
+        }
+    }
+public:
+    PrefetchLexSource() :
+            m_pfile(nullptr),
+            m_pblocks(nullptr),
+            m_psizes(nullptr),
+            m_blockSize(0),
+            m_blockCount(0),
+            m_filled(0),
+            m_consumed(0),
+            m_done(false),
+            m_failed(false),
+            m_stop(false),
+            m_cur(nullptr),
+            m_end(nullptr) {
+    }
+    ~PrefetchLexSource() override {
+        close();
+    }
+    bool peekString(const char** pstart,size_t* psize) override {
+        if(nullptr==m_cur || '\"'!=current())
+            return false;
+        // only strings that end in the same block can be peeked
+        const char* sz = (const char*)memchr(m_cur,'\"',m_end-m_cur);
+        if(nullptr==sz || nullptr!=memchr(m_cur,'\\',sz-m_cur))
+            return false;
+        *pstart = m_cur;
+        *psize = sz-m_cur;
+        return true;
+    }
+    // opens the file and starts reading it ahead of the parser
+    bool open(const char* filename,size_t blockSize=JSON_PREFETCH_BLOCK_SIZE,size_t blockCount=JSON_PREFETCH_BLOCKS) {
+        if(nullptr!=m_pfile || nullptr==filename || 0==blockSize || 0==blockCount)
+            return false;
+        m_pblocks = (char*)malloc(blockSize*blockCount);
+        m_psizes = (size_t*)malloc(blockCount*sizeof(size_t));
+        if(nullptr==m_pblocks || nullptr==m_psizes) {
+            close();
+            return false;
+        }
+        m_pfile = fopen(filename,"rb");
+        if(nullptr==m_pfile) {
+            close();
+            return false;
+        }
+        // we read whole blocks, so stdio's buffer would only be an extra copy
+        setvbuf(m_pfile,nullptr,_IONBF,0);
+        reset();
+        m_blockSize = blockSize;
+        m_blockCount = blockCount;
+        m_filled = 0;
+        m_consumed = 0;
+        m_done = false;
+        m_failed = false;
+        m_stop = false;
+        m_cur = m_end = nullptr;
+        m_thread = std::thread(&PrefetchLexSource::fill,this);
+        return true;
+    }
+    void close() {
+        if(m_thread.joinable()) {
+            publish(m_stop,true);
+            m_thread.join();
+        }
+        if(nullptr!=m_pfile) {
+            fclose(m_pfile);
+            m_pfile = nullptr;
+        }
+        free(m_pblocks);
+        free(m_psizes);
+        m_pblocks = nullptr;
+        m_psizes = nullptr;
+        m_cur = m_end = nullptr;
+    }
+};
+template<size_t TCapacity> class StaticPrefetchLexSource : public StaticLexSource<TCapacity>, public virtual PrefetchLexSource {
+
+};
+}
+#endif
+#endif
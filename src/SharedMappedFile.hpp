@@ -0,0 +1,178 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_SHARED_MAPPED_FILE_HPP
+#define HTCW_SHARED_MAPPED_FILE_HPP
+#ifndef ARDUINO
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <mutex>
+#include "MappedFile.hpp"
+namespace mem {
+// a read-only mapping of a file shared by everyone who opens the same path, so concurrent
+// readers of a hot file share one mapping. mappings are cached by path, device, inode, size
+// and modification time to the nanosecond, taken from the opened file, and unmapped when the
+// last holder closes them. a file that's changed since it was mapped gets a new mapping, and
+// holders of the old one keep theirs until they close it
+class SharedMappedFile {
+    // what identifies a file and its version
+    struct Key {
+        unsigned long long device;
+        unsigned long long inode;
+        unsigned long long size;
+        long long mtime;
+        long long mtimeNanoseconds;
+        bool same(const Key& rhs) const {
+            return device==rhs.device && inode==rhs.inode;
+        }
+        bool unchanged(const Key& rhs) const {
+            return size==rhs.size && mtime==rhs.mtime && mtimeNanoseconds==rhs.mtimeNanoseconds;
+        }
+    };
+    struct Entry {
+        MappedFile file;
+        char* path;
+        Key key;
+        size_t refs;
+        // whether opens can still find this one
+        bool cached;
+        Entry* pnext;
+    };
+    Entry* m_pentry;
+    SharedMappedFile(const SharedMappedFile& rhs)=delete;
+    SharedMappedFile& operator=(const SharedMappedFile& rhs)=delete;
+    static std::mutex& lock() {
+        static std::mutex result;
+        return result;
+    }
+    static Entry*& entries() {
+        static Entry* result = nullptr;
+        return result;
+    }
+    static void unlink(Entry* pentry) {
+        Entry** pp = &entries();
+        while(nullptr!=*pp && pentry!=*pp)
+            pp = &(*pp)->pnext;
+        if(nullptr!=*pp)
+            *pp = pentry->pnext;
+        pentry->cached = false;
+    }
+    static void release(Entry* pentry) {
+        pentry->file.close();
+        free(pentry->path);
+        delete pentry;
+    }
+    static Key key(const struct stat& st) {
+        Key result;
+        result.device = (unsigned long long)st.st_dev;
+        result.inode = (unsigned long long)st.st_ino;
+        result.size = (unsigned long long)st.st_size;
+        result.mtime = (long long)st.st_mtime;
+#if defined(__APPLE__)
+        result.mtimeNanoseconds = (long long)st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+        // only seconds, and no inode
+        result.mtimeNanoseconds = 0;
+#else
+        result.mtimeNanoseconds = (long long)st.st_mtim.tv_nsec;
+#endif
+        return result;
+    }
+    // finds the mapping of the file, adding a reference, or drops a stale one. holds the lock
+    static Entry* find(const char* path,const Key& k) {
+        for(Entry* pentry = entries();nullptr!=pentry;pentry = pentry->pnext) {
+            if(0!=strcmp(path,pentry->path))
+                continue;
+            if(pentry->key.same(k) && pentry->key.unchanged(k)) {
+                ++pentry->refs;
+                return pentry;
+            }
+            // it changed or was replaced, so it's mapped again. its holders keep the old one
+            unlink(pentry);
+            break;
+        }
+        return nullptr;
+    }
+    // maps the file into a new entry, and caches it. holds the lock
+    template<typename TFile> static Entry* add(const char* path,TFile file,const Key& k) {
+        Entry* pentry = new Entry();
+        pentry->path = (char*)malloc(strlen(path)+1);
+        if(nullptr==pentry->path || !pentry->file.open(file)) {
+            release(pentry);
+            return nullptr;
+        }
+        strcpy(pentry->path,path);
+        pentry->key = k;
+        pentry->refs = 1;
+        pentry->cached = true;
+        pentry->pnext = entries();
+        entries() = pentry;
+        return pentry;
+    }
+public:
+    SharedMappedFile() : m_pentry(nullptr) {
+    }
+    ~SharedMappedFile() {
+        close();
+    }
+    // maps the file, or shares the mapping others have of it if it hasn't changed since
+    bool open(const char* path) {
+        if(nullptr!=m_pentry || nullptr==path)
+            return false;
+        struct stat st;
+#if HAVE_MMAP
+        // the key comes from the descriptor that's mapped, so it's the same file
+        int fd = ::open(path,O_RDONLY);
+        if(0>fd)
+            return false;
+        bool result = false;
+        if(0==fstat(fd,&st)) {
+            Key k = key(st);
+            std::lock_guard<std::mutex> guard(lock());
+            m_pentry = find(path,k);
+            if(nullptr==m_pentry)
+                m_pentry = add(path,fd,k);
+            result = nullptr!=m_pentry;
+        }
+        ::close(fd);
+        return result;
+#else
+        // without mmap the file is opened by path, so the key is taken with the lock held
+        std::lock_guard<std::mutex> guard(lock());
+        if(0!=stat(path,&st))
+            return false;
+        Key k = key(st);
+        m_pentry = find(path,k);
+        if(nullptr==m_pentry)
+            m_pentry = add(path,path,k);
+        return nullptr!=m_pentry;
+#endif
+    }
+    // lets go of the mapping, unmapping it if no one else holds it
+    void close() {
+        if(nullptr==m_pentry)
+            return;
+        std::lock_guard<std::mutex> guard(lock());
+        if(0==--m_pentry->refs) {
+            if(m_pentry->cached)
+                unlink(m_pentry);
+            release(m_pentry);
+        }
+        m_pentry = nullptr;
+    }
+    inline bool open() const { return nullptr!=m_pentry; }
+    inline size_t size() const { return (nullptr==m_pentry)?0:m_pentry->file.size(); }
+    inline const char* data() const { return (nullptr==m_pentry)?nullptr:m_pentry->file.data(); }
+    // indicates how many holders the mapping has, including this one
+    size_t holders() const {
+        if(nullptr==m_pentry)
+            return 0;
+        std::lock_guard<std::mutex> guard(lock());
+        return m_pentry->refs;
+    }
+};
+}
+#endif
+#endif
@@ -0,0 +1,46 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_SHARED_MAPPED_LEXSOURCE_HPP
+#define HTCW_SHARED_MAPPED_LEXSOURCE_HPP
+#ifndef ARDUINO
+#include "SharedMappedFile.hpp"
+#include "LexSource.hpp"
+namespace lex {
+// a cursor over a mapping shared with every other source open on the same file. each source
+// has its own position and capture buffer, so use one per thread
+class SharedMappedLexSource : public virtual SpanLexSource {
+    mem::SharedMappedFile m_file;
+    SharedMappedLexSource(SharedMappedLexSource& rhs)=delete;
+    SharedMappedLexSource(SharedMappedLexSource&& rhs)=delete;
+    SharedMappedLexSource& operator=(SharedMappedLexSource& rhs)=delete;
+public:
+    SharedMappedLexSource() {
+    }
+    ~SharedMappedLexSource() override {
+        close();
+    }
+    bool open(const char* filename) {
+        if(m_file.open() || !m_file.open(filename))
+            return false;
+        if(!attach(m_file.data(),m_file.size())) {
+            m_file.close();
+            return false;
+        }
+        return true;
+    }
+    void close() {
+        if(m_file.open()) {
+            detach();
+            m_file.close();
+        }
+    }
+    // the mapping, for handing offsets and lengths from skipSubtree() to other code
+    const mem::SharedMappedFile& file() const { return m_file; }
+};
+template<size_t TCapacity> class StaticSharedMappedLexSource : public StaticLexSource<TCapacity>, public virtual SharedMappedLexSource {
+
+};
+}
+#endif
+#endif
@@ -0,0 +1,545 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_URING_LEXSOURCE_HPP
+#define HTCW_URING_LEXSOURCE_HPP
+// this needs POSIX file I/O, and io_uring when it's Linux
+#if !defined(ARDUINO) && !defined(_WIN32)
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#if defined(__linux__) && !defined(JSON_NO_URING)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#define HTCW_URING 1
+#endif
+#include "LexSource.hpp"
+// the size of each read
+#ifndef JSON_URING_BLOCK_SIZE
+#define JSON_URING_BLOCK_SIZE (256*1024)
+#endif
+// the number of blocks a queue shares among its sources by default
+#ifndef JSON_URING_BLOCKS
+#define JSON_URING_BLOCKS 64
+#endif
+// the most reads a source can have in flight
+#ifndef JSON_URING_MAX_DEPTH
+#define JSON_URING_MAX_DEPTH 16
+#endif
+// the reads a source has in flight by default
+#ifndef JSON_URING_DEPTH
+#define JSON_URING_DEPTH 4
+#endif
+namespace lex {
+class UringLexSource;
+// shares one io_uring and a pool of registered buffers among the UringLexSources read from
+// one thread, so reads against many files can be in flight at once. where io_uring isn't
+// available, reads are done with pread() as they're issued
+class UringQueue {
+    friend class UringLexSource;
+    // a read a source is waiting on
+    struct Request {
+        size_t block;
+        uint64_t offset;
+        size_t size;
+        int32_t result;
+        bool done;
+    };
+    int m_ring;
+    bool m_fixed;
+    char* m_pbuffers;
+    size_t m_blockSize;
+    size_t m_blockCount;
+    size_t* m_pfree;
+    size_t m_freeCount;
+    // the blocks the open sources may hold at once. a source can't open unless they all fit,
+    // so a source never waits on blocks another is holding
+    size_t m_committed;
+    struct iovec* m_piovecs;
+    // queued but not yet submitted
+    unsigned m_pending;
+#ifdef HTCW_URING
+    void* m_psqMap;
+    size_t m_sqMapSize;
+    void* m_pcqMap;
+    size_t m_cqMapSize;
+    struct io_uring_sqe* m_psqes;
+    size_t m_sqesSize;
+    unsigned* m_psqTail;
+    unsigned* m_psqMask;
+    unsigned* m_psqArray;
+    unsigned* m_pcqHead;
+    unsigned* m_pcqTail;
+    unsigned* m_pcqMask;
+    struct io_uring_cqe* m_pcqes;
+#endif
+    UringQueue(const UringQueue& rhs)=delete;
+    UringQueue& operator=(const UringQueue& rhs)=delete;
+    static bool readAll(int fd,char* pbuffer,size_t size,uint64_t offset,size_t& read) {
+        read = 0;
+        while(read<size) {
+            ssize_t c = pread(fd,pbuffer+read,size-read,(off_t)(offset+read));
+            if(0>c) {
+                if(EINTR==errno)
+                    continue;
+                return false;
+            }
+            if(0==c)
+                break;
+            read+=(size_t)c;
+        }
+        return true;
+    }
+#ifdef HTCW_URING
+    bool setup(unsigned entries) {
+        struct io_uring_params params;
+        memset(&params,0,sizeof(params));
+        int fd = (int)syscall(__NR_io_uring_setup,entries,&params);
+        if(0>fd)
+            return false;
+        m_ring = fd;
+        m_sqMapSize = params.sq_off.array+params.sq_entries*sizeof(unsigned);
+        m_cqMapSize = params.cq_off.cqes+params.cq_entries*sizeof(struct io_uring_cqe);
+        // newer kernels map both rings at once
+        if(0!=(params.features&IORING_FEAT_SINGLE_MMAP)) {
+            if(m_cqMapSize>m_sqMapSize)
+                m_sqMapSize = m_cqMapSize;
+            m_cqMapSize = 0;
+        }
+        m_psqMap = mmap(nullptr,m_sqMapSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_SQ_RING);
+        if(MAP_FAILED==m_psqMap) {
+            m_psqMap = nullptr;
+            return false;
+        }
+        if(0==m_cqMapSize)
+            m_pcqMap = m_psqMap;
+        else {
+            m_pcqMap = mmap(nullptr,m_cqMapSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_CQ_RING);
+            if(MAP_FAILED==m_pcqMap) {
+                m_pcqMap = nullptr;
+                return false;
+            }
+        }
+        m_sqesSize = params.sq_entries*sizeof(struct io_uring_sqe);
+        void* psqes = mmap(nullptr,m_sqesSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_SQES);
+        if(MAP_FAILED==psqes)
+            return false;
+        m_psqes = (struct io_uring_sqe*)psqes;
+        char* psq = (char*)m_psqMap;
+        m_psqTail = (unsigned*)(psq+params.sq_off.tail);
+        m_psqMask = (unsigned*)(psq+params.sq_off.ring_mask);
+        m_psqArray = (unsigned*)(psq+params.sq_off.array);
+        char* pcq = (char*)m_pcqMap;
+        m_pcqHead = (unsigned*)(pcq+params.cq_off.head);
+        m_pcqTail = (unsigned*)(pcq+params.cq_off.tail);
+        m_pcqMask = (unsigned*)(pcq+params.cq_off.ring_mask);
+        m_pcqes = (struct io_uring_cqe*)(pcq+params.cq_off.cqes);
+        // registered buffers save the kernel mapping them on every read, but they count
+        // against the locked memory limit, so reads fall back to plain vectors
+        m_fixed = 0==syscall(__NR_io_uring_register,fd,IORING_REGISTER_BUFFERS,m_piovecs,(unsigned)m_blockCount);
+        return true;
+    }
+    void teardown() {
+        if(nullptr!=m_psqes)
+            munmap(m_psqes,m_sqesSize);
+        if(nullptr!=m_pcqMap && m_pcqMap!=m_psqMap)
+            munmap(m_pcqMap,m_cqMapSize);
+        if(nullptr!=m_psqMap)
+            munmap(m_psqMap,m_sqMapSize);
+        if(-1<m_ring)
+            ::close(m_ring);
+        m_psqes = nullptr;
+        m_psqMap = m_pcqMap = nullptr;
+        m_ring = -1;
+        m_fixed = false;
+    }
+    // takes the completions that are in, without a system call
+    void reap() {
+        unsigned head = *m_pcqHead;
+        unsigned tail = __atomic_load_n(m_pcqTail,__ATOMIC_ACQUIRE);
+        while(head!=tail) {
+            struct io_uring_cqe& cqe = m_pcqes[head&*m_pcqMask];
+            Request* preq = (Request*)(uintptr_t)cqe.user_data;
+            preq->result = cqe.res;
+            preq->done = true;
+            ++head;
+        }
+        __atomic_store_n(m_pcqHead,head,__ATOMIC_RELEASE);
+    }
+    bool enter(unsigned submit,unsigned wait) {
+        while(0>syscall(__NR_io_uring_enter,m_ring,submit,wait,(0<wait)?IORING_ENTER_GETEVENTS:0,nullptr,0)) {
+            if(EINTR!=errno)
+                return false;
+            // the submissions went in before the wait was interrupted
+            submit = 0;
+        }
+        return true;
+    }
+#endif
+    char* block(size_t index) const { return m_pbuffers+index*m_blockSize; }
+    bool take(size_t& block) {
+        if(0==m_freeCount)
+            return false;
+        block = m_pfree[--m_freeCount];
+        return true;
+    }
+    void give(size_t block) {
+        m_pfree[m_freeCount++] = block;
+    }
+    // queues a read into the request's block
+    void issue(int fd,Request& req) {
+        req.done = false;
+        req.result = 0;
+#ifdef HTCW_URING
+        if(-1<m_ring) {
+            // every request holds a block, and there are no more blocks than entries, so
+            // there's always room
+            unsigned tail = *m_psqTail;
+            unsigned index = tail&*m_psqMask;
+            struct io_uring_sqe& sqe = m_psqes[index];
+            memset(&sqe,0,sizeof(sqe));
+            sqe.fd = fd;
+            sqe.off = req.offset;
+            if(m_fixed) {
+                sqe.opcode = IORING_OP_READ_FIXED;
+                sqe.addr = (uint64_t)(uintptr_t)block(req.block);
+                sqe.len = (uint32_t)req.size;
+                sqe.buf_index = (uint16_t)req.block;
+            } else {
+                sqe.opcode = IORING_OP_READV;
+                m_piovecs[req.block].iov_len = req.size;
+                sqe.addr = (uint64_t)(uintptr_t)(m_piovecs+req.block);
+                sqe.len = 1;
+            }
+            sqe.user_data = (uint64_t)(uintptr_t)&req;
+            m_psqArray[index] = index;
+            __atomic_store_n(m_psqTail,tail+1,__ATOMIC_RELEASE);
+            ++m_pending;
+            return;
+        }
+#endif
+        size_t read;
+        req.result = readAll(fd,block(req.block),req.size,req.offset,read)?(int32_t)read:-EIO;
+        req.done = true;
+    }
+    // waits for the request to finish, submitting anything queued in the same call
+    bool wait(Request& req) {
+#ifdef HTCW_URING
+        while(!req.done) {
+            reap();
+            if(req.done)
+                break;
+            unsigned pending = m_pending;
+            m_pending = 0;
+            if(!enter(pending,1))
+                return false;
+        }
+#else
+        (void)req;
+#endif
+        return true;
+    }
+public:
+    UringQueue() :
+            m_ring(-1),
+            m_fixed(false),
+            m_pbuffers(nullptr),
+            m_blockSize(0),
+            m_blockCount(0),
+            m_pfree(nullptr),
+            m_freeCount(0),
+            m_committed(0),
+            m_piovecs(nullptr),
+            m_pending(0)
+#ifdef HTCW_URING
+            ,m_psqMap(nullptr),
+            m_sqMapSize(0),
+            m_pcqMap(nullptr),
+            m_cqMapSize(0),
+            m_psqes(nullptr),
+            m_sqesSize(0)
+#endif
+            {
+    }
+    ~UringQueue() {
+        close();
+    }
+    // allocates the blocks and sets up the ring. pass false for useUring to always use pread()
+    bool open(size_t blockCount=JSON_URING_BLOCKS,size_t blockSize=JSON_URING_BLOCK_SIZE,bool useUring=true) {
+        if(nullptr!=m_pbuffers || 0==blockCount || 0==blockSize || 0xFFFF<blockCount || 0x7FFFFFFF<blockSize)
+            return false;
+        void* pbuffers;
+        if(0!=posix_memalign(&pbuffers,4096,blockCount*blockSize))
+            return false;
+        m_pbuffers = (char*)pbuffers;
+        m_pfree = (size_t*)malloc(blockCount*sizeof(size_t));
+        m_piovecs = (struct iovec*)malloc(blockCount*sizeof(struct iovec));
+        if(nullptr==m_pfree || nullptr==m_piovecs) {
+            close();
+            return false;
+        }
+        m_blockSize = blockSize;
+        m_blockCount = blockCount;
+        for(size_t i = 0;i<blockCount;++i) {
+            m_pfree[i] = blockCount-i-1;
+            m_piovecs[i].iov_base = block(i);
+            m_piovecs[i].iov_len = blockSize;
+        }
+        m_freeCount = blockCount;
+        m_committed = 0;
+        m_pending = 0;
+#ifdef HTCW_URING
+        if(useUring && !setup((unsigned)blockCount))
+            teardown();
+#else
+        (void)useUring;
+#endif
+        return true;
+    }
+    // closes the queue. every source using it must be closed first
+    void close() {
+#ifdef HTCW_URING
+        teardown();
+#endif
+        free(m_pbuffers);
+        free(m_pfree);
+        free(m_piovecs);
+        m_pbuffers = nullptr;
+        m_pfree = nullptr;
+        m_piovecs = nullptr;
+        m_blockSize = 0;
+        m_blockCount = 0;
+        m_freeCount = 0;
+    }
+    // indicates whether reads go through io_uring rather than pread()
+    bool uring() const { return -1<m_ring; }
+    // indicates whether the blocks are registered with the ring
+    bool registered() const { return m_fixed; }
+    // starts the reads queued so far without waiting on them
+    bool submit() {
+#ifdef HTCW_URING
+        if(-1<m_ring && 0<m_pending) {
+            unsigned pending = m_pending;
+            m_pending = 0;
+            return enter(pending,0);
+        }
+#endif
+        return true;
+    }
+};
+// reads a file through a UringQueue, keeping reads of the blocks ahead of the parser in
+// flight. blocks are delivered in file order. open many on the same queue to read many
+// files at once from one thread
+class UringLexSource : public virtual LexSource {
+    UringQueue* m_pqueue;
+    int m_fd;
+    uint64_t m_size;
+    // where the next read starts
+    uint64_t m_offset;
+    size_t m_depth;
+    // the reads in flight, oldest first
+    UringQueue::Request m_requests[JSON_URING_MAX_DEPTH];
+    size_t m_first;
+    size_t m_count;
+    // the block the parser is in
+    size_t m_block;
+    const char* m_cur;
+    const char* m_end;
+    bool m_failed;
+    UringLexSource(UringLexSource& rhs)=delete;
+    UringLexSource(UringLexSource&& rhs)=delete;
+    UringLexSource& operator=(UringLexSource& rhs)=delete;
+    static const size_t NoBlock = (size_t)-1;
+    // issues reads until we're at our depth, the file is covered, or the queue is out of blocks
+    void fill() {
+        while(m_count<m_depth && m_offset<m_size) {
+            size_t block;
+            if(!m_pqueue->take(block))
+                break;
+            UringQueue::Request& req = m_requests[(m_first+m_count)%JSON_URING_MAX_DEPTH];
+            req.block = block;
+            req.offset = m_offset;
+            req.size = (m_size-m_offset<m_pqueue->m_blockSize)?(size_t)(m_size-m_offset):m_pqueue->m_blockSize;
+            m_pqueue->issue(m_fd,req);
+            m_offset+=req.size;
+            ++m_count;
+        }
+    }
+    // hands back the current block and waits for the next. returns false at the end
+    bool nextBlock() {
+        m_cur = m_end = nullptr;
+        if(NoBlock!=m_block) {
+            m_pqueue->give(m_block);
+            m_block = NoBlock;
+        }
+        if(m_failed)
+            return false;
+        fill();
+        if(0==m_count)
+            return false;
+        UringQueue::Request& req = m_requests[m_first];
+        bool ok = m_pqueue->wait(req) && 0<=req.result;
+        size_t c = ok?(size_t)req.result:0;
+        // reads are rarely short for files, but when they are the rest is read here
+        if(ok && c<req.size) {
+            size_t read;
+            ok = UringQueue::readAll(m_fd,m_pqueue->block(req.block)+c,req.size-c,req.offset+c,read);
+            c+=read;
+        }
+        m_first = (m_first+1)%JSON_URING_MAX_DEPTH;
+        --m_count;
+        m_block = req.block;
+        if(!ok) {
+            m_failed = true;
+            return false;
+        }
+        m_cur = m_pqueue->block(req.block);
+        m_end = m_cur+c;
+        // keep the reads behind this one going while it's parsed
+        fill();
+        m_pqueue->submit();
+        return m_cur<m_end || nextBlock();
+    }
+protected:
+    int16_t read() final {
+        if(-1==m_fd)
+            return LexSource::Closed;
+        if(m_cur==m_end && !nextBlock())
+            return m_failed?LexSource::IOError:LexSource::EndOfInput;
+        return (unsigned char)*(m_cur++);
+    }
+    bool skipToAny(const char* characters7bit,unsigned long long& position,int16_t& match,int8_t& error) final {
+        if(-1==m_fd) {
+            match = 0;
+            error = Closed;
+            return false;
+        }
+        // the current character may be in a block we've handed back, so the tee gets the
+        // slow path
+        if(nullptr!=tee())
+            return LexSource::skipToAny(characters7bit,position,match,error);
+        // bytes past 127 are looked up too, and are never in the set
+        uint32_t set[8] = {0,0,0,0,0,0,0,0};
+        for(const char* sz = characters7bit;0!=*sz;++sz)
+            set[((uint8_t)*sz)>>5]|=((uint32_t)1)<<(*sz&31);
+        int32_t cur = current();
+        if(0<cur && 128>cur && 0!=(set[cur>>5]&(((uint32_t)1)<<(cur&31)))) {
+            match = (int16_t)cur;
+            error = 0;
+            return true;
+        }
+        while(true) {
+            const char* sz = m_cur;
+            while(sz<m_end && 0==(set[((uint8_t)*sz)>>5]&(((uint32_t)1)<<(*sz&31))))
+                ++sz;
+            if(sz<m_end) {
+                match = *sz;
+                position += (sz-m_cur)+1;
+                m_cur = sz+1;
+                error = 0;
+                return true;
+            }
+            position += m_end-m_cur;
+            m_cur = m_end;
+            if(!nextBlock()) {
+                match = 0;
+                error = m_failed?IOError:EndOfInput;
+                return false;
+            }
+        }
+    }
+public:
+    UringLexSource() :
+            m_pqueue(nullptr),
+            m_fd(-1),
+            m_size(0),
+            m_offset(0),
+            m_depth(0),
+            m_first(0),
+            m_count(0),
+            m_block(NoBlock),
+            m_cur(nullptr),
+            m_end(nullptr),
+            m_failed(false) {
+    }
+    ~UringLexSource() override {
+        close();
+    }
+    bool peekString(const char** pstart,size_t* psize) override {
+        if(nullptr==m_cur || '\"'!=current())
+            return false;
+        // only strings that end in the same block can be peeked
+        const char* sz = (const char*)memchr(m_cur,'\"',m_end-m_cur);
+        if(nullptr==sz || nullptr!=memchr(m_cur,'\\',sz-m_cur))
+            return false;
+        *pstart = m_cur;
+        *psize = sz-m_cur;
+        return true;
+    }
+    // opens the file and starts reading it through the queue, with up to depth reads in flight.
+    // fails if the queue doesn't have depth+1 blocks left for us
+    bool open(UringQueue& queue,const char* filename,size_t depth=JSON_URING_DEPTH) {
+        if(-1!=m_fd || nullptr==filename || nullptr==queue.m_pbuffers || 0==depth)
+            return false;
+        // we hold the blocks in flight and the one being parsed
+        if(depth>JSON_URING_MAX_DEPTH)
+            depth = JSON_URING_MAX_DEPTH;
+        if(queue.m_committed+depth+1>queue.m_blockCount)
+            return false;
+        int fd = ::open(filename,O_RDONLY|O_CLOEXEC);
+        if(0>fd)
+            return false;
+        struct stat st;
+        if(0!=fstat(fd,&st)) {
+            ::close(fd);
+            return false;
+        }
+        reset();
+        m_pqueue = &queue;
+        m_fd = fd;
+        m_size = (uint64_t)st.st_size;
+        m_offset = 0;
+        m_depth = depth;
+        m_first = m_count = 0;
+        m_block = NoBlock;
+        m_cur = m_end = nullptr;
+        m_failed = false;
+        queue.m_committed+=depth+1;
+        fill();
+        m_pqueue->submit();
+        return true;
+    }
+    void close() {
+        if(-1==m_fd)
+            return;
+        // the kernel may still be writing to our blocks
+        while(0<m_count) {
+            UringQueue::Request& req = m_requests[m_first];
+            m_pqueue->wait(req);
+            m_pqueue->give(req.block);
+            m_first = (m_first+1)%JSON_URING_MAX_DEPTH;
+            --m_count;
+        }
+        if(NoBlock!=m_block) {
+            m_pqueue->give(m_block);
+            m_block = NoBlock;
+        }
+        m_pqueue->m_committed-=m_depth+1;
+        ::close(m_fd);
+        m_fd = -1;
+        m_pqueue = nullptr;
+        m_cur = m_end = nullptr;
+    }
+};
+template<size_t TCapacity> class StaticUringLexSource : public StaticLexSource<TCapacity>, public virtual UringLexSource {
+
+};
+}
+#endif
+#endif
@@ -0,0 +1,230 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+#ifndef HTCW_WINDOWED_MAPPED_LEXSOURCE_HPP
+#define HTCW_WINDOWED_MAPPED_LEXSOURCE_HPP
+#ifndef ARDUINO
+#include <stdint.h>
+#include <string.h>
+#include "MappedFile.hpp"
+#include "LexSource.hpp"
+// this needs mmap() and madvise()
+#if HAVE_MMAP
+#include <sys/stat.h>
+// the size of each window. it's rounded up to a whole number of pages
+#ifndef JSON_MAPPED_WINDOW_SIZE
+#define JSON_MAPPED_WINDOW_SIZE (64*1024*1024)
+#endif
+// how much of a window is read before the pages behind the cursor are released
+#ifndef JSON_MAPPED_RELEASE_SIZE
+#define JSON_MAPPED_RELEASE_SIZE (4*1024*1024)
+#endif
+namespace lex {
+// reads a file through a window of it mapped at a time, so files bigger than the address
+// space or the memory budget can be read at mmap speed. the window after the current one is
+// mapped ahead of the cursor and the kernel is told to read it ahead. pages behind the cursor
+// are released as it goes, and a window is unmapped as soon as the cursor leaves it. build
+// with _FILE_OFFSET_BITS=64 on 32-bit systems, or reading fails past 2GB
+class WindowedMappedLexSource : public virtual LexSource {
+    struct Window {
+        char* pdata;
+        uint64_t offset;
+        size_t size;
+    };
+    int m_fd;
+    uint64_t m_size;
+    size_t m_windowSize;
+    size_t m_releaseSize;
+    size_t m_pageSize;
+    Window m_current;
+    Window m_next;
+    const char* m_cur;
+    const char* m_end;
+    // the start of the part of the current window that hasn't been released
+    const char* m_kept;
+    // set when a window couldn't be mapped
+    bool m_failed;
+    WindowedMappedLexSource(WindowedMappedLexSource& rhs)=delete;
+    WindowedMappedLexSource(WindowedMappedLexSource&& rhs)=delete;
+    WindowedMappedLexSource& operator=(WindowedMappedLexSource& rhs)=delete;
+    bool map(uint64_t offset,Window& window) {
+        window.pdata = nullptr;
+        window.offset = offset;
+        window.size = 0;
+        if(offset>=m_size)
+            return true;
+        // a 32-bit off_t can't reach past 2GB, so those windows fail rather than wrap
+        if(offset>(((uint64_t)1)<<(sizeof(off_t)*8-1))-1)
+            return false;
+        window.size = (m_size-offset<m_windowSize)?(size_t)(m_size-offset):m_windowSize;
+        void* p = mmap(nullptr,window.size,PROT_READ,MAP_SHARED,m_fd,(off_t)offset);
+        if(MAP_FAILED==p) {
+            window.size = 0;
+            return false;
+        }
+        window.pdata = (char*)p;
+        madvise(p,window.size,MADV_SEQUENTIAL);
+        return true;
+    }
+    void unmap(Window& window) {
+        if(nullptr!=window.pdata)
+            munmap(window.pdata,window.size);
+        window.pdata = nullptr;
+        window.size = 0;
+    }
+    // moves to the next window and maps the one after it. returns false at the end
+    bool nextWindow() {
+        unmap(m_current);
+        m_current = m_next;
+        m_next.pdata = nullptr;
+        m_next.size = 0;
+        m_cur = m_end = m_kept = nullptr;
+        if(nullptr==m_current.pdata)
+            return false;
+        m_cur = m_kept = m_current.pdata;
+        m_end = m_current.pdata+m_current.size;
+        // if this fails, we find out when we get to the end of this window
+        if(!map(m_current.offset+m_current.size,m_next))
+            m_failed = true;
+        else if(nullptr!=m_next.pdata)
+            madvise(m_next.pdata,m_next.size,MADV_WILLNEED);
+        return true;
+    }
+    // releases the whole pages behind the cursor once there are enough of them
+    void release() {
+        if((size_t)(m_cur-m_kept)<m_releaseSize)
+            return;
+        // keep the page with the character under the cursor
+        size_t c = (size_t)((m_cur-1)-m_kept);
+        c-=c%m_pageSize;
+        if(0<c) {
+            madvise((void*)m_kept,c,MADV_DONTNEED);
+            m_kept+=c;
+        }
+    }
+protected:
+    int16_t read() final {
+        if(-1==m_fd)
+            return LexSource::Closed;
+        if(m_cur==m_end && !nextWindow())
+            return m_failed?LexSource::IOError:LexSource::EndOfInput;
+        release();
+        return (unsigned char)*(m_cur++);
+    }
+    bool skipToAny(const char* characters7bit,unsigned long long& position,int16_t& match,int8_t& error) final {
+        if(-1==m_fd) {
+            match = 0;
+            error = Closed;
+            return false;
+        }
+        // the current character may be in the window we unmapped, so the tee gets the slow path
+        if(nullptr!=tee())
+            return LexSource::skipToAny(characters7bit,position,match,error);
+        // bytes past 127 are looked up too, and are never in the set
+        uint32_t set[8] = {0,0,0,0,0,0,0,0};
+        for(const char* sz = characters7bit;0!=*sz;++sz)
+            set[((uint8_t)*sz)>>5]|=((uint32_t)1)<<(*sz&31);
+        int32_t cur = current();
+        if(0<cur && 128>cur && 0!=(set[cur>>5]&(((uint32_t)1)<<(cur&31)))) {
+            match = (int16_t)cur;
+            error = 0;
+            return true;
+        }
+        while(true) {
+            const char* sz = m_cur;
+            while(sz<m_end && 0==(set[((uint8_t)*sz)>>5]&(((uint32_t)1)<<(*sz&31))))
+                ++sz;
+            if(sz<m_end) {
+                match = *sz;
+                position += (sz-m_cur)+1;
+                m_cur = sz+1;
+                release();
+                error = 0;
+                return true;
+            }
+            position += m_end-m_cur;
+            m_cur = m_end;
+            if(!nextWindow()) {
+                match = 0;
+                error = m_failed?IOError:EndOfInput;
+                return false;
+            }
+        }
+    }
+public:
+    WindowedMappedLexSource() :
+            m_fd(-1),
+            m_size(0),
+            m_windowSize(0),
+            m_releaseSize(0),
+            m_pageSize(0),
+            m_cur(nullptr),
+            m_end(nullptr),
+            m_kept(nullptr),
+            m_failed(false) {
+        m_current.pdata = m_next.pdata = nullptr;
+        m_current.offset = m_next.offset = 0;
+        m_current.size = m_next.size = 0;
+    }
+    ~WindowedMappedLexSource() override {
+        close();
+    }
+    bool peekString(const char** pstart,size_t* psize) override {
+        if(nullptr==m_cur || '\"'!=current())
+            return false;
+        // only strings that end in the same window can be peeked
+        const char* sz = (const char*)memchr(m_cur,'\"',m_end-m_cur);
+        if(nullptr==sz || nullptr!=memchr(m_cur,'\\',sz-m_cur))
+            return false;
+        *pstart = m_cur;
+        *psize = sz-m_cur;
+        return true;
+    }
+    // opens the file and maps its first two windows
+    bool open(const char* filename,size_t windowSize=JSON_MAPPED_WINDOW_SIZE,size_t releaseSize=JSON_MAPPED_RELEASE_SIZE) {
+        if(-1!=m_fd || nullptr==filename || 0==windowSize)
+            return false;
+        int fd = ::open(filename,O_RDONLY);
+        if(0>fd)
+            return false;
+        struct stat st;
+        if(0!=fstat(fd,&st)) {
+            ::close(fd);
+            return false;
+        }
+        long pageSize = sysconf(_SC_PAGESIZE);
+        m_pageSize = (0<pageSize)?(size_t)pageSize:4096;
+        // windows have to start on page boundaries
+        m_windowSize = ((windowSize+m_pageSize-1)/m_pageSize)*m_pageSize;
+        m_releaseSize = (releaseSize<m_pageSize)?m_pageSize:releaseSize;
+        m_fd = fd;
+        m_size = (uint64_t)st.st_size;
+        m_failed = false;
+        reset();
+        // the first window comes in as the next one
+        if(!map(0,m_next)) {
+            close();
+            return false;
+        }
+        nextWindow();
+        return true;
+    }
+    void close() {
+        unmap(m_current);
+        unmap(m_next);
+        if(-1!=m_fd) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        m_cur = m_end = m_kept = nullptr;
+    }
+    // indicates the size of the file
+    unsigned long long size() const { return m_size; }
+};
+template<size_t TCapacity> class StaticWindowedMappedLexSource : public StaticLexSource<TCapacity>, public virtual WindowedMappedLexSource {
+
+};
+}
+#endif
+#endif
+#endif
@@ -738,6 +738,44 @@ void printSEFmt(int s, int e)
     sprintf(sz, "S%02dE%02d", s, e);
     print(sz);
 }
+// receives each episode a wildcard extraction finds
+class EpisodeSink : public JsonExtractSink
+{
+public:
+    MemoryPool &pool;
+    JsonElement &seasonNumber;
+    JsonElement &episodeNumber;
+    JsonElement &name;
+    bool silent;
+    int episodes;
+    unsigned long long maxUsedPool;
+    EpisodeSink(MemoryPool &pool, JsonElement &seasonNumber, JsonElement &episodeNumber, JsonElement &name, bool silent)
+        : pool(pool), seasonNumber(seasonNumber), episodeNumber(episodeNumber), name(name), silent(silent), episodes(0), maxUsedPool(0)
+    {
+    }
+    bool extracted(const JsonExtractor &child, unsigned long index, const char *field) override
+    {
+        // the fields were extracted straight into our elements
+        (void)child;
+        (void)index;
+        (void)field;
+        // we keep track of the max pool we use. the extraction frees it after each episode
+        if (pool.used() > maxUsedPool)
+            maxUsedPool = pool.used();
+        ++episodes;
+        if (!silent)
+        {
+            print("\t\t");
+            print(episodes);
+            print(". ");
+            printSEFmt((int)seasonNumber.integer(), (int)episodeNumber.integer());
+            print(" ");
+            print(name.string());
+            println();
+        }
+        return true;
+    }
+};
 void extractEpisodes(LexSource &fls, bool silent)
 {
     // we don't need nearly this much. see the profile info output
@@ -748,46 +786,21 @@ void extractEpisodes(LexSource &fls, bool silent)
     const char *fields[] = {"season_number", "episode_number", "name"};
     JsonExtractor children[] = {JsonExtractor(&seasonNumber), JsonExtractor(&episodeNumber), JsonExtractor(&name)};
     JsonExtractor extraction(fields, 3, children);
+    // extract each episode of the array with the above
+    EpisodeSink sink(pool, seasonNumber, episodeNumber, name, silent);
+    JsonExtractor eachEpisode(&extraction, &sink);
     JsonReader jr(fls);
-    unsigned long long maxUsedPool = 0;
-    int episodes = 0;
     while (jr.skipToFieldValue("episodes", JsonReader::Forward))
     {
-        if (!jr.read())
-            break;
-        while (!jr.hasError() && JsonReader::EndArray != jr.nodeType())
+        if (!jr.extract(pool, eachEpisode))
         {
+            print("\t\t");
+            print(sink.episodes + 1);
+            print(". ");
+            print("Extraction failed");
+            println();
 
-            // we keep track of the max pool we use
-            if (pool.used() > maxUsedPool)
-                maxUsedPool = pool.used();
-            // we don't need to keep the pool data between calls here
-            pool.freeAll();
-
-            ++episodes;
-            //if(jr.nodeType()==JsonReader::EndObject || jr.nodeType()==JsonReader::EndArray) jr.read();
-            // read and extract from the next array element
-            if (!jr.extract(pool, extraction))
-            {
-                print("\t\t");
-                print(episodes);
-                print(". ");
-                print("Extraction failed");
-                println();
-
-                break;
-            }
-
-            if (!silent)
-            {
-                print("\t\t");
-                print(episodes);
-                print(". ");
-                printSEFmt((int)seasonNumber.integer(), (int)episodeNumber.integer());
-                print(" ");
-                print(name.string());
-                println();
-            }
+            break;
         }
     }
     if (jr.hasError())
@@ -803,9 +816,9 @@ void extractEpisodes(LexSource &fls, bool silent)
     else
     {
         print("\tExtracted ");
-        print(episodes);
+        print(sink.episodes);
         print(" episodes using ");
-        print((long long)maxUsedPool);
+        print((long long)sink.maxUsedPool);
         print(" bytes of the pool");
         println();
     }